@@ -39,6 +39,8 @@ create_hid() {
     echo 1 > functions/hid.0/subclass
 
     # Binary HID keyboard descriptor
+    # The key array spans the usages of the N-key rollover bitmap, up to
+    # the international keys of the Japanese layout and beyond
     #  0x05, 0x01, // USAGE_PAGE (Generic Desktop)
     #  0x09, 0x06, // USAGE (Keyboard)
     #  0xa1, 0x01, // COLLECTION (Application)
@@ -65,13 +67,13 @@ create_hid() {
     #  0x95, 0x06, //   REPORT_COUNT (6)
     #  0x75, 0x08, //   REPORT_SIZE (8)
     #  0x15, 0x00, //   LOGICAL_MINIMUM (0)
-    #  0x25, 0x65, //   LOGICAL_MAXIMUM (101)
+    #  0x26, 0x9f, 0x00, //   LOGICAL_MAXIMUM (159)
     #  0x05, 0x07, //   USAGE_PAGE (Keyboard)
     #  0x19, 0x00, //   USAGE_MINIMUM (Reserved (no event indicated))
-    #  0x29, 0x65, //   USAGE_MAXIMUM (Keyboard Application)
+    #  0x29, 0x9f, //   USAGE_MAXIMUM (Keyboard Separator)
     #  0x81, 0x00, //   INPUT (Data,Ary,Abs)
     #  0xc0        // END_COLLECTION
-    printf '\x05\x01\x09\x06\xa1\x01\x05\x07\x19\xe0\x29\xe7\x15\x00\x25\x01\x75\x01\x95\x08\x81\x02\x95\x01\x75\x08\x81\x03\x95\x05\x75\x01\x05\x08\x19\x01\x29\x05\x91\x02\x95\x01\x75\x03\x91\x03\x95\x06\x75\x08\x15\x00\x25\x65\x05\x07\x19\x00\x29\x65\x81\x00\xc0' > functions/hid.0/report_desc
+    printf '\x05\x01\x09\x06\xa1\x01\x05\x07\x19\xe0\x29\xe7\x15\x00\x25\x01\x75\x01\x95\x08\x81\x02\x95\x01\x75\x08\x81\x03\x95\x05\x75\x01\x05\x08\x19\x01\x29\x05\x91\x02\x95\x01\x75\x03\x91\x03\x95\x06\x75\x08\x15\x00\x26\x9f\x00\x05\x07\x19\x00\x29\x9f\x81\x00\xc0' > functions/hid.0/report_desc
 
     # Create HID mouse function
     mkdir functions/hid.1
@@ -121,6 +123,34 @@ create_hid() {
     #  0xc0              // END_COLLECTION
     printf '\x05\x01\x09\x02\xa1\x01\x09\x01\xa1\x00\x05\x09\x19\x01\x29\x03\x15\x00\x25\x01\x95\x03\x75\x01\x81\x02\x95\x01\x75\x05\x81\x03\x05\x01\x09\x30\x09\x31\x35\x00\x46\xff\x7f\x15\x00\x26\xff\x7f\x65\x11\x55\x00\x75\x10\x95\x02\x81\x02\x09\x38\x15\xff\x25\x01\x35\x00\x45\x00\x75\x08\x95\x01\x81\x06\xc0\xc0' > functions/hid.1/report_desc
 
+    if [ "${HID_KEYBOARD_MODE}" = "nkro" ]; then
+        # Create HID N-key rollover keyboard function
+        mkdir functions/hid.2
+
+        echo 0 > functions/hid.2/protocol	# 0: none, report protocol only
+        echo 20 > functions/hid.2/report_length
+        echo 0 > functions/hid.2/subclass
+
+        # Binary HID N-key rollover keyboard descriptor
+        # The keys that don't fit in the boot keyboard report are set in
+        # this bitmap. It isn't a boot device, so hosts that only support
+        # the boot protocol (e.g. BIOS) ignore it and never see a report
+        # meant for the report protocol.
+        #  0x05, 0x01, // USAGE_PAGE (Generic Desktop)
+        #  0x09, 0x06, // USAGE (Keyboard)
+        #  0xa1, 0x01, // COLLECTION (Application)
+        #  0x05, 0x07, //   USAGE_PAGE (Keyboard)
+        #  0x19, 0x00, //   USAGE_MINIMUM (Reserved (no event indicated))
+        #  0x29, 0x9f, //   USAGE_MAXIMUM (Keyboard Separator)
+        #  0x15, 0x00, //   LOGICAL_MINIMUM (0)
+        #  0x25, 0x01, //   LOGICAL_MAXIMUM (1)
+        #  0x75, 0x01, //   REPORT_SIZE (1)
+        #  0x95, 0xa0, //   REPORT_COUNT (160)
+        #  0x81, 0x02, //   INPUT (Data,Var,Abs)
+        #  0xc0        // END_COLLECTION
+        printf '\x05\x01\x09\x06\xa1\x01\x05\x07\x19\x00\x29\x9f\x15\x00\x25\x01\x75\x01\x95\xa0\x81\x02\xc0' > functions/hid.2/report_desc
+    fi
+
     # Create configuration
     mkdir configs/c.1
     mkdir configs/c.1/strings/0x409
@@ -132,6 +162,9 @@ create_hid() {
     # Link HID functions to configuration
     ln -s functions/hid.0 configs/c.1
     ln -s functions/hid.1 configs/c.1
+    if [ "${HID_KEYBOARD_MODE}" = "nkro" ]; then
+        ln -s functions/hid.2 configs/c.1
+    fi
 }
 
 connect_hid() {
@@ -1,5 +1,7 @@
 #include "ikvm_args.hpp"
 
+#include "ikvm_flight_recorder.hpp"
+
 #include <getopt.h>
 #include <rfb/rfb.h>
 #include <stdio.h>
@@ -8,17 +10,45 @@
 namespace ikvm
 {
 Args::Args(int argc, char* argv[]) :
-    frameRate(30), subsampling(0), timeoutSeconds(-1), calcFrameCRC{false},
-    commandLine(argc, argv)
+    frameRate(30), idleRate(0), clientRate(0), bandwidth(0),
+    clientBandwidth(0), maxSessions(0), viewerRate(0), viewOnlyViewers(false),
+    pasteEnabled(false), subsampling(0), inputSinkPoll(0), inputSinkEagain(0),
+    keyboardLayout("us"),
+    dumpPath(FlightRecorder::defaultPath), listenAddress("localhost"),
+    timeoutSeconds(-1),
+    calcFrameCRC{false}, commandLine(argc, argv)
 {
     int option;
-    const char* opts = "f:s:hk:p:u:v:ct:";
+    const char* opts = "f:s:hk:p:u:v:ct:m:x:yL:z:q:";
     struct option lopts[] = {
-        {"frameRate", 1, nullptr, 'f'},      {"subsampling", 1, nullptr, 's'},
-        {"help", 0, nullptr, 'h'},           {"keyboard", 1, nullptr, 'k'},
-        {"mouse", 1, nullptr, 'p'},          {"udcName", 1, nullptr, 'u'},
-        {"videoDevice", 1, nullptr, 'v'},    {"calcCRC", 0, nullptr, 'c'},
-        {"timeoutSeconds", 1, nullptr, 't'}, {nullptr, 0, nullptr, 0}};
+        {"frameRate", 1, nullptr, 'f'},
+        {"subsampling", 1, nullptr, 's'},
+        {"help", 0, nullptr, 'h'},
+        {"keyboard", 1, nullptr, 'k'},
+        {"mouse", 1, nullptr, 'p'},
+        {"udcName", 1, nullptr, 'u'},
+        {"videoDevice", 1, nullptr, 'v'},
+        {"calcCRC", 0, nullptr, 'c'},
+        {"timeoutSeconds", 1, nullptr, 't'},
+        {"layout", 1, nullptr, layoutOption},
+        {"replay", 1, nullptr, replayOption},
+        {"inputSink", 1, nullptr, inputSinkOption},
+        {"inputSinkPoll", 1, nullptr, inputSinkPollOption},
+        {"inputSinkEagain", 1, nullptr, inputSinkEagainOption},
+        {"metrics", 1, nullptr, 'm'},
+        {"dump", 1, nullptr, dumpOption},
+        {"idleRate", 1, nullptr, idleRateOption},
+        {"clientRate", 1, nullptr, clientRateOption},
+        {"bandwidth", 1, nullptr, bandwidthOption},
+        {"clientBandwidth", 1, nullptr, clientBandwidthOption},
+        {"maxSessions", 1, nullptr, 'x'},
+        {"viewerRate", 1, nullptr, viewerRateOption},
+        {"viewOnly", 0, nullptr, 'y'},
+        {"listen", 1, nullptr, 'L'},
+        {"tlsCert", 1, nullptr, 'z'},
+        {"tlsKey", 1, nullptr, 'q'},
+        {"paste", 0, nullptr, pasteOption},
+        {nullptr, 0, nullptr, 0}};
 
     while ((option = getopt_long(argc, argv, opts, lopts, nullptr)) != -1)
     {
@@ -57,6 +87,76 @@ Args::Args(int argc, char* argv[]) :
                 if (timeoutSeconds < 0)
                     timeoutSeconds = -1;
                 break;
+            case layoutOption:
+                keyboardLayout = std::string(optarg);
+                break;
+            case replayOption:
+                replayPath = std::string(optarg);
+                break;
+            case inputSinkOption:
+                inputSinkPath = std::string(optarg);
+                break;
+            case inputSinkPollOption:
+                inputSinkPoll = (int)strtol(optarg, nullptr, 0);
+                if (inputSinkPoll < 0)
+                    inputSinkPoll = 0;
+                break;
+            case inputSinkEagainOption:
+                inputSinkEagain = (int)strtol(optarg, nullptr, 0);
+                if (inputSinkEagain < 0)
+                    inputSinkEagain = 0;
+                break;
+            case 'm':
+                metricsPath = std::string(optarg);
+                break;
+            case dumpOption:
+                dumpPath = std::string(optarg);
+                break;
+            case idleRateOption:
+                idleRate = (int)strtol(optarg, nullptr, 0);
+                if (idleRate < 0 || idleRate > 60)
+                    idleRate = 0;
+                break;
+            case clientRateOption:
+                clientRate = (int)strtol(optarg, nullptr, 0);
+                if (clientRate < 0 || clientRate > 60)
+                    clientRate = 0;
+                break;
+            case bandwidthOption:
+                bandwidth = (int)strtol(optarg, nullptr, 0);
+                if (bandwidth < 0)
+                    bandwidth = 0;
+                break;
+            case clientBandwidthOption:
+                clientBandwidth = (int)strtol(optarg, nullptr, 0);
+                if (clientBandwidth < 0)
+                    clientBandwidth = 0;
+                break;
+            case 'x':
+                maxSessions = (int)strtol(optarg, nullptr, 0);
+                if (maxSessions < 0)
+                    maxSessions = 0;
+                break;
+            case viewerRateOption:
+                viewerRate = (int)strtol(optarg, nullptr, 0);
+                if (viewerRate < 0 || viewerRate > 60)
+                    viewerRate = 0;
+                break;
+            case 'y':
+                viewOnlyViewers = true;
+                break;
+            case 'L':
+                listenAddress = std::string(optarg);
+                break;
+            case 'z':
+                tlsCertPath = std::string(optarg);
+                break;
+            case 'q':
+                tlsKeyPath = std::string(optarg);
+                break;
+            case pasteOption:
+                pasteEnabled = true;
+                break;
         }
     }
 }
@@ -78,6 +178,45 @@ void Args::printUsage()
         stderr,
         "-c, --calcCRC          Calculate CRC for each frame to save bandwidth\n");
     fprintf(stderr, "-t timeout             Idle timeout in seconds \n");
+    fprintf(stderr,
+            "--layout layout        Host keyboard layout (us, de, fr, jp)\n");
+    fprintf(stderr,
+            "--replay directory     Replay recorded frames instead of V4L2\n");
+    fprintf(stderr,
+            "--inputSink file       Record HID reports instead of using USB\n");
+    fprintf(stderr,
+            "--inputSinkPoll us     Polling interval of the recording host\n");
+    fprintf(stderr,
+            "--inputSinkEagain n    Fail every n-th recorded write (off)\n");
+    fprintf(stderr,
+            "-m, --metrics socket   Serve frame statistics on a Unix socket\n");
+    fprintf(
+        stderr,
+        "--dump file            Dump the flight recorder here on SIGUSR1\n");
+    fprintf(
+        stderr,
+        "--idleRate fps         Lowest frame rate of a static screen (off)\n");
+    fprintf(
+        stderr,
+        "--clientRate fps       Highest frame rate sent to a client (off)\n");
+    fprintf(stderr,
+            "--bandwidth kbps       Bandwidth of all the clients (off)\n");
+    fprintf(stderr,
+            "--clientBandwidth kbps Bandwidth of each client (off)\n");
+    fprintf(stderr,
+            "-x, --maxSessions n    Refuse clients beyond n sessions (off)\n");
+    fprintf(stderr,
+            "--viewerRate fps       Highest frame rate of the viewers (off)\n");
+    fprintf(stderr,
+            "-y, --viewOnly         Ignore the input of the viewers\n");
+    fprintf(stderr,
+            "-L, --listen address   Listen on this address (localhost)\n");
+    fprintf(stderr,
+            "-z, --tlsCert file     Offer VeNCrypt with this certificate\n");
+    fprintf(stderr,
+            "-q, --tlsKey file      Private key of the certificate\n");
+    fprintf(stderr,
+            "--paste                Type the client clipboard on the host\n");
     rfbUsage();
 }
 
@@ -68,6 +68,94 @@ class Args
         return frameRate;
     }
 
+    /*
+     * @brief Get the lowest frame rate the capture slows down to while the
+     *        screen doesn't change
+     *
+     * @return Value of the idle frame rate, 0 to always capture at the
+     *         desired frame rate
+     */
+    inline int getIdleRate() const
+    {
+        return idleRate;
+    }
+
+    /*
+     * @brief Get the highest frame rate sent to each client
+     *
+     * @return Value of the frame rate cap of the clients, 0 if they get
+     *         every frame
+     */
+    inline int getClientRate() const
+    {
+        return clientRate;
+    }
+
+    /*
+     * @brief Get the bandwidth shared by all the clients
+     *
+     * @return Value of the bandwidth in kilobits per second, 0 if not
+     *         limited
+     */
+    inline int getBandwidth() const
+    {
+        return bandwidth;
+    }
+
+    /*
+     * @brief Get the bandwidth of each client
+     *
+     * @return Value of the bandwidth in kilobits per second, 0 if not
+     *         limited
+     */
+    inline int getClientBandwidth() const
+    {
+        return clientBandwidth;
+    }
+
+    /*
+     * @brief Get the highest number of concurrent sessions
+     *
+     * @return Number of sessions beyond which clients are refused, 0 if
+     *         not limited
+     */
+    inline int getMaxSessions() const
+    {
+        return maxSessions;
+    }
+
+    /*
+     * @brief Get the highest frame rate sent to the viewers, i.e. the
+     *        sessions besides the primary one
+     *
+     * @return Value of the frame rate cap of the viewers, 0 if they get
+     *         the rate of the primary session
+     */
+    inline int getViewerRate() const
+    {
+        return viewerRate;
+    }
+
+    /*
+     * @brief Get whether the input of the viewers is ignored
+     *
+     * @return Boolean indicating if only the primary session has input
+     */
+    inline bool getViewOnlyViewers() const
+    {
+        return viewOnlyViewers;
+    }
+
+    /*
+     * @brief Get whether the client clipboard is typed on the host
+     *
+     * @return Boolean indicating if pasting text is enabled
+     */
+    inline bool getPasteEnabled() const
+    {
+        return pasteEnabled;
+    }
+
     /*
      * @brief Get the video subsampling
      *
@@ -108,6 +196,16 @@ class Args
         return udcName;
     }
 
+    /*
+     * @brief Get the keyboard layout of the host
+     *
+     * @return Reference to the string storing the keyboard layout name
+     */
+    inline const std::string& getKeyboardLayout() const
+    {
+        return keyboardLayout;
+    }
+
     /*
      * @brief Get the path to the V4L2 video device
      *
@@ -118,6 +216,103 @@ class Args
         return videoPath;
     }
 
+    /*
+     * @brief Get the path to the directory of recorded frames to replay
+     *
+     * @return Reference to the string storing the path, empty to capture
+     *         from the video device
+     */
+    inline const std::string& getReplayPath() const
+    {
+        return replayPath;
+    }
+
+    /*
+     * @brief Get the path to record HID reports to instead of sending them
+     *        to the USB gadget
+     *
+     * @return Reference to the string storing the path, empty to use the
+     *         USB gadget
+     */
+    inline const std::string& getInputSinkPath() const
+    {
+        return inputSinkPath;
+    }
+
+    /*
+     * @brief Get the polling interval of the host emulated by the HID
+     *        report recording
+     *
+     * @return Interval in microseconds, 0 if reports are read at once
+     */
+    inline int getInputSinkPoll() const
+    {
+        return inputSinkPoll;
+    }
+
+    /*
+     * @brief Get the period of the EAGAIN failures injected into the HID
+     *        report recording
+     *
+     * @return Every how many writes fail, 0 if none
+     */
+    inline int getInputSinkEagain() const
+    {
+        return inputSinkEagain;
+    }
+
+    /*
+     * @brief Get the path of the Unix socket serving frame statistics
+     *
+     * @return Reference to the string storing the path, empty if disabled
+     */
+    inline const std::string& getMetricsPath() const
+    {
+        return metricsPath;
+    }
+
+    /*
+     * @brief Get the path the flight recorder is dumped to on SIGUSR1
+     *
+     * @return Reference to the string storing the path, empty if disabled
+     */
+    inline const std::string& getDumpPath() const
+    {
+        return dumpPath;
+    }
+
+    /*
+     * @brief Get the address the RFB server listens on
+     *
+     * @return Reference to the string storing the address
+     */
+    inline const std::string& getListenAddress() const
+    {
+        return listenAddress;
+    }
+
+    /*
+     * @brief Get the path to the TLS certificate chain of the server
+     *
+     * @return Reference to the string storing the path, empty if VeNCrypt
+     *         isn't offered
+     */
+    inline const std::string& getTlsCertPath() const
+    {
+        return tlsCertPath;
+    }
+
+    /*
+     * @brief Get the path to the TLS private key of the server
+     *
+     * @return Reference to the string storing the path, empty if in the
+     *         certificate file
+     */
+    inline const std::string& getTlsKeyPath() const
+    {
+        return tlsKeyPath;
+    }
+
     /*
      * @brief Get the identical frames detection setting
      *
@@ -142,21 +337,75 @@ class Args
     /* @brief Prints the application usage to stderr */
     void printUsage();
 
+    /*
+     * @brief Values of the options without a short name, so that
+     *        libvncserver options starting with the same letter, such as
+     *        -listen, aren't mistaken for them
+     */
+    static constexpr int pasteOption = 256;
+    static constexpr int layoutOption = 257;
+    static constexpr int replayOption = 258;
+    static constexpr int dumpOption = 259;
+    static constexpr int inputSinkPollOption = 260;
+    static constexpr int inputSinkEagainOption = 261;
+    static constexpr int idleRateOption = 262;
+    static constexpr int clientRateOption = 263;
+    static constexpr int clientBandwidthOption = 264;
+    static constexpr int viewerRateOption = 265;
+    static constexpr int inputSinkOption = 266;
+    static constexpr int bandwidthOption = 267;
+
     /*
      * @brief Desired frame rate (in frames per second) of the video
      *        stream
      */
     int frameRate;
+    /* @brief Lowest frame rate of a static screen, 0 if not adaptive */
+    int idleRate;
+    /* @brief Highest frame rate sent to each client, 0 if not capped */
+    int clientRate;
+    /* @brief Bandwidth of all the clients in kbit/s, 0 if not limited */
+    int bandwidth;
+    /* @brief Bandwidth of each client in kbit/s, 0 if not limited */
+    int clientBandwidth;
+    /* @brief Highest number of concurrent sessions, 0 if not limited */
+    int maxSessions;
+    /* @brief Highest frame rate sent to the viewers, 0 if not capped */
+    int viewerRate;
+    /* @brief Ignore the input of the viewers */
+    bool viewOnlyViewers;
+    /* @brief Type the client clipboard on the host */
+    bool pasteEnabled;
     /* @brief Desired subsampling (0: 444, 1: 420) */
     int subsampling;
+    /* @brief Polling interval of the emulated host in microseconds */
+    int inputSinkPoll;
+    /* @brief Period of the EAGAIN failures of recorded writes, 0 if none */
+    int inputSinkEagain;
     /* @brief Path to the USB keyboard device */
     std::string keyboardPath;
     /* @brief Path to the USB mouse device */
     std::string pointerPath;
     /* @brief Name of UDC */
     std::string udcName;
+    /* @brief Keyboard layout of the host */
+    std::string keyboardLayout;
     /* @brief Path to the V4L2 video device */
     std::string videoPath;
+    /* @brief Path to the directory of recorded frames to replay */
+    std::string replayPath;
+    /* @brief Path to record HID reports to */
+    std::string inputSinkPath;
+    /* @brief Path of the Unix socket serving frame statistics */
+    std::string metricsPath;
+    /* @brief Path the flight recorder is dumped to */
+    std::string dumpPath;
+    /* @brief Address the RFB server listens on */
+    std::string listenAddress;
+    /* @brief Path to the TLS certificate chain of the server */
+    std::string tlsCertPath;
+    /* @brief Path to the TLS private key of the server */
+    std::string tlsKeyPath;
     /* @brief Idle timeout duration in seconds */
     int timeoutSeconds;
     /* @brief Identical frames detection */
@@ -50,11 +50,29 @@ TEST_F(ArgsTest, DefaultValuesWithNoArguments)
     Args parser(args.size(), argv);
 
     EXPECT_EQ(parser.getFrameRate(), 30);
+    EXPECT_EQ(parser.getIdleRate(), 0);
+    EXPECT_EQ(parser.getClientRate(), 0);
+    EXPECT_EQ(parser.getBandwidth(), 0);
+    EXPECT_EQ(parser.getClientBandwidth(), 0);
+    EXPECT_EQ(parser.getMaxSessions(), 0);
+    EXPECT_EQ(parser.getViewerRate(), 0);
+    EXPECT_FALSE(parser.getViewOnlyViewers());
+    EXPECT_FALSE(parser.getPasteEnabled());
     EXPECT_EQ(parser.getSubsampling(), 0);
     EXPECT_TRUE(parser.getKeyboardPath().empty());
     EXPECT_TRUE(parser.getPointerPath().empty());
     EXPECT_TRUE(parser.getUdcName().empty());
     EXPECT_TRUE(parser.getVideoPath().empty());
+    EXPECT_TRUE(parser.getReplayPath().empty());
+    EXPECT_TRUE(parser.getInputSinkPath().empty());
+    EXPECT_EQ(parser.getInputSinkPoll(), 0);
+    EXPECT_EQ(parser.getInputSinkEagain(), 0);
+    EXPECT_TRUE(parser.getMetricsPath().empty());
+    EXPECT_EQ(parser.getDumpPath(), "/run/obmc-ikvm/flight");
+    EXPECT_EQ(parser.getListenAddress(), "localhost");
+    EXPECT_TRUE(parser.getTlsCertPath().empty());
+    EXPECT_TRUE(parser.getTlsKeyPath().empty());
+    EXPECT_EQ(parser.getKeyboardLayout(), "us");
     EXPECT_FALSE(parser.getCalcFrameCRC());
 
     deleteArgv(argv, args.size());
@@ -111,6 +129,303 @@ TEST_F(ArgsTest, ParseUdcName)
     deleteArgv(argv, args.size());
 }
 
+TEST_F(ArgsTest, ParseKeyboardLayout)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "--layout", "de"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_EQ(parser.getKeyboardLayout(), "de");
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, LibvncserverListenIsNotLayout)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "-listen", "0.0.0.0"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_EQ(parser.getKeyboardLayout(), "us");
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, ParseReplayPath)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "--replay",
+                                     "/tmp/recording"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_EQ(parser.getReplayPath(), "/tmp/recording");
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, LibvncserverRfbportIsNotReplay)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "-rfbport", "5901"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_TRUE(parser.getReplayPath().empty());
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, ParseInputSinkPath)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "--inputSink",
+                                     "/tmp/reports"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_EQ(parser.getInputSinkPath(), "/tmp/reports");
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, LibvncserverDontdisconnectIsNotInputSink)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "-dontdisconnect"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_TRUE(parser.getInputSinkPath().empty());
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, ParseInputSinkFaults)
+{
+    std::vector<std::string> args = {"obmc-ikvm",        "--inputSink",
+                                     "/tmp/reports",     "--inputSinkPoll",
+                                     "8000",             "--inputSinkEagain",
+                                     "-3"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_EQ(parser.getInputSinkPoll(), 8000);
+    EXPECT_EQ(parser.getInputSinkEagain(), 0);
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, ParseMetricsPath)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "--metrics",
+                                     "/run/obmc-ikvm.stats"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_EQ(parser.getMetricsPath(), "/run/obmc-ikvm.stats");
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, ParseDumpPath)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "--dump",
+                                     "/run/obmc-ikvm.flight"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_EQ(parser.getDumpPath(), "/run/obmc-ikvm.flight");
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, LibvncserverDesktopIsNotDumpPath)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "-desktop", "host",
+                                     "-deferupdate", "10"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_EQ(parser.getDumpPath(), "/run/obmc-ikvm/flight");
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, ParseIdleRate)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "--idleRate", "2"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_EQ(parser.getIdleRate(), 2);
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, IdleRateOutOfRange)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "--idleRate", "61"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_EQ(parser.getIdleRate(), 0);
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, LibvncserverAlwayssharedIsNotIdleRate)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "-alwaysshared"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_EQ(parser.getIdleRate(), 0);
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, ParseClientRate)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "--clientRate", "5"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_EQ(parser.getClientRate(), 5);
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, ClientRateOutOfRange)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "--clientRate", "-1"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_EQ(parser.getClientRate(), 0);
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, LibvncserverNeversharedIsNotClientRate)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "-nevershared"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_EQ(parser.getClientRate(), 0);
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, ParseBandwidth)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "--bandwidth", "20000",
+                                     "--clientBandwidth", "8000"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_EQ(parser.getBandwidth(), 20000);
+    EXPECT_EQ(parser.getClientBandwidth(), 8000);
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, LibvncserverBppIsNotBandwidth)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "--bandwidth", "20000",
+                                     "-bpp", "16"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_EQ(parser.getBandwidth(), 20000);
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, LibvncserverWidthIsNotClientBandwidth)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "-width", "1024"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_EQ(parser.getClientBandwidth(), 0);
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, ParseSessionPolicy)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "-y", "--maxSessions", "4",
+                                     "--viewerRate", "5"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_EQ(parser.getMaxSessions(), 4);
+    EXPECT_EQ(parser.getViewerRate(), 5);
+    EXPECT_TRUE(parser.getViewOnlyViewers());
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, ViewerRateIsLongOnly)
+{
+    // -enablehttpproxy can't be used here, as it also reads as -h
+    std::vector<std::string> args = {"obmc-ikvm", "-e", "5"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_EQ(parser.getViewerRate(), 0);
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, ParsePaste)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "--paste", "-f", "15"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_TRUE(parser.getPasteEnabled());
+    EXPECT_EQ(parser.getFrameRate(), 15);
+
+    deleteArgv(argv, args.size());
+}
+
+TEST_F(ArgsTest, ParseTls)
+{
+    std::vector<std::string> args = {"obmc-ikvm", "--listen", "0.0.0.0",
+                                     "-z", "/etc/ssl/certs/https/server.pem",
+                                     "--tlsKey", "/etc/ssl/private/key.pem"};
+    char** argv = createArgv(args);
+
+    Args parser(args.size(), argv);
+
+    EXPECT_EQ(parser.getListenAddress(), "0.0.0.0");
+    EXPECT_EQ(parser.getTlsCertPath(), "/etc/ssl/certs/https/server.pem");
+    EXPECT_EQ(parser.getTlsKeyPath(), "/etc/ssl/private/key.pem");
+
+    deleteArgv(argv, args.size());
+}
+
 TEST_F(ArgsTest, ParseCalcCRCFlag)
 {
     std::vector<std::string> args = {"obmc-ikvm", "-c"};
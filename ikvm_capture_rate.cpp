@@ -0,0 +1,83 @@
+#include "ikvm_capture_rate.hpp"
+
+#include <algorithm>
+
+namespace ikvm
+{
+
+static CaptureRate::Clock::duration intervalOf(int rate)
+{
+    return std::chrono::duration_cast<CaptureRate::Clock::duration>(
+               std::chrono::seconds(1)) /
+           std::max(rate, 1);
+}
+
+CaptureRate::CaptureRate(int full, int idle) :
+    fullRate(full), idleRate(idle), staticFrames(0), burstLeft(0),
+    interval(intervalOf(full))
+{}
+
+void CaptureRate::setFullRate(int fr)
+{
+    fullRate = fr;
+    staticFrames = 0;
+    interval = intervalOf(fullRate);
+}
+
+bool CaptureRate::due(Clock::time_point now) const
+{
+    if (inBurst())
+    {
+        return now >= getNextBurstCapture();
+    }
+
+    // The full rate is paced by the frame source
+    return interval <= intervalOf(fullRate) || now >= nextCapture;
+}
+
+void CaptureRate::captured(Clock::time_point now, bool changed)
+{
+    lastCapture = now;
+    if (burstLeft)
+    {
+        burstLeft--;
+    }
+
+    if (!isAdaptive())
+    {
+        return;
+    }
+
+    if (changed)
+    {
+        staticFrames = 0;
+        interval = intervalOf(fullRate);
+    }
+    else if (++staticFrames >= fullRate)
+    {
+        auto idleInterval = intervalOf(std::min(idleRate, fullRate));
+
+        interval = std::min(interval * 2, idleInterval);
+    }
+
+    nextCapture = now + interval;
+}
+
+void CaptureRate::boost()
+{
+    staticFrames = 0;
+    burstLeft = burstFrames;
+    interval = intervalOf(fullRate);
+}
+
+CaptureRate::Clock::time_point CaptureRate::getNextBurstCapture() const
+{
+    return lastCapture + intervalOf(maxRate);
+}
+
+double CaptureRate::getRate() const
+{
+    return std::chrono::duration<double>(std::chrono::seconds(1)) / interval;
+}
+
+} // namespace ikvm
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <chrono>
+
+namespace ikvm
+{
+
+/*
+ * @class CaptureRate
+ * @brief Adapts the capture rate to the screen content: frames are captured
+ *        at the full rate while the screen changes, and at a halving rate
+ *        down to the idle rate once it has been static for a second
+ *
+ * The rate goes back to full at the first changed frame or client input.
+ * Client input also starts a burst: the next few frames are captured as
+ * soon as the frame source has them, up to the highest frame rate, without
+ * waiting for the server's round of client messages.
+ */
+class CaptureRate
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /*
+     * @brief Constructs CaptureRate object
+     *
+     * @param[in] full - Frame rate while the screen changes
+     * @param[in] idle - Lowest frame rate of a static screen, 0 to always
+     *                   capture at the full rate
+     */
+    CaptureRate(int full, int idle);
+    ~CaptureRate() = default;
+    CaptureRate(const CaptureRate&) = default;
+    CaptureRate& operator=(const CaptureRate&) = default;
+    CaptureRate(CaptureRate&&) = default;
+    CaptureRate& operator=(CaptureRate&&) = default;
+
+    /*
+     * @brief Sets the frame rate while the screen changes
+     *
+     * @param[in] fr - Value of the frame rate in frames per second
+     */
+    void setFullRate(int fr);
+    /*
+     * @brief Gets whether a frame should be captured
+     *
+     * @param[in] now - Current time
+     *
+     * @return Boolean indicating if the capture is at the full rate or the
+     *         interval of the current rate has passed
+     */
+    bool due(Clock::time_point now) const;
+    /*
+     * @brief Records a captured frame
+     *
+     * @param[in] now     - Time of the capture
+     * @param[in] changed - Whether the frame differs from the previous one
+     */
+    void captured(Clock::time_point now, bool changed);
+    /*
+     * @brief Goes back to the full rate and starts a burst of captures, on
+     *        client input
+     */
+    void boost();
+    /*
+     * @brief Gets the earliest time of the next capture of a burst
+     *
+     * @return Time of the last capture plus the interval of the highest
+     *         frame rate
+     */
+    Clock::time_point getNextBurstCapture() const;
+
+    /*
+     * @brief Gets the current frame rate
+     *
+     * @return Value of the frame rate in frames per second
+     */
+    double getRate() const;
+    /*
+     * @brief Gets whether the rate adapts to the screen content
+     *
+     * @return Boolean indicating if an idle rate is set
+     */
+    inline bool isAdaptive() const
+    {
+        return idleRate > 0;
+    }
+    /*
+     * @brief Gets whether captures follow client input
+     *
+     * @return Boolean indicating if frames of a burst remain
+     */
+    inline bool inBurst() const
+    {
+        return burstLeft > 0;
+    }
+
+    /* @brief Number of frames captured in a burst after client input */
+    static constexpr int burstFrames = 4;
+    /* @brief Highest frame rate, capping bursts */
+    static constexpr int maxRate = 60;
+
+  private:
+    /* @brief Frame rate while the screen changes */
+    int fullRate;
+    /* @brief Lowest frame rate of a static screen */
+    int idleRate;
+    /* @brief Number of unchanged frames in a row */
+    int staticFrames;
+    /* @brief Number of frames left in the burst */
+    int burstLeft;
+    /* @brief Time between captures at the current rate */
+    Clock::duration interval;
+    /* @brief Time of the next capture below the full rate */
+    Clock::time_point nextCapture;
+    /* @brief Time of the last capture */
+    Clock::time_point lastCapture;
+};
+
+} // namespace ikvm
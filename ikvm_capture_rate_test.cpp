@@ -0,0 +1,99 @@
+#include "ikvm_capture_rate.hpp"
+
+#include <gtest/gtest.h>
+
+namespace ikvm
+{
+
+using namespace std::chrono_literals;
+
+TEST(CaptureRateTest, NotAdaptive)
+{
+    CaptureRate rate(30, 0);
+    CaptureRate::Clock::time_point now;
+
+    for (int i = 0; i < 100; ++i)
+    {
+        rate.captured(now, false);
+        EXPECT_TRUE(rate.due(now));
+    }
+    EXPECT_NEAR(rate.getRate(), 30.0, 0.001);
+}
+
+TEST(CaptureRateTest, DecaysToIdleRate)
+{
+    CaptureRate rate(8, 1);
+    CaptureRate::Clock::time_point now;
+
+    // A second of static frames at the full rate
+    for (int i = 0; i < 7; ++i)
+    {
+        rate.captured(now, false);
+        EXPECT_TRUE(rate.due(now));
+    }
+
+    rate.captured(now, false);
+    EXPECT_DOUBLE_EQ(rate.getRate(), 4.0);
+    EXPECT_FALSE(rate.due(now + 249ms));
+    EXPECT_TRUE(rate.due(now + 250ms));
+
+    rate.captured(now, false);
+    rate.captured(now, false);
+    rate.captured(now, false);
+    EXPECT_DOUBLE_EQ(rate.getRate(), 1.0);
+    EXPECT_FALSE(rate.due(now + 999ms));
+}
+
+TEST(CaptureRateTest, ChangeOrInputRestoresFullRate)
+{
+    CaptureRate rate(8, 1);
+    CaptureRate::Clock::time_point now;
+
+    for (int i = 0; i < 20; ++i)
+    {
+        rate.captured(now, false);
+    }
+    ASSERT_FALSE(rate.due(now));
+
+    rate.captured(now, true);
+    EXPECT_DOUBLE_EQ(rate.getRate(), 8.0);
+    EXPECT_TRUE(rate.due(now));
+
+    for (int i = 0; i < 20; ++i)
+    {
+        rate.captured(now, false);
+    }
+    ASSERT_FALSE(rate.due(now + 500ms));
+
+    rate.boost();
+    EXPECT_TRUE(rate.due(now + 500ms));
+    EXPECT_DOUBLE_EQ(rate.getRate(), 8.0);
+}
+
+TEST(CaptureRateTest, BurstAfterInput)
+{
+    CaptureRate rate(30, 0);
+    CaptureRate::Clock::time_point now;
+
+    EXPECT_FALSE(rate.inBurst());
+    rate.captured(now, false);
+    rate.boost();
+
+    for (int i = 0; i < CaptureRate::burstFrames; ++i)
+    {
+        ASSERT_TRUE(rate.inBurst());
+
+        // Capped to the highest frame rate
+        EXPECT_FALSE(rate.due(now + 16ms));
+        EXPECT_EQ(rate.getNextBurstCapture(),
+                  now + std::chrono::nanoseconds(1s) / 60);
+        now = rate.getNextBurstCapture();
+        EXPECT_TRUE(rate.due(now));
+        rate.captured(now, true);
+    }
+
+    EXPECT_FALSE(rate.inBurst());
+    EXPECT_TRUE(rate.due(now));
+}
+
+} // namespace ikvm
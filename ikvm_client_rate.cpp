@@ -0,0 +1,55 @@
+#include "ikvm_client_rate.hpp"
+
+#include <algorithm>
+
+namespace ikvm
+{
+
+static ClientRate::Clock::duration intervalOf(int rate)
+{
+    return std::chrono::duration_cast<ClientRate::Clock::duration>(
+               std::chrono::seconds(1)) /
+           std::max(rate, 1);
+}
+
+bool ClientRate::due(Clock::time_point captured, int cap,
+                     int captureRate) const
+{
+    if (cap <= 0 || cap >= captureRate)
+    {
+        return true;
+    }
+
+    return captured + intervalOf(captureRate) / 2 >= nextFrame;
+}
+
+void ClientRate::sent(Clock::time_point captured, int cap)
+{
+    if (cap <= 0)
+    {
+        return;
+    }
+
+    auto interval = intervalOf(cap);
+
+    // Slots missed by a client not asking for frames aren't made up for
+    nextFrame = (captured - nextFrame >= interval) ? captured + interval
+                                                   : nextFrame + interval;
+}
+
+int ClientRate::limit(int policy, int requested, int estimate)
+{
+    int cap = 0;
+
+    for (int c : {policy, requested, estimate})
+    {
+        if (c > 0 && (!cap || c < cap))
+        {
+            cap = c;
+        }
+    }
+
+    return cap;
+}
+
+} // namespace ikvm
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+
+namespace ikvm
+{
+
+/*
+ * @class ClientRate
+ * @brief Decimates the shared capture stream for a client capped below the
+ *        capture rate
+ *
+ * A frame is due once the interval of the cap has passed since the last
+ * frame sent, by the capture timestamps, less half a capture interval for
+ * the jitter of the capture. The slots of the cap stay evenly spaced unless
+ * the client falls a whole interval behind.
+ */
+class ClientRate
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    ClientRate() = default;
+    ~ClientRate() = default;
+    ClientRate(const ClientRate&) = default;
+    ClientRate& operator=(const ClientRate&) = default;
+    ClientRate(ClientRate&&) = default;
+    ClientRate& operator=(ClientRate&&) = default;
+
+    /*
+     * @brief Gets whether a frame should be sent to the client
+     *
+     * @param[in] captured    - Capture time of the frame
+     * @param[in] cap         - Frame rate cap of the client, 0 if none
+     * @param[in] captureRate - Frame rate of the capture
+     *
+     * @return Boolean indicating if the client isn't capped below the
+     *         capture rate or its next frame is due
+     */
+    bool due(Clock::time_point captured, int cap, int captureRate) const;
+    /*
+     * @brief Records a frame sent to the client
+     *
+     * @param[in] captured - Capture time of the frame
+     * @param[in] cap      - Frame rate cap of the client, 0 if none
+     */
+    void sent(Clock::time_point captured, int cap);
+
+    /*
+     * @brief Gets the cap of a client from the caps of its sources
+     *
+     * @param[in] policy    - Cap of the server for every client
+     * @param[in] requested - Cap requested for the client
+     * @param[in] estimate  - Cap estimated from the bandwidth of the client
+     *
+     * @return Lowest of the caps set, 0 if none is
+     */
+    static int limit(int policy, int requested, int estimate);
+
+  private:
+    /* @brief Capture time from which the next frame is due */
+    Clock::time_point nextFrame;
+};
+
+} // namespace ikvm
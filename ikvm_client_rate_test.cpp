@@ -0,0 +1,92 @@
+#include "ikvm_client_rate.hpp"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace ikvm
+{
+
+using namespace std::chrono_literals;
+
+static int sendFrames(ClientRate& rate, int cap, int captureRate, int frames)
+{
+    ClientRate::Clock::time_point start = ClientRate::Clock::time_point() + 1s;
+    int sent = 0;
+
+    for (int i = 0; i < frames; ++i)
+    {
+        auto captured = start + i * 1000000us / captureRate;
+
+        if (rate.due(captured, cap, captureRate))
+        {
+            rate.sent(captured, cap);
+            sent++;
+        }
+    }
+
+    return sent;
+}
+
+TEST(ClientRateTest, Uncapped)
+{
+    ClientRate rate;
+
+    EXPECT_EQ(sendFrames(rate, 0, 30, 90), 90);
+    EXPECT_EQ(sendFrames(rate, 30, 30, 90), 90);
+    EXPECT_EQ(sendFrames(rate, 60, 30, 90), 90);
+}
+
+TEST(ClientRateTest, DecimatesEvenly)
+{
+    ClientRate rate;
+    ClientRate::Clock::time_point start = ClientRate::Clock::time_point() + 1s;
+    std::vector<int> sent;
+
+    for (int i = 0; i < 30; ++i)
+    {
+        auto captured = start + i * 1000000us / 30;
+
+        if (rate.due(captured, 10, 30))
+        {
+            rate.sent(captured, 10);
+            sent.push_back(i);
+        }
+    }
+
+    ASSERT_EQ(sent.size(), 10u);
+    for (size_t i = 0; i < sent.size(); ++i)
+    {
+        EXPECT_EQ(sent[i], (int)i * 3);
+    }
+
+    ClientRate slow;
+
+    EXPECT_EQ(sendFrames(slow, 5, 30, 90), 15);
+}
+
+TEST(ClientRateTest, DoesNotCatchUp)
+{
+    ClientRate rate;
+    ClientRate::Clock::time_point now = ClientRate::Clock::time_point() + 1s;
+
+    rate.sent(now, 5);
+
+    // Asking again after a second gets one frame, then the cap again
+    now += 1s;
+    EXPECT_TRUE(rate.due(now, 5, 30));
+    rate.sent(now, 5);
+    EXPECT_FALSE(rate.due(now + 100ms, 5, 30));
+    EXPECT_TRUE(rate.due(now + 200ms, 5, 30));
+}
+
+TEST(ClientRateTest, Limit)
+{
+    EXPECT_EQ(ClientRate::limit(0, 0, 0), 0);
+    EXPECT_EQ(ClientRate::limit(15, 0, 0), 15);
+    EXPECT_EQ(ClientRate::limit(15, 5, 0), 5);
+    EXPECT_EQ(ClientRate::limit(0, 20, 8), 8);
+    EXPECT_EQ(ClientRate::limit(0, 0, 12), 12);
+}
+
+} // namespace ikvm
@@ -0,0 +1,369 @@
+#include "ikvm_dbus.hpp"
+
+#include "ikvm_flight_recorder.hpp"
+#include "ikvm_input.hpp"
+
+#include <rfb/rfbproto.h>
+
+#include <map>
+#include <string>
+#include <variant>
+
+#include <boost/asio/post.hpp>
+#include <phosphor-logging/lg2.hpp>
+#include <xyz/openbmc_project/Common/error.hpp>
+
+namespace ikvm
+{
+
+using sdbusplus::xyz::openbmc_project::Common::Error::InvalidArgument;
+
+/*
+ * @brief Registers a writable property requesting a change of a setting
+ *
+ * @param[in] iface    - Interface to register the property on
+ * @param[in] name     - Name of the property
+ * @param[in] settings - Settings to change
+ * @param[in] member   - Setting changed by the property
+ * @param[in] valid    - Predicate accepting the valid values
+ */
+template <typename T, typename Valid>
+static void registerSetting(sdbusplus::asio::dbus_interface& iface,
+                            const std::string& name, Settings& settings,
+                            T Settings::Values::*member, Valid valid)
+{
+    iface.register_property(
+        name, settings.get().*member,
+        [&settings, member, valid](const T& requested, T& current) {
+            if (!valid(requested))
+            {
+                throw InvalidArgument();
+            }
+
+            Settings::Values values = settings.get();
+
+            values.*member = requested;
+            settings.set(values);
+            current = requested;
+
+            return true;
+        });
+}
+
+static std::string priorityName(Session::Priority priority)
+{
+    return priority == Session::Priority::primary ? "primary" : "viewer";
+}
+
+static std::string encodingName(int32_t encoding)
+{
+    switch (encoding)
+    {
+        case rfbEncodingRaw:
+            return "raw";
+        case rfbEncodingCopyRect:
+            return "copyrect";
+        case rfbEncodingRRE:
+            return "rre";
+        case rfbEncodingCoRRE:
+            return "corre";
+        case rfbEncodingHextile:
+            return "hextile";
+        case rfbEncodingZlib:
+            return "zlib";
+        case rfbEncodingTight:
+            return "tight";
+        case rfbEncodingZlibHex:
+            return "zlibhex";
+        case rfbEncodingZRLE:
+            return "zrle";
+        case rfbEncodingZYWRLE:
+            return "zywrle";
+        default:
+            return std::to_string(encoding);
+    }
+}
+
+DBus::DBus(std::chrono::milliseconds i) :
+    interval(i), work(boost::asio::make_work_guard(io)), timer(io),
+    conn(std::make_shared<sdbusplus::asio::connection>(io))
+{
+    conn->request_name(busName);
+    objectServer = std::make_unique<sdbusplus::asio::object_server>(conn);
+
+    scheduleRefresh();
+    thread = std::thread([this]() { io.run(); });
+}
+
+DBus::~DBus()
+{
+    io.stop();
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+
+    for (auto& [id, published] : sessions)
+    {
+        objectServer->remove_interface(published.iface);
+    }
+
+    if (flightRecorder)
+    {
+        objectServer->remove_interface(flightRecorder);
+    }
+
+    if (control)
+    {
+        objectServer->remove_interface(control);
+    }
+
+    if (paste)
+    {
+        objectServer->remove_interface(paste);
+    }
+}
+
+void DBus::addSession(const std::shared_ptr<Session>& session)
+{
+    boost::asio::post(io, [this, session]() {
+        std::string path = std::string(rootPath) + "/session/" +
+                           std::to_string(session->id);
+        auto iface = objectServer->add_interface(path, sessionInterface);
+        uint64_t connected =
+            std::chrono::duration_cast<std::chrono::seconds>(
+                session->connectedTime.time_since_epoch())
+                .count();
+
+        iface->register_property("Address", session->address);
+        iface->register_property("ConnectedTime", connected);
+        iface->register_property("BytesSent", uint64_t(0));
+        iface->register_property("FramesSent", uint64_t(0));
+        iface->register_property("FramesSkippedIdentical", uint64_t(0));
+        iface->register_property("FramesSkippedBackpressure", uint64_t(0));
+        iface->register_property("FramesSkippedRate", uint64_t(0));
+        iface->register_property("FramesThrottled", uint64_t(0));
+        iface->register_property("FramesDegraded", uint64_t(0));
+        iface->register_property("Priority",
+                                 priorityName(session->priority.load()));
+        iface->register_property("AverageLatency", 0.0);
+        iface->register_property("InputEvents", uint64_t(0));
+        iface->register_property("Encoding", std::string());
+        iface->register_property("QualityLevel", int32_t(-1));
+        iface->register_property("RoundTripTime", uint32_t(0));
+        iface->register_property(
+            "MaxFrameRate", int32_t(0),
+            [session](const int32_t& requested, int32_t& current) {
+                if (requested < 0 || requested > Session::maxRate)
+                {
+                    throw InvalidArgument();
+                }
+
+                session->maxFrameRate.store(requested,
+                                            std::memory_order_relaxed);
+                current = requested;
+
+                return true;
+            });
+        iface->register_property("FrameRateLimit", int32_t(0));
+        iface->initialize();
+
+        sessions[session->id] = {session, iface};
+    });
+}
+
+void DBus::removeSession(unsigned int id)
+{
+    boost::asio::post(io, [this, id]() {
+        auto it = sessions.find(id);
+
+        if (it != sessions.end())
+        {
+            objectServer->remove_interface(it->second.iface);
+            sessions.erase(it);
+        }
+    });
+}
+
+void DBus::publishFlightRecorder(const std::string& path)
+{
+    boost::asio::post(io, [this, path]() {
+        flightRecorder =
+            objectServer->add_interface(rootPath, flightRecorderInterface);
+        flightRecorder->register_method("Dump", [path]() {
+            if (!FlightRecorder::dump(path.c_str()))
+            {
+                lg2::error("Failed to dump the flight recorder to {PATH}",
+                           "PATH", path);
+                throw sdbusplus::xyz::openbmc_project::Common::Error::
+                    InternalFailure();
+            }
+
+            return path;
+        });
+        flightRecorder->initialize();
+    });
+}
+
+void DBus::publishSettings(Settings& settings)
+{
+    boost::asio::post(io, [this, &settings]() {
+        control = objectServer->add_interface(rootPath, controlInterface);
+
+        registerSetting(*control, "FrameRate", settings,
+                        &Settings::Values::frameRate,
+                        [](int rate) { return rate > 0 && rate <= 60; });
+        registerSetting(*control, "Subsampling", settings,
+                        &Settings::Values::subsampling,
+                        [](int sub) { return sub == 0 || sub == 1; });
+        registerSetting(*control, "Quality", settings,
+                        &Settings::Values::quality,
+                        [&settings](int quality) {
+                            return settings.isValidQuality(quality);
+                        });
+        registerSetting(*control, "CalcFrameCRC", settings,
+                        &Settings::Values::calcFrameCRC,
+                        [](bool) { return true; });
+        registerSetting(*control, "TimeoutSeconds", settings,
+                        &Settings::Values::timeoutSeconds,
+                        [](int timeout) { return timeout >= -1; });
+        registerSetting(*control, "Bandwidth", settings,
+                        &Settings::Values::bandwidth,
+                        [](int kbps) { return kbps >= 0; });
+        registerSetting(*control, "ClientBandwidth", settings,
+                        &Settings::Values::clientBandwidth,
+                        [](int kbps) { return kbps >= 0; });
+        control->initialize();
+    });
+}
+
+void DBus::publishPaste(Input& input)
+{
+    boost::asio::post(io, [this, &input]() {
+        Input::PasteStatus status = input.getPasteStatus();
+
+        paste = objectServer->add_interface(rootPath, pasteInterface);
+        paste->register_property(
+            "Enabled", input.getPasteEnabled(),
+            [&input](const bool& requested, bool& current) {
+                input.setPasteEnabled(requested);
+                current = requested;
+
+                return true;
+            });
+        paste->register_property("Active", status.active);
+        paste->register_property("Typed", uint64_t(status.typed));
+        paste->register_property("Total", uint64_t(status.total));
+        paste->register_property("CharsPerSecond", status.charsPerSecond);
+        paste->register_method("Cancel", [&input]() { input.stopPaste(); });
+        paste->initialize();
+
+        pasteInput = &input;
+    });
+}
+
+void DBus::watchHostPower(std::function<void(bool)> callback)
+{
+    boost::asio::post(io, [this, callback]() {
+        powerMatch = std::make_unique<sdbusplus::bus::match_t>(
+            *conn,
+            sdbusplus::bus::match::rules::propertiesChanged(chassisPath,
+                                                            chassisInterface),
+            [callback](sdbusplus::message_t& msg) {
+                std::string iface;
+                std::map<std::string, std::variant<std::string, uint64_t>>
+                    changed;
+
+                try
+                {
+                    msg.read(iface, changed);
+                }
+                catch (const std::exception& e)
+                {
+                    lg2::error("Failed to read the chassis state: {ERROR}",
+                               "ERROR", e.what());
+                    return;
+                }
+
+                auto it = changed.find("CurrentPowerState");
+                if (it != changed.end())
+                {
+                    const auto* state = std::get_if<std::string>(&it->second);
+
+                    callback(!state || *state != chassisPowerOff);
+                }
+            });
+
+        conn->async_method_call(
+            [callback](const boost::system::error_code& ec,
+                       const std::variant<std::string>& state) {
+                // Keep capturing on systems without a chassis state service
+                if (ec)
+                {
+                    lg2::info("Chassis power state is unavailable");
+                    return;
+                }
+
+                callback(std::get<std::string>(state) != chassisPowerOff);
+            },
+            chassisService, chassisPath, "org.freedesktop.DBus.Properties",
+            "Get", chassisInterface, "CurrentPowerState");
+    });
+}
+
+void DBus::refresh()
+{
+    constexpr auto relaxed = std::memory_order_relaxed;
+
+    // Properties only signal a change if their value differs
+    for (auto& [id, published] : sessions)
+    {
+        const Session& s = *published.session;
+        auto& iface = published.iface;
+
+        iface->set_property("BytesSent", s.bytesSent.load(relaxed));
+        iface->set_property("FramesSent", s.framesSent.load(relaxed));
+        iface->set_property("FramesSkippedIdentical",
+                            s.framesSkippedCrc.load(relaxed));
+        iface->set_property("FramesSkippedBackpressure",
+                            s.framesSkippedBackpressure.load(relaxed));
+        iface->set_property("FramesSkippedRate",
+                            s.framesSkippedRate.load(relaxed));
+        iface->set_property("FramesThrottled",
+                            s.framesThrottled.load(relaxed));
+        iface->set_property("FramesDegraded", s.framesDegraded.load(relaxed));
+        iface->set_property("Priority", priorityName(s.priority.load(relaxed)));
+        iface->set_property("AverageLatency", s.getAverageLatency());
+        iface->set_property("InputEvents", s.inputEvents.load(relaxed));
+        iface->set_property("Encoding", encodingName(s.encoding.load(relaxed)));
+        iface->set_property("QualityLevel", s.qualityLevel.load(relaxed));
+        iface->set_property("RoundTripTime", s.roundTripTime.load(relaxed));
+        iface->set_property("FrameRateLimit", s.frameRateLimit.load(relaxed));
+    }
+
+    if (pasteInput)
+    {
+        Input::PasteStatus status = pasteInput->getPasteStatus();
+
+        paste->set_property("Active", status.active);
+        paste->set_property("Typed", uint64_t(status.typed));
+        paste->set_property("Total", uint64_t(status.total));
+        paste->set_property("CharsPerSecond", status.charsPerSecond);
+    }
+}
+
+void DBus::scheduleRefresh()
+{
+    timer.expires_after(interval);
+    timer.async_wait([this](const boost::system::error_code& ec) {
+        if (ec)
+        {
+            return;
+        }
+
+        refresh();
+        scheduleRefresh();
+    });
+}
+
+} // namespace ikvm
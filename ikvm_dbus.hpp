@@ -0,0 +1,162 @@
+#pragma once
+
+#include "ikvm_session.hpp"
+#include "ikvm_settings.hpp"
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <sdbusplus/asio/connection.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+#include <sdbusplus/bus/match.hpp>
+
+namespace ikvm
+{
+
+class Input;
+
+/*
+ * @class DBus
+ * @brief Publishes the client sessions on D-Bus from a thread of its own;
+ *        the session objects are refreshed at a bounded rate so that the
+ *        hot paths only ever touch the session counters
+ */
+class DBus
+{
+  public:
+    /*
+     * @brief Connects to the system bus and starts the D-Bus thread
+     *
+     * @param[in] i - Time between refreshes of the session objects
+     */
+    explicit DBus(std::chrono::milliseconds i = std::chrono::seconds(1));
+    ~DBus();
+    DBus(const DBus&) = delete;
+    DBus& operator=(const DBus&) = delete;
+    DBus(DBus&&) = delete;
+    DBus& operator=(DBus&&) = delete;
+
+    /*
+     * @brief Publishes a session object
+     *
+     * @param[in] session - Session of a connected client
+     */
+    void addSession(const std::shared_ptr<Session>& session);
+    /*
+     * @brief Removes a session object
+     *
+     * @param[in] id - Identifier of the client
+     */
+    void removeSession(unsigned int id);
+    /*
+     * @brief Publishes the method dumping the flight recorder
+     *
+     * @param[in] path - Path the flight recorder is dumped to
+     */
+    void publishFlightRecorder(const std::string& path);
+    /*
+     * @brief Publishes the settings as writable properties, changes are
+     *        requested from the settings and applied between frames
+     *
+     * @param[in] settings - Settings outliving this object
+     */
+    void publishSettings(Settings& settings);
+    /*
+     * @brief Publishes whether pasting is enabled, the progress of the
+     *        paste and a method cancelling it
+     *
+     * @param[in] input - Input object outliving this object
+     */
+    void publishPaste(Input& input);
+    /*
+     * @brief Watches the chassis power state; without a chassis state
+     *        service the host is assumed to be powered
+     *
+     * @param[in] callback - Called from the D-Bus thread with whether the
+     *                       host is powered, on start and on every change
+     */
+    void watchHostPower(std::function<void(bool)> callback);
+
+    /* @brief Well-known name of the application on the bus */
+    static constexpr const char* busName = "xyz.openbmc_project.KVM";
+    /* @brief Root object path of the application */
+    static constexpr const char* rootPath = "/xyz/openbmc_project/kvm";
+    /* @brief Interface of the session objects */
+    static constexpr const char* sessionInterface =
+        "xyz.openbmc_project.KVM.Session";
+    /* @brief Interface of the flight recorder on the root object */
+    static constexpr const char* flightRecorderInterface =
+        "xyz.openbmc_project.KVM.FlightRecorder";
+    /* @brief Service of the chassis state */
+    static constexpr const char* chassisService =
+        "xyz.openbmc_project.State.Chassis";
+    /* @brief Object path of the chassis state */
+    static constexpr const char* chassisPath =
+        "/xyz/openbmc_project/state/chassis0";
+    /* @brief Interface of the chassis state */
+    static constexpr const char* chassisInterface =
+        "xyz.openbmc_project.State.Chassis";
+    /* @brief Chassis power state of a powered off host */
+    static constexpr const char* chassisPowerOff =
+        "xyz.openbmc_project.State.Chassis.PowerState.Off";
+    /* @brief Interface of the settings on the root object */
+    static constexpr const char* controlInterface =
+        "xyz.openbmc_project.KVM.Control";
+    /* @brief Interface of the clipboard paste on the root object */
+    static constexpr const char* pasteInterface =
+        "xyz.openbmc_project.KVM.Paste";
+
+  private:
+    /*
+     * @struct Published
+     * @brief Session and its D-Bus interface
+     */
+    struct Published
+    {
+        std::shared_ptr<Session> session;
+        std::shared_ptr<sdbusplus::asio::dbus_interface> iface;
+    };
+
+    /* @brief Copies the session counters and the paste progress to their
+     *        D-Bus properties */
+    void refresh();
+    /* @brief Schedules the next refresh */
+    void scheduleRefresh();
+
+    /* @brief Time between refreshes of the session objects */
+    std::chrono::milliseconds interval;
+    /* @brief Event loop of the D-Bus thread */
+    boost::asio::io_context io;
+    /* @brief Keeps the event loop running while idle */
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type>
+        work;
+    /* @brief Timer of the refreshes */
+    boost::asio::steady_timer timer;
+    /* @brief Connection to the system bus */
+    std::shared_ptr<sdbusplus::asio::connection> conn;
+    /* @brief Server of the D-Bus objects */
+    std::unique_ptr<sdbusplus::asio::object_server> objectServer;
+    /* @brief Published sessions by client identifier, D-Bus thread only */
+    std::map<unsigned int, Published> sessions;
+    /* @brief Flight recorder interface, D-Bus thread only */
+    std::shared_ptr<sdbusplus::asio::dbus_interface> flightRecorder;
+    /* @brief Settings interface, D-Bus thread only */
+    std::shared_ptr<sdbusplus::asio::dbus_interface> control;
+    /* @brief Paste interface, D-Bus thread only */
+    std::shared_ptr<sdbusplus::asio::dbus_interface> paste;
+    /* @brief Input object typing the pastes, D-Bus thread only */
+    Input* pasteInput = nullptr;
+    /* @brief Match of the chassis power state changes, D-Bus thread only */
+    std::unique_ptr<sdbusplus::bus::match_t> powerMatch;
+    /* @brief Thread running the event loop */
+    std::thread thread;
+};
+
+} // namespace ikvm
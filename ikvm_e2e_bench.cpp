@@ -0,0 +1,1501 @@
+/*
+ * End-to-end benchmark of the VNC server: starts obmc-ikvm against a replay
+ * frame source and connects headless RFB clients over loopback. The clients
+ * only parse the updates far enough to frame them, so the cost measured is
+ * the server's rather than a viewer's decoding.
+ *
+ * The clients may also use TLS, either through a userspace TLS proxy in
+ * front of the server, like the web server proxying the sessions of a BMC,
+ * or with VeNCrypt to the server itself, which gives the sessions to kernel
+ * TLS.
+ */
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+namespace fs = std::filesystem;
+
+namespace ikvm
+{
+
+using Clock = std::chrono::steady_clock;
+
+/* RFB protocol constants used by the clients */
+constexpr uint8_t msgFramebufferUpdate = 0;
+constexpr uint8_t msgSetColourMapEntries = 1;
+constexpr uint8_t msgBell = 2;
+constexpr uint8_t msgServerCutText = 3;
+constexpr uint8_t msgSetEncodings = 2;
+constexpr uint8_t msgFramebufferUpdateRequest = 3;
+constexpr uint8_t msgKeyEvent = 4;
+constexpr uint8_t msgPointerEvent = 5;
+constexpr int32_t encodingRaw = 0;
+constexpr int32_t encodingCopyRect = 1;
+constexpr int32_t encodingHextile = 5;
+constexpr int32_t encodingTight = 7;
+constexpr int32_t encodingQualityLevel0 = -32;
+constexpr int32_t encodingNewFBSize = -223;
+constexpr int32_t encodingLastRect = -224;
+constexpr int32_t encodingQemuExtendedKeyEvent = -258;
+constexpr int32_t encodingExtDesktopSize = -308;
+constexpr uint8_t securityNone = 1;
+constexpr uint8_t securityVeNCrypt = 19;
+constexpr uint32_t vencryptX509None = 260;
+
+/* @brief How the clients reach the server */
+enum class Transport
+{
+    plain,
+    proxy,
+    kernelTls,
+};
+
+struct Options
+{
+    std::string server;
+    std::string replay;
+    std::string host = "127.0.0.1";
+    std::string output;
+    int port = 5959;
+    int clients = 1;
+    int duration = 10;
+    int warmup = 2;
+    int frameRate = 30;
+    int width = 1024;
+    int height = 768;
+    int quality = -1;
+    int keyRate = 0;
+    int pointerRate = 0;
+    int32_t encoding = encodingTight;
+    Transport transport = Transport::plain;
+    bool verbose = false;
+};
+
+struct Stats
+{
+    uint64_t updates = 0;
+    uint64_t bytes = 0;
+    std::vector<double> latencies;
+    std::string error;
+};
+
+/*
+ * @class Reader
+ * @brief Buffered reader of the server to client stream
+ */
+class Reader
+{
+  public:
+    explicit Reader(int f) :
+        fd(f), ssl(nullptr), pos(0), end(0), total(0), buf(65536)
+    {}
+
+    void read(void* data, size_t len)
+    {
+        uint8_t* p = (uint8_t*)data;
+
+        while (len)
+        {
+            size_t n = std::min(len, available());
+
+            memcpy(p, &buf[pos], n);
+            pos += n;
+            p += n;
+            len -= n;
+        }
+    }
+
+    void skip(size_t len)
+    {
+        while (len)
+        {
+            size_t n = std::min(len, available());
+
+            pos += n;
+            len -= n;
+        }
+    }
+
+    uint8_t u8()
+    {
+        uint8_t v;
+
+        read(&v, sizeof(v));
+        return v;
+    }
+
+    uint16_t u16()
+    {
+        uint16_t v;
+
+        read(&v, sizeof(v));
+        return ntohs(v);
+    }
+
+    uint32_t u32()
+    {
+        uint32_t v;
+
+        read(&v, sizeof(v));
+        return ntohl(v);
+    }
+
+    /* @brief Number of bytes consumed so far */
+    uint64_t consumed() const
+    {
+        return total - (end - pos);
+    }
+
+    /* @brief Reads through a TLS session from now on */
+    void setTls(SSL* s)
+    {
+        ssl = s;
+    }
+
+  private:
+    // Refills the buffer if empty and returns the number of buffered bytes
+    size_t available()
+    {
+        if (pos == end)
+        {
+            ssize_t n = ssl ? SSL_read(ssl, buf.data(), buf.size())
+                            : recv(fd, buf.data(), buf.size(), 0);
+
+            if (n <= 0)
+            {
+                throw std::runtime_error(
+                    !n ? "connection closed"
+                       : (ssl ? "TLS read failed" : strerror(errno)));
+            }
+
+            pos = 0;
+            end = n;
+            total += n;
+        }
+
+        return end - pos;
+    }
+
+    int fd;
+    SSL* ssl;
+    size_t pos;
+    size_t end;
+    uint64_t total;
+    std::vector<uint8_t> buf;
+};
+
+/*
+ * @class Client
+ * @brief Headless RFB client requesting updates as fast as the server
+ *        delivers them, optionally sending key and pointer events
+ */
+class Client
+{
+  public:
+    Client(const Options& o, int i, SSL_CTX* c) :
+        options(o), id(i), ctx(c), ssl(nullptr), fd(-1), width(0), height(0),
+        bitsPerPixel(0), tightPixelSize(0)
+    {}
+    ~Client()
+    {
+        SSL_free(ssl);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+    Client(Client&&) = delete;
+    Client& operator=(Client&&) = delete;
+
+    /* @brief Connects to the server and completes the handshake */
+    void connect()
+    {
+        bool proxied = options.transport == Transport::proxy;
+        bool vencrypt = options.transport == Transport::kernelTls;
+
+        fd = dial(options.host, proxied ? options.port + 1 : options.port);
+        reader = std::make_unique<Reader>(fd);
+        if (proxied)
+        {
+            startTls();
+        }
+
+        char version[12];
+
+        reader->read(version, sizeof(version));
+        if (strncmp(version, "RFB 003.", 8))
+        {
+            throw std::runtime_error("not an RFB server");
+        }
+        send("RFB 003.008\n", 12);
+
+        uint8_t count = reader->u8();
+        uint8_t security = vencrypt ? securityVeNCrypt : securityNone;
+        bool offered = false;
+
+        if (!count)
+        {
+            throw std::runtime_error("server refused the connection");
+        }
+        for (uint8_t i = 0; i < count; ++i)
+        {
+            offered |= (reader->u8() == security);
+        }
+        if (!offered)
+        {
+            throw std::runtime_error(vencrypt
+                                         ? "server doesn't offer VeNCrypt"
+                                         : "server requires authentication");
+        }
+        send(&security, 1);
+        if (vencrypt)
+        {
+            negotiateVeNCrypt();
+        }
+        if (reader->u32())
+        {
+            throw std::runtime_error("security handshake failed");
+        }
+
+        // Shared, so that the clients don't disconnect each other
+        send("\1", 1);
+
+        uint8_t format[16];
+
+        width = reader->u16();
+        height = reader->u16();
+        reader->read(format, sizeof(format));
+        reader->skip(reader->u32());
+
+        bitsPerPixel = format[0];
+
+        // Tight sends 24 bit true colour pixels in three bytes
+        bool trueColour24 = format[0] == 32 && format[1] == 24 && format[3] &&
+                            format[4] == 0 && format[5] == 0xff &&
+                            format[6] == 0 && format[7] == 0xff &&
+                            format[8] == 0 && format[9] == 0xff;
+
+        tightPixelSize = trueColour24 ? 3 : bitsPerPixel / 8;
+
+        std::vector<int32_t> encodings = {options.encoding, encodingRaw,
+                                          encodingLastRect, encodingNewFBSize,
+                                          encodingExtDesktopSize};
+
+        if (options.quality >= 0)
+        {
+            encodings.push_back(encodingQualityLevel0 + options.quality);
+        }
+
+        std::vector<uint8_t> msg(4 + encodings.size() * 4);
+
+        msg[0] = msgSetEncodings;
+        put16(&msg[2], encodings.size());
+        for (size_t i = 0; i < encodings.size(); ++i)
+        {
+            put32(&msg[4 + i * 4], encodings[i]);
+        }
+        send(msg.data(), msg.size());
+    }
+
+    /*
+     * @brief Requests and reads updates until stopped
+     *
+     * @param[in] measuring - Whether updates count towards the results
+     * @param[in] running   - Whether to keep going
+     */
+    void run(const std::atomic<bool>& measuring,
+             const std::atomic<bool>& running)
+    {
+        std::thread events;
+
+        try
+        {
+            if (options.keyRate || options.pointerRate)
+            {
+                events = std::thread(&Client::sendEvents, this,
+                                     std::cref(running));
+            }
+
+            bool incremental = false;
+
+            while (running)
+            {
+                auto requested = Clock::now();
+                uint64_t start = reader->consumed();
+
+                requestUpdate(incremental);
+                incremental = true;
+
+                // Wait for an update carrying pixels, skipping other
+                // messages and the pseudo-encoding acknowledgements
+                while (!readMessage())
+                {}
+
+                if (measuring)
+                {
+                    std::chrono::duration<double, std::milli> latency =
+                        Clock::now() - requested;
+
+                    stats.updates++;
+                    stats.bytes += reader->consumed() - start;
+                    stats.latencies.push_back(latency.count());
+                }
+            }
+        }
+        catch (const std::exception& e)
+        {
+            if (running)
+            {
+                stats.error = e.what();
+            }
+        }
+
+        if (events.joinable())
+        {
+            events.join();
+        }
+    }
+
+    /* @brief Unblocks a client waiting for the server */
+    void shutdown()
+    {
+        ::shutdown(fd, SHUT_RDWR);
+    }
+
+    inline const Stats& getStats() const
+    {
+        return stats;
+    }
+
+    /*
+     * @brief Opens a TCP connection to the server
+     *
+     * @param[in] host - Address of the server
+     * @param[in] port - Port of the server
+     *
+     * @return Socket file descriptor
+     */
+    static int dial(const std::string& host, int port)
+    {
+        sockaddr_in addr{};
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+
+        if (fd < 0)
+        {
+            throw std::runtime_error(strerror(errno));
+        }
+
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1)
+        {
+            close(fd);
+            throw std::runtime_error("invalid host address " + host);
+        }
+
+        if (::connect(fd, (sockaddr*)&addr, sizeof(addr)))
+        {
+            int err = errno;
+
+            close(fd);
+            throw std::runtime_error(strerror(err));
+        }
+
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        return fd;
+    }
+
+  private:
+    static void put16(uint8_t* p, uint16_t v)
+    {
+        v = htons(v);
+        memcpy(p, &v, sizeof(v));
+    }
+
+    static void put32(uint8_t* p, uint32_t v)
+    {
+        v = htonl(v);
+        memcpy(p, &v, sizeof(v));
+    }
+
+    // Runs the TLS handshake, after which the stream goes through TLS
+    void startTls()
+    {
+        ssl = SSL_new(ctx);
+        if (!ssl || SSL_set_fd(ssl, fd) != 1 || SSL_connect(ssl) != 1)
+        {
+            throw std::runtime_error("TLS handshake failed");
+        }
+        reader->setTls(ssl);
+    }
+
+    // Chooses the VeNCrypt subtype with a certificate and no password
+    void negotiateVeNCrypt()
+    {
+        uint8_t version[2];
+        uint8_t subtype[4];
+        bool x509None = false;
+
+        reader->read(version, sizeof(version));
+        send("\0\2", 2);
+        if (reader->u8())
+        {
+            throw std::runtime_error("server refused VeNCrypt 0.2");
+        }
+        for (uint8_t n = reader->u8(); n; --n)
+        {
+            x509None |= (reader->u32() == vencryptX509None);
+        }
+        if (!x509None)
+        {
+            throw std::runtime_error("server doesn't offer X509None");
+        }
+        put32(subtype, vencryptX509None);
+        send(subtype, sizeof(subtype));
+        if (reader->u8() != 1)
+        {
+            throw std::runtime_error("server refused X509None");
+        }
+
+        startTls();
+    }
+
+    void send(const void* data, size_t len)
+    {
+        std::lock_guard<std::mutex> l(writeLock);
+        const uint8_t* p = (const uint8_t*)data;
+
+        while (len)
+        {
+            ssize_t n = ssl ? SSL_write(ssl, p, len)
+                            : ::send(fd, p, len, MSG_NOSIGNAL);
+
+            if (n <= 0)
+            {
+                throw std::runtime_error(ssl ? "TLS write failed"
+                                             : strerror(errno));
+            }
+
+            p += n;
+            len -= n;
+        }
+    }
+
+    void requestUpdate(bool incremental)
+    {
+        uint8_t msg[10] = {msgFramebufferUpdateRequest, incremental};
+
+        put16(&msg[6], width);
+        put16(&msg[8], height);
+        send(msg, sizeof(msg));
+    }
+
+    // Sends key presses and pointer motion at the configured rates
+    void sendEvents(const std::atomic<bool>& running)
+    {
+        using namespace std::chrono;
+        auto keyInterval = options.keyRate ? microseconds(1000000 /
+                                                          options.keyRate)
+                                           : hours(1);
+        auto pointerInterval =
+            options.pointerRate
+                ? microseconds(1000000 / options.pointerRate)
+                : hours(1);
+        auto nextKey = Clock::now() + keyInterval;
+        auto nextPointer = Clock::now() + pointerInterval;
+        unsigned int keys = 0;
+        unsigned int moves = 0;
+
+        try
+        {
+            while (running)
+            {
+                std::this_thread::sleep_until(std::min(nextKey, nextPointer));
+
+                if (Clock::now() >= nextKey)
+                {
+                    // Alternate press and release of 'a'
+                    uint8_t msg[8] = {msgKeyEvent, (uint8_t)(~keys & 1)};
+
+                    put32(&msg[4], 'a');
+                    send(msg, sizeof(msg));
+                    keys++;
+                    nextKey += keyInterval;
+                }
+
+                if (Clock::now() >= nextPointer)
+                {
+                    // Trace a circle around the centre of the screen
+                    double angle = moves++ * 0.05 + id;
+                    uint8_t msg[6] = {msgPointerEvent, 0};
+
+                    put16(&msg[2],
+                          (uint16_t)(width / 2 + std::cos(angle) * width / 4));
+                    put16(&msg[4], (uint16_t)(height / 2 +
+                                              std::sin(angle) * height / 4));
+                    send(msg, sizeof(msg));
+                    nextPointer += pointerInterval;
+                }
+            }
+        }
+        catch (const std::exception&)
+        {
+            // The update loop reports the connection failure
+        }
+    }
+
+    // Reads one server message; returns true for an update with pixels
+    bool readMessage()
+    {
+        uint8_t type = reader->u8();
+
+        switch (type)
+        {
+            case msgFramebufferUpdate:
+                return readUpdate();
+            case msgSetColourMapEntries:
+                reader->skip(3);
+                reader->skip(reader->u16() * 6);
+                return false;
+            case msgBell:
+                return false;
+            case msgServerCutText:
+                reader->skip(3);
+                reader->skip(reader->u32());
+                return false;
+            default:
+                throw std::runtime_error("unexpected server message " +
+                                         std::to_string(type));
+        }
+    }
+
+    bool readUpdate()
+    {
+        bool pixels = false;
+
+        reader->skip(1);
+
+        for (unsigned int n = reader->u16(); n; --n)
+        {
+            uint16_t x = reader->u16();
+            uint16_t y = reader->u16();
+            uint16_t w = reader->u16();
+            uint16_t h = reader->u16();
+            int32_t encoding = (int32_t)reader->u32();
+
+            (void)x;
+            (void)y;
+
+            switch (encoding)
+            {
+                case encodingRaw:
+                    reader->skip((size_t)w * h * bitsPerPixel / 8);
+                    break;
+                case encodingCopyRect:
+                    reader->skip(4);
+                    break;
+                case encodingHextile:
+                    readHextile(w, h);
+                    break;
+                case encodingTight:
+                    readTight(w, h);
+                    break;
+                case encodingLastRect:
+                    return pixels;
+                case encodingNewFBSize:
+                    width = w;
+                    height = h;
+                    continue;
+                case encodingExtDesktopSize:
+                    // Number of screens and padding, then the screens
+                    reader->skip((size_t)reader->u8() * 16 + 3);
+                    width = w;
+                    height = h;
+                    continue;
+                case encodingQemuExtendedKeyEvent:
+                    continue;
+                default:
+                    throw std::runtime_error("unexpected encoding " +
+                                             std::to_string(encoding));
+            }
+
+            pixels = true;
+        }
+
+        return pixels;
+    }
+
+    void readHextile(uint16_t w, uint16_t h)
+    {
+        size_t pixelSize = bitsPerPixel / 8;
+
+        for (unsigned int ty = 0; ty < h; ty += 16)
+        {
+            for (unsigned int tx = 0; tx < w; tx += 16)
+            {
+                size_t tw = std::min(16u, w - tx);
+                size_t th = std::min(16u, h - ty);
+                uint8_t subencoding = reader->u8();
+
+                if (subencoding & 1)
+                {
+                    reader->skip(tw * th * pixelSize);
+                    continue;
+                }
+                if (subencoding & 2)
+                {
+                    reader->skip(pixelSize);
+                }
+                if (subencoding & 4)
+                {
+                    reader->skip(pixelSize);
+                }
+                if (subencoding & 8)
+                {
+                    size_t subrects = reader->u8();
+
+                    reader->skip(subrects *
+                                 ((subencoding & 16) ? pixelSize + 2 : 2));
+                }
+            }
+        }
+    }
+
+    size_t readCompactLength()
+    {
+        uint8_t b = reader->u8();
+        size_t len = b & 0x7f;
+
+        if (b & 0x80)
+        {
+            b = reader->u8();
+            len |= (size_t)(b & 0x7f) << 7;
+            if (b & 0x80)
+            {
+                len |= (size_t)reader->u8() << 14;
+            }
+        }
+
+        return len;
+    }
+
+    void readTight(uint16_t w, uint16_t h)
+    {
+        uint8_t control = reader->u8();
+        uint8_t compression = control >> 4;
+
+        if (compression == 8)
+        {
+            reader->skip(tightPixelSize);
+            return;
+        }
+        if (compression == 9)
+        {
+            reader->skip(readCompactLength());
+            return;
+        }
+        if (compression > 9)
+        {
+            throw std::runtime_error("invalid tight compression " +
+                                     std::to_string(compression));
+        }
+
+        uint8_t filter = (control & 0x40) ? reader->u8() : 0;
+        size_t rowSize = (size_t)w * tightPixelSize;
+
+        if (filter == 1)
+        {
+            size_t colours = reader->u8() + 1;
+
+            reader->skip(colours * tightPixelSize);
+            rowSize = (colours == 2) ? (w + 7) / 8 : w;
+        }
+        else if (filter > 2)
+        {
+            throw std::runtime_error("invalid tight filter " +
+                                     std::to_string(filter));
+        }
+
+        // Data under 12 bytes is sent as is, without a length
+        size_t size = rowSize * h;
+
+        reader->skip((size < 12) ? size : readCompactLength());
+    }
+
+    const Options& options;
+    int id;
+    SSL_CTX* ctx;
+    SSL* ssl;
+    int fd;
+    uint16_t width;
+    uint16_t height;
+    uint8_t bitsPerPixel;
+    size_t tightPixelSize;
+    std::unique_ptr<Reader> reader;
+    std::mutex writeLock;
+    Stats stats;
+};
+
+// Writes a loop of one second of frames with a bar sweeping across them, so
+// that every frame differs from the previous one
+static void generateFrames(const Options& options, const fs::path& dir)
+{
+    std::ofstream manifest(dir / "manifest");
+    std::vector<uint32_t> frame((size_t)options.width * options.height);
+    int bar = std::max(options.width / 16, 1);
+
+    manifest << "format rgb24\nrate " << options.frameRate << "\n";
+
+    for (int i = 0; i < options.frameRate; ++i)
+    {
+        int barX = i * (options.width - bar) / options.frameRate;
+        std::string name = "frame" + std::to_string(i) + ".rgb";
+
+        for (int y = 0; y < options.height; ++y)
+        {
+            for (int x = 0; x < options.width; ++x)
+            {
+                bool inBar = x >= barX && x < barX + bar;
+
+                frame[(size_t)y * options.width + x] =
+                    inBar ? 0xffffff
+                          : ((x * 255 / options.width) << 16) |
+                                ((y * 255 / options.height) << 8) | 0x40;
+            }
+        }
+
+        std::ofstream file(dir / name, std::ios::binary);
+
+        file.write((const char*)frame.data(), frame.size() * 4);
+        manifest << "frame " << name << " " << options.width << " "
+                 << options.height << "\n";
+    }
+}
+
+// Writes a self-signed P-256 certificate and its key for the TLS servers
+static void generateCertificate(const fs::path& certPath,
+                                const fs::path& keyPath)
+{
+    EVP_PKEY* key = EVP_EC_gen("P-256");
+    X509* cert = X509_new();
+    X509_NAME* name = X509_get_subject_name(cert);
+    FILE* file;
+
+    if (!key || !cert)
+    {
+        throw std::runtime_error("failed to generate a certificate");
+    }
+
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                               (const unsigned char*)"localhost", -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    X509_sign(cert, key, EVP_sha256());
+
+    if ((file = fopen(certPath.c_str(), "w")))
+    {
+        PEM_write_X509(file, cert);
+        fclose(file);
+    }
+    if ((file = fopen(keyPath.c_str(), "w")))
+    {
+        PEM_write_PrivateKey(file, key, nullptr, nullptr, 0, nullptr,
+                             nullptr);
+        fclose(file);
+    }
+
+    X509_free(cert);
+    EVP_PKEY_free(key);
+}
+
+// Relays one client of the proxy until either side closes
+static void proxyConnection(const Options& options, SSL_CTX* ctx, int fd)
+{
+    SSL* ssl = SSL_new(ctx);
+    int server = -1;
+    char buf[16384];
+
+    try
+    {
+        server = Client::dial(options.host, options.port);
+    }
+    catch (const std::exception&)
+    {}
+
+    SSL_set_fd(ssl, fd);
+    if (server >= 0 && SSL_accept(ssl) == 1)
+    {
+        struct pollfd fds[2] = {{fd, POLLIN, 0}, {server, POLLIN, 0}};
+
+        for (;;)
+        {
+            fds[0].revents = fds[1].revents = 0;
+            if (!SSL_pending(ssl) && poll(fds, 2, -1) < 0)
+            {
+                break;
+            }
+
+            if (SSL_pending(ssl) || fds[0].revents)
+            {
+                int n = SSL_read(ssl, buf, sizeof(buf));
+
+                if (n <= 0 || ::send(server, buf, n, MSG_NOSIGNAL) != n)
+                {
+                    break;
+                }
+            }
+
+            if (fds[1].revents)
+            {
+                ssize_t n = recv(server, buf, sizeof(buf), 0);
+
+                if (n <= 0 || SSL_write(ssl, buf, n) != n)
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    SSL_free(ssl);
+    close(fd);
+    if (server >= 0)
+    {
+        close(server);
+    }
+}
+
+/*
+ * @brief Starts a process terminating TLS in userspace on the port after the
+ *        server's and relaying the clients to the server, like the web
+ *        server of a BMC
+ *
+ * @param[in] options  - Benchmark options
+ * @param[in] certPath - Path to the certificate of the proxy
+ * @param[in] keyPath  - Path to the private key of the proxy
+ *
+ * @return Process identifier of the proxy
+ */
+static pid_t startProxy(const Options& options, const fs::path& certPath,
+                        const fs::path& keyPath)
+{
+    sockaddr_in addr{};
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(options.port + 1);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (listener < 0 || bind(listener, (sockaddr*)&addr, sizeof(addr)) ||
+        listen(listener, SOMAXCONN))
+    {
+        int err = errno;
+
+        close(listener);
+        throw std::runtime_error(strerror(err));
+    }
+
+    pid_t pid = fork();
+
+    if (pid < 0)
+    {
+        int err = errno;
+
+        close(listener);
+        throw std::runtime_error(strerror(err));
+    }
+
+    if (!pid)
+    {
+        SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+
+        if (!ctx ||
+            SSL_CTX_use_certificate_file(ctx, certPath.c_str(),
+                                         SSL_FILETYPE_PEM) != 1 ||
+            SSL_CTX_use_PrivateKey_file(ctx, keyPath.c_str(),
+                                        SSL_FILETYPE_PEM) != 1)
+        {
+            _exit(1);
+        }
+        signal(SIGPIPE, SIG_IGN);
+
+        for (;;)
+        {
+            int fd = accept(listener, nullptr, nullptr);
+
+            if (fd >= 0)
+            {
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                std::thread(proxyConnection, std::cref(options), ctx, fd)
+                    .detach();
+            }
+        }
+    }
+
+    close(listener);
+    return pid;
+}
+
+static pid_t startServer(const Options& options, const std::string& replay,
+                         const fs::path& certPath, const fs::path& keyPath)
+{
+    std::string port = std::to_string(options.port);
+    std::vector<const char*> args = {options.server.c_str(), "-rfbport",
+                                     port.c_str(), "--replay", replay.c_str(),
+                                     "--inputSink", "/dev/null"};
+
+    if (options.transport == Transport::kernelTls)
+    {
+        args.insert(args.end(),
+                    {"-z", certPath.c_str(), "-q", keyPath.c_str()});
+    }
+    args.push_back(nullptr);
+
+    pid_t pid = fork();
+
+    if (pid < 0)
+    {
+        throw std::runtime_error(strerror(errno));
+    }
+
+    if (!pid)
+    {
+        if (!options.verbose)
+        {
+            FILE* null = freopen("/dev/null", "w", stderr);
+
+            (void)null;
+        }
+
+        execv(options.server.c_str(), (char* const*)args.data());
+        _exit(127);
+    }
+
+    // Wait for the server to listen
+    for (int i = 0; i < 100; ++i)
+    {
+        int status;
+
+        if (waitpid(pid, &status, WNOHANG) == pid)
+        {
+            throw std::runtime_error("server exited during startup");
+        }
+
+        try
+        {
+            close(Client::dial(options.host, options.port));
+            return pid;
+        }
+        catch (const std::exception&)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    throw std::runtime_error("server didn't start listening");
+}
+
+// Gets the CPU time used by a process in seconds
+static double processCpuTime(pid_t pid)
+{
+    std::ifstream file("/proc/" + std::to_string(pid) + "/stat");
+    std::string stat((std::istreambuf_iterator<char>(file)),
+                     std::istreambuf_iterator<char>());
+    size_t comm = stat.rfind(')');
+
+    if (comm == std::string::npos)
+    {
+        return 0;
+    }
+
+    // utime and stime are the 12th and 13th fields after the command name
+    std::istringstream fields(stat.substr(comm + 1));
+    std::string field;
+    double ticks = 0;
+
+    for (int i = 1; i <= 13 && (fields >> field); ++i)
+    {
+        if (i >= 12)
+        {
+            ticks += std::stod(field);
+        }
+    }
+
+    return ticks / sysconf(_SC_CLK_TCK);
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+
+    std::sort(values.begin(), values.end());
+
+    size_t i = (size_t)std::ceil(p * values.size());
+
+    return values[std::clamp<size_t>(i, 1, values.size()) - 1];
+}
+
+static void printUsage()
+{
+    fprintf(stderr, "Usage: ikvm_e2e_bench [options]\n");
+    fprintf(stderr,
+            "-s, --server path      obmc-ikvm to start, else connect to a "
+            "running server\n");
+    fprintf(stderr, "-r, --replay directory Recorded frames for the server\n");
+    fprintf(stderr, "-H, --host address     Server address (127.0.0.1)\n");
+    fprintf(stderr, "-p, --port port        Server port (5959)\n");
+    fprintf(stderr, "-n, --clients number   Number of clients (1)\n");
+    fprintf(stderr, "-d, --duration seconds Measurement time (10)\n");
+    fprintf(stderr, "-w, --warmup seconds   Time before measuring (2)\n");
+    fprintf(stderr, "-e, --encoding name    tight, hextile or raw (tight)\n");
+    fprintf(stderr, "-q, --quality level    Tight JPEG quality, 0 to 9\n");
+    fprintf(stderr, "-k, --keys rate        Key events per second (0)\n");
+    fprintf(stderr, "-m, --pointer rate     Pointer events per second (0)\n");
+    fprintf(stderr,
+            "-f, --frameRate number Rate of generated frames (30)\n");
+    fprintf(stderr,
+            "-g, --geometry WxH     Size of generated frames (1024x768)\n");
+    fprintf(stderr,
+            "-t, --tls mode         none, proxy (userspace TLS proxy) or "
+            "ktls (VeNCrypt\n"
+            "                       to the server with kernel TLS) (none)\n");
+    fprintf(stderr, "-o, --output file      Write the JSON results to file\n");
+    fprintf(stderr, "-v, --verbose          Show the server output\n");
+}
+
+static Options parseOptions(int argc, char* argv[])
+{
+    Options options;
+    int option;
+    const char* opts = "s:r:H:p:n:d:w:e:q:k:m:f:g:t:o:vh";
+    struct option lopts[] = {
+        {"server", 1, nullptr, 's'},    {"replay", 1, nullptr, 'r'},
+        {"host", 1, nullptr, 'H'},      {"port", 1, nullptr, 'p'},
+        {"clients", 1, nullptr, 'n'},   {"duration", 1, nullptr, 'd'},
+        {"warmup", 1, nullptr, 'w'},    {"encoding", 1, nullptr, 'e'},
+        {"quality", 1, nullptr, 'q'},   {"keys", 1, nullptr, 'k'},
+        {"pointer", 1, nullptr, 'm'},   {"frameRate", 1, nullptr, 'f'},
+        {"geometry", 1, nullptr, 'g'},  {"tls", 1, nullptr, 't'},
+        {"output", 1, nullptr, 'o'},    {"verbose", 0, nullptr, 'v'},
+        {"help", 0, nullptr, 'h'},      {nullptr, 0, nullptr, 0}};
+
+    while ((option = getopt_long(argc, argv, opts, lopts, nullptr)) != -1)
+    {
+        switch (option)
+        {
+            case 's':
+                options.server = optarg;
+                break;
+            case 'r':
+                options.replay = optarg;
+                break;
+            case 'H':
+                options.host = optarg;
+                break;
+            case 'p':
+                options.port = atoi(optarg);
+                break;
+            case 'n':
+                options.clients = std::max(atoi(optarg), 1);
+                break;
+            case 'd':
+                options.duration = std::max(atoi(optarg), 1);
+                break;
+            case 'w':
+                options.warmup = std::max(atoi(optarg), 0);
+                break;
+            case 'e':
+                if (!strcmp(optarg, "tight"))
+                {
+                    options.encoding = encodingTight;
+                }
+                else if (!strcmp(optarg, "hextile"))
+                {
+                    options.encoding = encodingHextile;
+                }
+                else if (!strcmp(optarg, "raw"))
+                {
+                    options.encoding = encodingRaw;
+                }
+                else
+                {
+                    printUsage();
+                    exit(1);
+                }
+                break;
+            case 'q':
+                options.quality = std::clamp(atoi(optarg), 0, 9);
+                break;
+            case 'k':
+                options.keyRate = std::max(atoi(optarg), 0);
+                break;
+            case 'm':
+                options.pointerRate = std::max(atoi(optarg), 0);
+                break;
+            case 'f':
+                options.frameRate = std::clamp(atoi(optarg), 1, 60);
+                break;
+            case 'g':
+                if (sscanf(optarg, "%dx%d", &options.width,
+                           &options.height) != 2 ||
+                    options.width <= 0 || options.height <= 0)
+                {
+                    printUsage();
+                    exit(1);
+                }
+                break;
+            case 't':
+                if (!strcmp(optarg, "none"))
+                {
+                    options.transport = Transport::plain;
+                }
+                else if (!strcmp(optarg, "proxy"))
+                {
+                    options.transport = Transport::proxy;
+                }
+                else if (!strcmp(optarg, "ktls"))
+                {
+                    options.transport = Transport::kernelTls;
+                }
+                else
+                {
+                    printUsage();
+                    exit(1);
+                }
+                break;
+            case 'o':
+                options.output = optarg;
+                break;
+            case 'v':
+                options.verbose = true;
+                break;
+            case 'h':
+            default:
+                printUsage();
+                exit(option == 'h' ? 0 : 1);
+        }
+    }
+
+    // A TLS session can't be written by the event thread while the update
+    // loop reads it
+    if (options.transport != Transport::plain &&
+        (options.keyRate || options.pointerRate))
+    {
+        fprintf(stderr, "Key and pointer events aren't sent over TLS\n");
+        exit(1);
+    }
+
+    return options;
+}
+
+static const char* encodingName(int32_t encoding)
+{
+    switch (encoding)
+    {
+        case encodingTight:
+            return "tight";
+        case encodingHextile:
+            return "hextile";
+        default:
+            return "raw";
+    }
+}
+
+static const char* transportName(Transport transport)
+{
+    switch (transport)
+    {
+        case Transport::proxy:
+            return "proxy";
+        case Transport::kernelTls:
+            return "ktls";
+        default:
+            return "none";
+    }
+}
+
+static int run(const Options& options)
+{
+    fs::path generated;
+    fs::path certPath;
+    fs::path keyPath;
+    std::unique_ptr<SSL_CTX, decltype(&SSL_CTX_free)> ctx(nullptr,
+                                                          SSL_CTX_free);
+    pid_t server = -1;
+    pid_t proxy = -1;
+
+    if ((!options.server.empty() && options.replay.empty()) ||
+        options.transport != Transport::plain)
+    {
+        generated = fs::temp_directory_path() /
+                    ("ikvm_e2e_bench." + std::to_string(getpid()));
+        fs::create_directories(generated);
+    }
+
+    if (options.transport != Transport::plain)
+    {
+        certPath = generated / "cert.pem";
+        keyPath = generated / "key.pem";
+        generateCertificate(certPath, keyPath);
+
+        // Both paths use the same cipher, so that only where the encryption
+        // runs differs
+        ctx.reset(SSL_CTX_new(TLS_client_method()));
+        SSL_CTX_set_max_proto_version(ctx.get(), TLS1_2_VERSION);
+        SSL_CTX_set_cipher_list(ctx.get(), "ECDHE-ECDSA-AES128-GCM-SHA256");
+        signal(SIGPIPE, SIG_IGN);
+    }
+
+    if (!options.server.empty())
+    {
+        std::string replay = options.replay;
+
+        if (replay.empty())
+        {
+            generateFrames(options, generated);
+            replay = generated.string();
+        }
+
+        server = startServer(options, replay, certPath, keyPath);
+    }
+
+    if (options.transport == Transport::proxy)
+    {
+        proxy = startProxy(options, certPath, keyPath);
+    }
+
+    std::vector<std::unique_ptr<Client>> clients;
+    std::vector<std::thread> threads;
+    std::atomic<bool> measuring(false);
+    std::atomic<bool> running(true);
+    double cpu = 0;
+    double proxyCpu = 0;
+
+    try
+    {
+        for (int i = 0; i < options.clients; ++i)
+        {
+            clients.push_back(
+                std::make_unique<Client>(options, i, ctx.get()));
+            clients.back()->connect();
+        }
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Failed to connect client %zu: %s\n", clients.size(),
+                e.what());
+        clients.clear();
+    }
+
+    for (auto& client : clients)
+    {
+        threads.emplace_back(&Client::run, client.get(), std::cref(measuring),
+                             std::cref(running));
+    }
+
+    double cpuStart = 0;
+    double proxyCpuStart = 0;
+    auto start = Clock::now();
+
+    if (!clients.empty())
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(options.warmup));
+
+        cpuStart = (server > 0) ? processCpuTime(server) : 0;
+        proxyCpuStart = (proxy > 0) ? processCpuTime(proxy) : 0;
+        start = Clock::now();
+
+        measuring = true;
+        std::this_thread::sleep_for(std::chrono::seconds(options.duration));
+        measuring = false;
+    }
+
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    if (server > 0)
+    {
+        cpu = processCpuTime(server) - cpuStart;
+    }
+    if (proxy > 0)
+    {
+        proxyCpu = processCpuTime(proxy) - proxyCpuStart;
+    }
+
+    running = false;
+    for (auto& client : clients)
+    {
+        client->shutdown();
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    if (server > 0)
+    {
+        kill(server, SIGTERM);
+        waitpid(server, nullptr, 0);
+    }
+    if (proxy > 0)
+    {
+        kill(proxy, SIGTERM);
+        waitpid(proxy, nullptr, 0);
+    }
+    if (!generated.empty())
+    {
+        fs::remove_all(generated);
+    }
+
+    if (clients.empty())
+    {
+        return 1;
+    }
+
+    // A frame is sent to every client keeping up, so the server's frame
+    // count is that of the client that received the most
+    std::vector<double> latencies;
+    uint64_t updates = 0;
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    bool failed = false;
+    std::ostringstream json;
+
+    json << "{\n  \"clients\": " << options.clients << ",\n"
+         << "  \"encoding\": \"" << encodingName(options.encoding) << "\",\n"
+         << "  \"tls\": \"" << transportName(options.transport) << "\",\n"
+         << "  \"duration_s\": " << elapsed.count() << ",\n"
+         << "  \"per_client\": [\n";
+
+    for (size_t i = 0; i < clients.size(); ++i)
+    {
+        const Stats& stats = clients[i]->getStats();
+
+        json << "    {\"fps\": " << stats.updates / elapsed.count()
+             << ", \"bytes_per_s\": " << stats.bytes / elapsed.count()
+             << ", \"p50_ms\": " << percentile(stats.latencies, 0.5)
+             << ", \"p99_ms\": " << percentile(stats.latencies, 0.99)
+             << ", \"error\": \"" << stats.error << "\"}"
+             << (i + 1 < clients.size() ? ",\n" : "\n");
+
+        latencies.insert(latencies.end(), stats.latencies.begin(),
+                         stats.latencies.end());
+        updates += stats.updates;
+        frames = std::max(frames, stats.updates);
+        bytes += stats.bytes;
+        failed |= !stats.error.empty();
+
+        if (!stats.error.empty())
+        {
+            fprintf(stderr, "Client %zu failed: %s\n", i, stats.error.c_str());
+        }
+    }
+
+    json << "  ],\n"
+         << "  \"fps\": " << updates / elapsed.count() << ",\n"
+         << "  \"bytes_per_s\": " << bytes / elapsed.count() << ",\n"
+         << "  \"p50_ms\": " << percentile(latencies, 0.5) << ",\n"
+         << "  \"p99_ms\": " << percentile(latencies, 0.99);
+    if (server > 0)
+    {
+        json << ",\n  \"server_cpu_percent\": "
+             << cpu * 100 / elapsed.count() << ",\n"
+             << "  \"server_cpu_ms_per_frame\": "
+             << (frames ? cpu * 1000 / frames : 0);
+    }
+    if (proxy > 0)
+    {
+        json << ",\n  \"proxy_cpu_percent\": "
+             << proxyCpu * 100 / elapsed.count() << ",\n"
+             << "  \"proxy_cpu_ms_per_frame\": "
+             << (frames ? proxyCpu * 1000 / frames : 0);
+    }
+    json << "\n}\n";
+
+    fprintf(stderr,
+            "%d clients, %s, TLS %s: %.1f fps per client, %.1f KiB/s, "
+            "latency p50 %.1f ms p99 %.1f ms",
+            options.clients, encodingName(options.encoding),
+            transportName(options.transport),
+            updates / elapsed.count() / clients.size(),
+            bytes / elapsed.count() / 1024, percentile(latencies, 0.5),
+            percentile(latencies, 0.99));
+    if (server > 0)
+    {
+        fprintf(stderr, ", server %.2f ms CPU per frame",
+                frames ? cpu * 1000 / frames : 0);
+    }
+    if (proxy > 0)
+    {
+        fprintf(stderr, ", proxy %.2f ms CPU per frame",
+                frames ? proxyCpu * 1000 / frames : 0);
+    }
+    fprintf(stderr, "\n");
+
+    if (options.output.empty())
+    {
+        fputs(json.str().c_str(), stdout);
+    }
+    else
+    {
+        std::ofstream(options.output) << json.str();
+    }
+
+    return failed ? 1 : 0;
+}
+
+} // namespace ikvm
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        return ikvm::run(ikvm::parseOptions(argc, argv));
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
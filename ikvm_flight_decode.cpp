@@ -0,0 +1,209 @@
+/*
+ * Decoder of the flight recorder dumps written by obmc-ikvm on SIGUSR1 or
+ * over D-Bus: prints the recorded events as a timeline in local time, and
+ * marks the stretches without frames longer than a threshold.
+ */
+
+#include "ikvm_flight_recorder.hpp"
+
+#include <getopt.h>
+#include <time.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace ikvm
+{
+
+/*
+ * @struct Options
+ * @brief Options of the decoder
+ */
+struct Options
+{
+    std::string path = FlightRecorder::defaultPath;
+    /* @brief Gap between frames to mark, in nanoseconds */
+    uint64_t gap = 500000000;
+};
+
+static void printUsage()
+{
+    fprintf(stderr, "Usage: obmc-ikvm-flight-decode [options] [dump]\n");
+    fprintf(stderr, "Dump defaults to %s\n", FlightRecorder::defaultPath);
+    fprintf(stderr, "-g, --gap milliseconds Mark gaps between frames (500)\n");
+    fprintf(stderr, "-h, --help             Show this message and exit\n");
+}
+
+static Options parseOptions(int argc, char* argv[])
+{
+    Options options;
+    int option;
+    const char* opts = "g:h";
+    struct option lopts[] = {{"gap", 1, nullptr, 'g'},
+                             {"help", 0, nullptr, 'h'},
+                             {nullptr, 0, nullptr, 0}};
+
+    while ((option = getopt_long(argc, argv, opts, lopts, nullptr)) != -1)
+    {
+        switch (option)
+        {
+            case 'g':
+                options.gap = strtoull(optarg, nullptr, 0) * 1000000;
+                break;
+            case 'h':
+                printUsage();
+                exit(0);
+            default:
+                printUsage();
+                exit(1);
+        }
+    }
+
+    if (optind < argc)
+    {
+        options.path = argv[optind];
+    }
+
+    return options;
+}
+
+/*
+ * @brief Formats a wall clock time
+ *
+ * @param[in] ns - Nanoseconds since the epoch
+ *
+ * @return Local date and time to the microsecond
+ */
+static std::string formatTime(uint64_t ns)
+{
+    time_t seconds = ns / 1000000000;
+    tm local;
+    char buf[64];
+    size_t n;
+
+    localtime_r(&seconds, &local);
+    n = strftime(buf, sizeof(buf), "%F %T", &local);
+    snprintf(buf + n, sizeof(buf) - n, ".%06u",
+             (unsigned int)(ns % 1000000000 / 1000));
+
+    return buf;
+}
+
+/*
+ * @brief Formats an event and its arguments
+ *
+ * @param[in] r - Recorded event
+ *
+ * @return Name of the event followed by its named arguments
+ */
+static std::string formatEvent(const FlightRecorder::Record& r)
+{
+    std::string line;
+    char buf[32];
+
+    if (r.event >= FlightRecorder::eventNames.size())
+    {
+        snprintf(buf, sizeof(buf), "event_%u", r.event);
+        line = buf;
+        for (uint32_t arg : r.args)
+        {
+            line += " " + std::to_string(arg);
+        }
+
+        return line;
+    }
+
+    const auto& names = FlightRecorder::eventNames[r.event];
+
+    snprintf(buf, sizeof(buf), "%-18s", names[0]);
+    line = buf;
+    for (size_t i = 0; i < 3; ++i)
+    {
+        if (names[i + 1])
+        {
+            line += std::string(" ") + names[i + 1] + "=" +
+                    std::to_string(r.args[i]);
+        }
+    }
+    line.erase(line.find_last_not_of(' ') + 1);
+
+    return line;
+}
+
+static int decode(const Options& options)
+{
+    std::ifstream file(options.path, std::ios::binary);
+    FlightRecorder::Header header;
+    std::vector<FlightRecorder::Record> records;
+    FlightRecorder::Record r;
+    uint64_t lastDequeue = 0;
+    uint64_t lastSent = 0;
+
+    if (!file.read((char*)&header, sizeof(header)))
+    {
+        fprintf(stderr, "Failed to read %s\n", options.path.c_str());
+        return 1;
+    }
+
+    if (memcmp(header.magic, FlightRecorder::magic, sizeof(header.magic)) ||
+        header.version != FlightRecorder::version ||
+        header.recordSize != sizeof(FlightRecorder::Record))
+    {
+        fprintf(stderr, "%s is not a flight recorder dump of this version\n",
+                options.path.c_str());
+        return 1;
+    }
+
+    while (file.read((char*)&r, sizeof(r)))
+    {
+        records.push_back(r);
+    }
+
+    printf("Dumped at %s, %zu of %llu events\n",
+           formatTime(header.realTime).c_str(), records.size(),
+           (unsigned long long)header.recorded);
+
+    for (const auto& record : records)
+    {
+        // Steady clock times are relative to the dump
+        int64_t offset = (int64_t)(record.time - header.monotonicTime);
+        auto event = (FlightRecorder::Event)record.event;
+
+        if (event == FlightRecorder::Event::frameDequeue)
+        {
+            if (lastDequeue && record.time - lastDequeue > options.gap)
+            {
+                printf("    ... no frame captured for %.3f s\n",
+                       (record.time - lastDequeue) / 1e9);
+            }
+            lastDequeue = record.time;
+        }
+        else if (event == FlightRecorder::Event::frameSent)
+        {
+            if (lastSent && record.time - lastSent > options.gap)
+            {
+                printf("    ... no frame sent for %.3f s\n",
+                       (record.time - lastSent) / 1e9);
+            }
+            lastSent = record.time;
+        }
+
+        printf("%s %+11.6f %s\n",
+               formatTime(header.realTime + offset).c_str(), offset / 1e9,
+               formatEvent(record).c_str());
+    }
+
+    return 0;
+}
+
+} // namespace ikvm
+
+int main(int argc, char* argv[])
+{
+    return ikvm::decode(ikvm::parseOptions(argc, argv));
+}
@@ -0,0 +1,193 @@
+#include "ikvm_flight_recorder.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <filesystem>
+
+#include <phosphor-logging/lg2.hpp>
+
+namespace ikvm
+{
+
+std::array<FlightRecorder::Slot, FlightRecorder::capacity> FlightRecorder::ring;
+std::atomic<uint64_t> FlightRecorder::head(0);
+char FlightRecorder::signalPath[4096];
+
+static uint64_t clockNanoseconds(clockid_t clock)
+{
+    timespec ts;
+
+    clock_gettime(clock, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool writeAll(int fd, const void* data, size_t size)
+{
+    const char* p = (const char*)data;
+
+    while (size)
+    {
+        ssize_t rc = write(fd, p, size);
+
+        if (rc < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            return false;
+        }
+
+        p += rc;
+        size -= rc;
+    }
+
+    return true;
+}
+
+bool FlightRecorder::dump(const char* path)
+{
+    // Only async-signal-safe calls from here on; the records are batched on
+    // the stack to keep the number of writes down
+    Record records[128];
+    size_t n = 0;
+    Header header;
+    uint64_t last = head.load(std::memory_order_acquire);
+    uint64_t first = last > capacity ? last - capacity + 1 : 1;
+    bool ok;
+    char tmpPath[sizeof(signalPath) + 4];
+    size_t length = strlen(path);
+    int flags = O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC;
+    int fd;
+
+    if (length >= sizeof(signalPath))
+    {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+
+    memcpy(tmpPath, path, length);
+    memcpy(tmpPath + length, ".tmp", 5);
+
+    // Never write through a link planted at either path: the events go to
+    // a new file which then replaces the dump
+    fd = open(tmpPath, flags, 0644);
+    if (fd < 0 && errno == EEXIST)
+    {
+        // Left over from an interrupted dump
+        unlink(tmpPath);
+        fd = open(tmpPath, flags, 0644);
+    }
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = version;
+    header.recordSize = sizeof(Record);
+    header.monotonicTime = clockNanoseconds(CLOCK_MONOTONIC);
+    header.realTime = clockNanoseconds(CLOCK_REALTIME);
+    header.recorded = last;
+    ok = writeAll(fd, &header, sizeof(header));
+
+    for (uint64_t sequence = first; ok && sequence <= last; ++sequence)
+    {
+        const Slot& slot = ring[sequence % capacity];
+        Record& r = records[n];
+
+        if (slot.sequence.load(std::memory_order_acquire) != sequence)
+        {
+            continue;
+        }
+
+        r.time = slot.time.load(std::memory_order_relaxed);
+        r.event = slot.event.load(std::memory_order_relaxed);
+        r.args[0] = slot.args[0].load(std::memory_order_relaxed);
+        r.args[1] = slot.args[1].load(std::memory_order_relaxed);
+        r.args[2] = slot.args[2].load(std::memory_order_relaxed);
+
+        // Skip the slot if it was overwritten while being copied
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+        {
+            continue;
+        }
+
+        if (++n == sizeof(records) / sizeof(records[0]))
+        {
+            ok = writeAll(fd, records, sizeof(records));
+            n = 0;
+        }
+    }
+
+    if (ok && n)
+    {
+        ok = writeAll(fd, records, n * sizeof(Record));
+    }
+
+    ok = !close(fd) && ok;
+    if (!ok || rename(tmpPath, path))
+    {
+        unlink(tmpPath);
+        return false;
+    }
+
+    return true;
+}
+
+void FlightRecorder::dumpOnSignal(const std::string& path)
+{
+    struct sigaction action;
+
+    if (path.size() >= sizeof(signalPath))
+    {
+        lg2::error("Flight recorder dump path is too long {PATH}", "PATH",
+                   path);
+        return;
+    }
+
+    memcpy(signalPath, path.c_str(), path.size() + 1);
+
+    std::string directory = std::filesystem::path(path).parent_path();
+
+    if (!directory.empty() && mkdir(directory.c_str(), 0755) &&
+        errno != EEXIST)
+    {
+        lg2::error("Failed to create the flight recorder directory {PATH} "
+                   "{ERROR}",
+                   "PATH", directory, "ERROR", strerror(errno));
+    }
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handleSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+
+    if (sigaction(SIGUSR1, &action, nullptr))
+    {
+        lg2::error("Failed to handle SIGUSR1 {ERROR}", "ERROR",
+                   strerror(errno));
+    }
+}
+
+void FlightRecorder::handleSignal(int signal)
+{
+    int err = errno;
+
+    (void)signal;
+    dump(signalPath);
+
+    errno = err;
+}
+
+} // namespace ikvm
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace ikvm
+{
+
+/*
+ * @class FlightRecorder
+ * @brief Always-on, fixed-size ring of the latest frame, input and client
+ *        events, written to a file on SIGUSR1 or over D-Bus; recording is a
+ *        handful of relaxed atomic stores and never blocks
+ */
+class FlightRecorder
+{
+  public:
+    /* @brief Recorded events, their arguments are listed with the names */
+    enum class Event : uint32_t
+    {
+        frameDequeue,
+        frameSent,
+        videoResize,
+        serverResize,
+        timingsError,
+        videoRestart,
+        hidEagain,
+        clientConnect,
+        clientDisconnect,
+        signalFound,
+        clientRejected,
+        count,
+    };
+
+    /* @brief Names and argument names of the events, in the enum order */
+    static constexpr std::array<std::array<const char*, 4>,
+                                (size_t)Event::count>
+        eventNames = {{
+            {"frame_dequeue", "buffer", "size", "error"},
+            {"frame_sent", "client", "size", "latency_us"},
+            {"video_resize", "width", "height", nullptr},
+            {"server_resize", "width", "height", "clients"},
+            {"timings_error", "errno", nullptr, nullptr},
+            {"video_restart", "restarts", "delay_ms", nullptr},
+            {"hid_eagain", "pointer", "attempt", nullptr},
+            {"client_connect", "client", "clients", nullptr},
+            {"client_disconnect", "client", "clients", nullptr},
+            {"signal_found", "outage_ms", "restarts", nullptr},
+            {"client_rejected", "clients", nullptr, nullptr},
+        }};
+
+    /*
+     * @struct Header
+     * @brief Start of a dump, followed by the records from oldest to newest
+     */
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t recordSize;
+        /* @brief Steady clock time of the dump in nanoseconds */
+        uint64_t monotonicTime;
+        /* @brief Wall clock time of the dump in nanoseconds */
+        uint64_t realTime;
+        /* @brief Number of events recorded since the start */
+        uint64_t recorded;
+    };
+
+    /*
+     * @struct Record
+     * @brief Event as written to a dump
+     */
+    struct Record
+    {
+        /* @brief Steady clock time of the event in nanoseconds */
+        uint64_t time;
+        uint32_t event;
+        uint32_t args[3];
+    };
+
+    FlightRecorder() = delete;
+
+    /*
+     * @brief Records an event; safe to call from any thread and from signal
+     *        handlers
+     *
+     * @param[in] event - Event to record
+     * @param[in] a     - First argument of the event
+     * @param[in] b     - Second argument of the event
+     * @param[in] c     - Third argument of the event
+     */
+    static inline void record(Event event, uint32_t a = 0, uint32_t b = 0,
+                              uint32_t c = 0)
+    {
+        uint64_t sequence = head.fetch_add(1, std::memory_order_relaxed) + 1;
+        Slot& slot = ring[sequence % capacity];
+
+        // Readers discard the slot until its sequence is set again
+        slot.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.time.store(std::chrono::steady_clock::now()
+                            .time_since_epoch()
+                            .count(),
+                        std::memory_order_relaxed);
+        slot.event.store((uint32_t)event, std::memory_order_relaxed);
+        slot.args[0].store(a, std::memory_order_relaxed);
+        slot.args[1].store(b, std::memory_order_relaxed);
+        slot.args[2].store(c, std::memory_order_relaxed);
+        slot.sequence.store(sequence, std::memory_order_release);
+    }
+
+    /*
+     * @brief Writes the recorded events to a file; async-signal-safe
+     *
+     * @param[in] path - Path of the file, replaced if it exists; the
+     *                   events are first written to path.tmp
+     *
+     * @return Boolean indicating whether the dump was written
+     */
+    static bool dump(const char* path);
+    /*
+     * @brief Writes the recorded events to the dump path whenever SIGUSR1
+     *        is received, creating the directory of the dump if needed
+     *
+     * @param[in] path - Path of the dump file
+     */
+    static void dumpOnSignal(const std::string& path);
+
+    /* @brief Default path of the dump, in a directory only root writes to */
+    static constexpr const char* defaultPath = "/run/obmc-ikvm/flight";
+
+    /* @brief Number of events kept */
+    static constexpr size_t capacity = 4096;
+    /* @brief Magic number at the start of a dump */
+    static constexpr char magic[8] = {'I', 'K', 'V', 'M', 'F', 'R', 'E', 'C'};
+    /* @brief Version of the dump format */
+    static constexpr uint32_t version = 1;
+
+  private:
+    /*
+     * @struct Slot
+     * @brief Event in the ring, valid while its sequence matches the position
+     */
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence;
+        std::atomic<uint64_t> time;
+        std::atomic<uint32_t> event;
+        std::atomic<uint32_t> args[3];
+    };
+
+    /*
+     * @brief Handler of SIGUSR1
+     *
+     * @param[in] signal - Signal received
+     */
+    static void handleSignal(int signal);
+
+    /* @brief Ring of events, indexed by sequence modulo the capacity */
+    static std::array<Slot, capacity> ring;
+    /* @brief Sequence of the last event recorded */
+    static std::atomic<uint64_t> head;
+    /* @brief Path of the dump written on SIGUSR1 */
+    static char signalPath[4096];
+};
+
+} // namespace ikvm
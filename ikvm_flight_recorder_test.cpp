@@ -0,0 +1,164 @@
+#include "ikvm_flight_recorder.hpp"
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace ikvm
+{
+
+class FlightRecorderTest : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        path = (std::filesystem::temp_directory_path() /
+                ("ikvm_flight_recorder_test." + std::to_string(getpid())))
+                   .string();
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove(path);
+    }
+
+    /* @brief Reads the dump back, checking its header */
+    std::vector<FlightRecorder::Record> readDump()
+    {
+        std::ifstream file(path, std::ios::binary);
+        FlightRecorder::Header header;
+        FlightRecorder::Record r;
+        std::vector<FlightRecorder::Record> records;
+
+        EXPECT_TRUE(file.read((char*)&header, sizeof(header)));
+        EXPECT_EQ(memcmp(header.magic, FlightRecorder::magic,
+                         sizeof(header.magic)),
+                  0);
+        EXPECT_EQ(header.version, FlightRecorder::version);
+        EXPECT_EQ(header.recordSize, sizeof(FlightRecorder::Record));
+
+        while (file.read((char*)&r, sizeof(r)))
+        {
+            EXPECT_LE(r.time, header.monotonicTime);
+            records.push_back(r);
+        }
+
+        return records;
+    }
+
+    std::string path;
+};
+
+TEST_F(FlightRecorderTest, KeepsNewestEvents)
+{
+    constexpr uint32_t events = FlightRecorder::capacity + 100;
+
+    for (uint32_t i = 0; i < events; ++i)
+    {
+        FlightRecorder::record(FlightRecorder::Event::frameSent, 1, 2, i);
+    }
+
+    ASSERT_TRUE(FlightRecorder::dump(path.c_str()));
+
+    auto records = readDump();
+
+    ASSERT_EQ(records.size(), FlightRecorder::capacity);
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        EXPECT_EQ(records[i].event,
+                  (uint32_t)FlightRecorder::Event::frameSent);
+        EXPECT_EQ(records[i].args[2], events - FlightRecorder::capacity + i);
+        if (i)
+        {
+            EXPECT_GE(records[i].time, records[i - 1].time);
+        }
+    }
+}
+
+TEST_F(FlightRecorderTest, ConcurrentRecording)
+{
+    std::vector<std::thread> threads;
+
+    for (uint32_t t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([t]() {
+            for (uint32_t i = 0; i < FlightRecorder::capacity; ++i)
+            {
+                FlightRecorder::record(FlightRecorder::Event::hidEagain, t, i,
+                                       ~i);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    ASSERT_TRUE(FlightRecorder::dump(path.c_str()));
+
+    // No record is torn between writers
+    for (const auto& r : readDump())
+    {
+        EXPECT_EQ(r.event, (uint32_t)FlightRecorder::Event::hidEagain);
+        EXPECT_LT(r.args[0], 4u);
+        EXPECT_EQ(r.args[2], ~r.args[1]);
+    }
+}
+
+TEST_F(FlightRecorderTest, DumpsOnSignal)
+{
+    FlightRecorder::record(FlightRecorder::Event::clientConnect, 7, 1);
+    FlightRecorder::dumpOnSignal(path);
+
+    ASSERT_EQ(raise(SIGUSR1), 0);
+
+    auto records = readDump();
+
+    ASSERT_FALSE(records.empty());
+    EXPECT_EQ(records.back().event,
+              (uint32_t)FlightRecorder::Event::clientConnect);
+    EXPECT_EQ(records.back().args[0], 7u);
+
+    signal(SIGUSR1, SIG_DFL);
+}
+
+TEST_F(FlightRecorderTest, ReplacesLinkAtPath)
+{
+    std::string target = path + ".target";
+
+    {
+        std::ofstream file(target);
+
+        file << "kept";
+    }
+    ASSERT_EQ(symlink(target.c_str(), path.c_str()), 0);
+
+    FlightRecorder::record(FlightRecorder::Event::clientConnect, 1, 1);
+    ASSERT_TRUE(FlightRecorder::dump(path.c_str()));
+
+    std::ifstream file(target);
+    std::string contents;
+
+    file >> contents;
+    EXPECT_EQ(contents, "kept");
+    EXPECT_FALSE(std::filesystem::is_symlink(path));
+    EXPECT_FALSE(readDump().empty());
+    EXPECT_FALSE(std::filesystem::exists(path + ".tmp"));
+
+    std::filesystem::remove(target);
+}
+
+TEST_F(FlightRecorderTest, FailsOnBadPath)
+{
+    EXPECT_FALSE(FlightRecorder::dump("/nonexistent/ikvm.flight"));
+}
+
+} // namespace ikvm
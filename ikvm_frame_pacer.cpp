@@ -0,0 +1,136 @@
+#include "ikvm_frame_pacer.hpp"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <thread>
+
+#include <phosphor-logging/lg2.hpp>
+
+namespace ikvm
+{
+
+FramePacer::FramePacer(int fr) :
+    fd(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)), skipped(0),
+    windowFrames(0), achievedRate(0.0)
+{
+    if (fd < 0)
+    {
+        lg2::error("Failed to create the frame timer, sleeping instead: "
+                   "{ERROR}",
+                   "ERROR", strerror(errno));
+    }
+
+    setFrameRate(fr);
+}
+
+FramePacer::~FramePacer()
+{
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+}
+
+void FramePacer::setFrameRate(int fr)
+{
+    interval = std::chrono::duration_cast<Clock::duration>(
+                   std::chrono::seconds(1)) /
+               std::max(fr, 1);
+    deadline = Clock::time_point();
+}
+
+FramePacer::Clock::duration FramePacer::wait()
+{
+    schedule(Clock::now());
+
+    return sleep();
+}
+
+FramePacer::Clock::duration FramePacer::waitUntil(Clock::time_point time)
+{
+    deadline = time;
+
+    return sleep();
+}
+
+FramePacer::Clock::time_point FramePacer::schedule(Clock::time_point now)
+{
+    // The first deadline is now, the next ones follow on the same grid
+    if (deadline == Clock::time_point())
+    {
+        deadline = now;
+        return deadline;
+    }
+
+    deadline += interval;
+    if (deadline < now)
+    {
+        auto missed = (now - deadline) / interval + 1;
+
+        skipped += missed;
+        deadline += missed * interval;
+    }
+
+    return deadline;
+}
+
+void FramePacer::captured(Clock::time_point now)
+{
+    // Frames are counted after the start of the window
+    if (windowStart == Clock::time_point())
+    {
+        windowStart = now;
+        return;
+    }
+
+    windowFrames++;
+    if (now - windowStart >= window)
+    {
+        achievedRate =
+            windowFrames / std::chrono::duration<double>(now - windowStart)
+                               .count();
+        windowStart = now;
+        windowFrames = 0;
+    }
+}
+
+double FramePacer::getAchievedRate(Clock::time_point now) const
+{
+    // A rate is stale once a whole window has gone without completing one
+    return (now - windowStart < 2 * window) ? achievedRate : 0.0;
+}
+
+FramePacer::Clock::duration FramePacer::sleep()
+{
+    // The steady clock is the monotonic clock the timer runs on
+    auto sinceEpoch = deadline.time_since_epoch();
+    auto sec = std::chrono::duration_cast<std::chrono::seconds>(sinceEpoch);
+    itimerspec spec{};
+    uint64_t expirations;
+
+    spec.it_value.tv_sec = sec.count();
+    spec.it_value.tv_nsec =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(sinceEpoch - sec)
+            .count();
+
+    // A zero expiry would disarm the timer rather than fire it
+    if (fd < 0 || deadline <= Clock::now() ||
+        timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, nullptr))
+    {
+        std::this_thread::sleep_until(deadline);
+    }
+    else
+    {
+        while (read(fd, &expirations, sizeof(expirations)) < 0 &&
+               errno == EINTR)
+        {}
+    }
+
+    return Clock::now() - deadline;
+}
+
+} // namespace ikvm
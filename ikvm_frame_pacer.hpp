@@ -0,0 +1,116 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace ikvm
+{
+
+/*
+ * @class FramePacer
+ * @brief Paces the captures on absolute deadlines of the monotonic clock,
+ *        one frame interval apart, waited for on a timerfd
+ *
+ * The time taken to capture and send a frame comes out of the interval
+ * rather than adding to it. Deadlines missed by a late capture are skipped
+ * instead of caught up with, so the frames stay evenly spaced.
+ */
+class FramePacer
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /*
+     * @brief Constructs FramePacer object
+     *
+     * @param[in] fr - Frame rate in frames per second
+     */
+    explicit FramePacer(int fr);
+    ~FramePacer();
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+    FramePacer(FramePacer&&) = delete;
+    FramePacer& operator=(FramePacer&&) = delete;
+
+    /*
+     * @brief Sets the frame rate, restarting the deadlines from the next wait
+     *
+     * @param[in] fr - Value of the frame rate in frames per second
+     */
+    void setFrameRate(int fr);
+    /*
+     * @brief Blocks until the next deadline
+     *
+     * @return Time between the deadline and waking up
+     */
+    Clock::duration wait();
+    /*
+     * @brief Blocks until a given time, which becomes the deadline the next
+     *        ones follow
+     *
+     * @param[in] time - Time to wake up at
+     *
+     * @return Time between the given time and waking up
+     */
+    Clock::duration waitUntil(Clock::time_point time);
+    /*
+     * @brief Moves on to the next deadline after the current one, skipping
+     *        the deadlines already passed
+     *
+     * @param[in] now - Current time
+     *
+     * @return Next deadline
+     */
+    Clock::time_point schedule(Clock::time_point now);
+    /*
+     * @brief Records a captured frame, for the achieved frame rate
+     *
+     * @param[in] now - Time of the capture
+     */
+    void captured(Clock::time_point now);
+
+    /*
+     * @brief Gets the frame rate achieved over the last second
+     *
+     * @param[in] now - Current time
+     *
+     * @return Frames captured per second, 0 if none were lately
+     */
+    double getAchievedRate(Clock::time_point now) const;
+    /*
+     * @brief Gets the number of deadlines skipped
+     *
+     * @return Number of deadlines passed before the pacer waited for them
+     */
+    inline uint64_t getSkipped() const
+    {
+        return skipped;
+    }
+
+  private:
+    /*
+     * @brief Blocks until the deadline on the timer
+     *
+     * @return Time between the deadline and waking up
+     */
+    Clock::duration sleep();
+
+    /* @brief File descriptor of the timer, -1 to sleep the thread instead */
+    int fd;
+    /* @brief Number of deadlines skipped */
+    uint64_t skipped;
+    /* @brief Time between two deadlines */
+    Clock::duration interval;
+    /* @brief Current deadline, unset until the first wait */
+    Clock::time_point deadline;
+    /* @brief Start of the window of the achieved frame rate */
+    Clock::time_point windowStart;
+    /* @brief Number of frames captured in the window */
+    unsigned int windowFrames;
+    /* @brief Frame rate achieved over the last complete window */
+    double achievedRate;
+    /* @brief Length of the window of the achieved frame rate */
+    static constexpr std::chrono::seconds window{1};
+};
+
+} // namespace ikvm
@@ -0,0 +1,82 @@
+#include "ikvm_frame_pacer.hpp"
+
+#include <gtest/gtest.h>
+
+namespace ikvm
+{
+
+using namespace std::chrono_literals;
+
+TEST(FramePacerTest, EvenDeadlines)
+{
+    FramePacer pacer(50);
+    FramePacer::Clock::time_point now = FramePacer::Clock::time_point() + 1s;
+
+    EXPECT_EQ(pacer.schedule(now), now);
+
+    // Time spent on a frame doesn't push the next deadline back
+    EXPECT_EQ(pacer.schedule(now + 5ms), now + 20ms);
+    EXPECT_EQ(pacer.schedule(now + 39ms), now + 40ms);
+    EXPECT_EQ(pacer.schedule(now + 40ms), now + 60ms);
+    EXPECT_EQ(pacer.getSkipped(), 0u);
+}
+
+TEST(FramePacerTest, SkipsMissedDeadlines)
+{
+    FramePacer pacer(50);
+    FramePacer::Clock::time_point now = FramePacer::Clock::time_point() + 1s;
+
+    pacer.schedule(now);
+
+    // Late by two and a half intervals, the next deadline stays on the grid
+    EXPECT_EQ(pacer.schedule(now + 70ms), now + 80ms);
+    EXPECT_EQ(pacer.getSkipped(), 3u);
+    EXPECT_EQ(pacer.schedule(now + 81ms), now + 100ms);
+    EXPECT_EQ(pacer.getSkipped(), 3u);
+}
+
+TEST(FramePacerTest, RestartsOnRateChangeAndBurst)
+{
+    FramePacer pacer(50);
+    FramePacer::Clock::time_point now = FramePacer::Clock::time_point() + 1s;
+
+    pacer.schedule(now);
+    pacer.setFrameRate(10);
+    EXPECT_EQ(pacer.schedule(now + 7ms), now + 7ms);
+    EXPECT_EQ(pacer.schedule(now + 8ms), now + 107ms);
+
+    // A burst capture moves the grid without skipping deadlines
+    pacer.waitUntil(FramePacer::Clock::now());
+    now = FramePacer::Clock::now();
+    EXPECT_GT(pacer.schedule(now), now);
+    EXPECT_EQ(pacer.getSkipped(), 0u);
+}
+
+TEST(FramePacerTest, AchievedRate)
+{
+    FramePacer pacer(30);
+    FramePacer::Clock::time_point now = FramePacer::Clock::time_point() + 1s;
+
+    for (int i = 0; i <= 25; ++i)
+    {
+        pacer.captured(now + i * 40ms);
+    }
+    EXPECT_NEAR(pacer.getAchievedRate(now + 1s), 25.0, 0.001);
+    EXPECT_NEAR(pacer.getAchievedRate(now + 2900ms), 25.0, 0.001);
+    EXPECT_EQ(pacer.getAchievedRate(now + 3s), 0.0);
+}
+
+TEST(FramePacerTest, WaitsForDeadline)
+{
+    FramePacer pacer(100);
+    auto start = FramePacer::Clock::now();
+
+    pacer.wait();
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_GE(pacer.wait(), 0ns);
+    }
+    EXPECT_GE(FramePacer::Clock::now() - start, 30ms);
+}
+
+} // namespace ikvm
@@ -0,0 +1,239 @@
+#pragma once
+
+#include "ikvm_video_signal.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace ikvm
+{
+
+/*
+ * @class FrameSource
+ * @brief Interface of the backends providing video frames to the server
+ */
+class FrameSource
+{
+  public:
+    /*
+     * @brief Constructs FrameSource object
+     *
+     * @param[in] fr  - desired frame rate of the video
+     * @param[in] sub - desired jpeg subsampling, 1:420/0:444
+     */
+    FrameSource(int fr, int sub) :
+        frameRate(fr), height(600), width(800), subSampling(sub),
+        quality(-1), qualityMin(0), qualityMax(100), pixelformat(0),
+        errorCount(0)
+    {}
+    virtual ~FrameSource() = default;
+    FrameSource(const FrameSource&) = default;
+    FrameSource& operator=(const FrameSource&) = delete;
+    FrameSource(FrameSource&&) = default;
+    FrameSource& operator=(FrameSource&&) = delete;
+
+    /*
+     * @brief Gets the video frame data
+     *
+     * @return Pointer to the video frame data
+     */
+    virtual char* getData() = 0;
+    /* @brief Performs read to grab latest video frame */
+    virtual void getFrame() = 0;
+    /*
+     * @brief Probes the source for the pixel format and sets the
+     *        corresponding class variables
+     */
+    virtual void probePixelFormat() = 0;
+    /*
+     * @brief Gets whether or not the video frame needs to be resized
+     *
+     * @return Boolean indicating if the frame needs to be resized
+     */
+    virtual bool needsResize() = 0;
+    /* @brief Performs the resize and re-allocates framebuffer */
+    virtual void resize() = 0;
+    /* @brief Starts streaming from the source */
+    virtual void start() = 0;
+    /* @brief Stops streaming from the source */
+    virtual void stop() = 0;
+    /*
+     * @brief Gets the size of the video frame data
+     *
+     * @return Value of the size of the video frame data in bytes
+     */
+    virtual size_t getFrameSize() const = 0;
+
+    /* @brief Restarts streaming from the source */
+    void restart()
+    {
+        stop();
+        start();
+    }
+
+    /*
+     * @brief Gets the time at which the current frame was captured
+     *
+     * @return Capture time on the steady clock
+     */
+    inline std::chrono::steady_clock::time_point getCaptureTime() const
+    {
+        return captureTime;
+    }
+    /*
+     * @brief Gets the time at which the current frame was received from
+     *        the source
+     *
+     * @return Dequeue time on the steady clock
+     */
+    inline std::chrono::steady_clock::time_point getDequeueTime() const
+    {
+        return dequeueTime;
+    }
+    /*
+     * @brief Gets the number of frames the source failed to capture
+     *
+     * @return Number of error frames
+     */
+    inline uint64_t getErrorCount() const
+    {
+        return errorCount;
+    }
+    /*
+     * @brief Gets the state of the input signal of the source
+     *
+     * @return Reference to the signal state
+     */
+    inline const VideoSignal& getSignal() const
+    {
+        return signal;
+    }
+    /*
+     * @brief Gets the desired video frame rate in frames per second
+     *
+     * @return Value of the desired frame rate
+     */
+    inline int getFrameRate() const
+    {
+        return frameRate;
+    }
+    /*
+     * @brief Gets the height of the video frame
+     *
+     * @return Value of the height of video frame in pixels
+     */
+    inline size_t getHeight() const
+    {
+        return height;
+    }
+    /*
+     * @brief Gets the pixel format  of the video frame
+     *
+     * @return Value of the pixel format of video frame */
+    inline uint32_t getPixelformat() const
+    {
+        return pixelformat;
+    }
+    /*
+     * @brief Gets the width of the video frame
+     *
+     * @return Value of the width of video frame in pixels
+     */
+    inline size_t getWidth() const
+    {
+        return width;
+    }
+    /*
+     * @brief Gets the subsampling of the video frame
+     *
+     * @return Value of the subsampling of video frame, 1:420/0:444
+     */
+    inline int getSubsampling() const
+    {
+        return subSampling;
+    }
+    /*
+     * @brief Sets the subsampling of the video frame
+     *
+     * @param[in] _sub - Value of the subsampling of video frame, 1:420/0:444
+     */
+    virtual void setSubsampling(int _sub)
+    {
+        subSampling = _sub;
+    }
+    /*
+     * @brief Sets the desired video frame rate
+     *
+     * @param[in] fr - Value of the frame rate in frames per second
+     */
+    virtual void setFrameRate(int fr)
+    {
+        frameRate = fr;
+    }
+    /*
+     * @brief Gets the JPEG quality of the video frame
+     *
+     * @return Value of the quality, -1 if left to the source
+     */
+    inline int getQuality() const
+    {
+        return quality;
+    }
+    /*
+     * @brief Sets the JPEG quality of the video frame
+     *
+     * @param[in] q - Value of the quality, -1 to leave it to the source
+     */
+    virtual void setQuality(int q)
+    {
+        quality = q;
+    }
+    /*
+     * @brief Gets the range of the JPEG quality the source accepts, known
+     *        once the pixel format is probed
+     *
+     * @return Lowest and highest quality, the highest below the lowest if
+     *         the quality can't be set
+     */
+    inline std::pair<int, int> getQualityRange() const
+    {
+        return {qualityMin, qualityMax};
+    }
+
+    /* @brief Number of bits per component of a pixel */
+    static inline int bitsPerSample = 8;
+    /* @brief Number of bytes of storage for a pixel */
+    static inline int bytesPerPixel = 4;
+    /* @brief Number of components in a pixel (i.e. 3 for RGB pixel) */
+    static inline int samplesPerPixel = 3;
+
+  protected:
+    /* @brief Desired frame rate of video stream in frames per second */
+    int frameRate;
+    /* @brief Height in pixels of the video frame */
+    size_t height;
+    /* @brief Width in pixels of the video frame */
+    size_t width;
+    /* @brief jpeg's subsampling, 1:420/0:444 */
+    int subSampling;
+    /* @brief jpeg's quality, -1 if left to the source */
+    int quality;
+    /* @brief Lowest jpeg's quality the source accepts */
+    int qualityMin;
+    /* @brief Highest jpeg's quality the source accepts */
+    int qualityMax;
+    /* @brief Pixel Format  */
+    uint32_t pixelformat;
+    /* @brief Number of frames the source failed to capture */
+    uint64_t errorCount;
+    /* @brief State of the input signal, always present unless lost */
+    VideoSignal signal;
+    /* @brief Time at which the current frame was captured */
+    std::chrono::steady_clock::time_point captureTime;
+    /* @brief Time at which the current frame was received from the source */
+    std::chrono::steady_clock::time_point dequeueTime;
+};
+
+} // namespace ikvm
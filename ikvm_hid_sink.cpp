@@ -0,0 +1,399 @@
+#include "ikvm_hid_sink.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+
+#include <phosphor-logging/elog-errors.hpp>
+#include <phosphor-logging/elog.hpp>
+#include <phosphor-logging/lg2.hpp>
+#include <xyz/openbmc_project/Common/File/error.hpp>
+
+namespace fs = std::filesystem;
+
+namespace ikvm
+{
+using namespace phosphor::logging;
+using namespace sdbusplus::xyz::openbmc_project::Common::File::Error;
+
+GadgetSink::GadgetSink(const std::string& kbdPath, const std::string& ptrPath,
+                       const std::string& udc) :
+    keyboardFd(-1), pointerFd(-1), nkroKeyboardFd(-1), keyboardPath(kbdPath),
+    pointerPath(ptrPath), udcName(udc)
+{
+    hidUdcStream.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+    hidUdcStream.open(hidUdcPath, std::ios::out | std::ios::app);
+}
+
+GadgetSink::~GadgetSink()
+{
+    disconnect();
+    hidUdcStream.close();
+}
+
+void GadgetSink::connect()
+{
+    try
+    {
+        if (udcName.empty())
+        {
+            bool found = false;
+            for (const auto& port : fs::directory_iterator(usbVirtualHubPath))
+            {
+                // /sys/bus/platform/devices/1e6a0000.usb-vhub/
+                //     1e6a0000.usb-vhub:pX
+                if (fs::is_directory(port) && !fs::is_symlink(port))
+                {
+                    for (const auto& gadget :
+                         fs::directory_iterator(port.path()))
+                    {
+                        // Kernel 6.0:
+                        // /sys/.../1e6a0000.usb-vhub:pX/gadget.Y/suspended
+                        // Kernel 5.15:
+                        // /sys/.../1e6a0000.usb-vhub:pX/gadget/suspended
+                        if (fs::is_directory(gadget) &&
+                            gadget.path().string().find("gadget") !=
+                                std::string::npos &&
+                            !fs::exists(gadget.path() / "suspended"))
+                        {
+                            const std::string portId = port.path().filename();
+                            hidUdcStream << portId << std::endl;
+                            found = true;
+                            break;
+                        }
+                    }
+                }
+                if (found)
+                {
+                    break;
+                }
+            }
+        }
+        else // If UDC has been specified by '-u' parameter, connect to it.
+        {
+            hidUdcStream << udcName << std::endl;
+        }
+    }
+    catch (fs::filesystem_error& e)
+    {
+        lg2::error("Failed to search USB virtual hub port {ERROR}", "ERROR",
+                   e.what());
+        return;
+    }
+    catch (std::ofstream::failure& e)
+    {
+        lg2::error("Failed to connect HID gadget {ERROR}", "ERROR", e.what());
+        return;
+    }
+
+    if (!keyboardPath.empty())
+    {
+        keyboardFd =
+            open(keyboardPath.c_str(), O_RDWR | O_CLOEXEC | O_NONBLOCK);
+        if (keyboardFd < 0)
+        {
+            lg2::error("Failed to open input device {PATH} {ERROR}", "PATH",
+                       keyboardPath.c_str(), "ERROR", strerror(errno));
+            elog<Open>(xyz::openbmc_project::Common::File::Open::ERRNO(errno),
+                       xyz::openbmc_project::Common::File::Open::PATH(
+                           keyboardPath.c_str()));
+        }
+    }
+
+    if (!pointerPath.empty())
+    {
+        pointerFd = open(pointerPath.c_str(), O_RDWR | O_CLOEXEC | O_NONBLOCK);
+        if (pointerFd < 0)
+        {
+            lg2::error("Failed to open input device {PATH} {ERROR}", "PATH",
+                       pointerPath.c_str(), "ERROR", strerror(errno));
+            elog<Open>(xyz::openbmc_project::Common::File::Open::ERRNO(errno),
+                       xyz::openbmc_project::Common::File::Open::PATH(
+                           pointerPath.c_str()));
+        }
+    }
+
+    if (!keyboardPath.empty())
+    {
+        openNkroKeyboard();
+    }
+}
+
+void GadgetSink::openNkroKeyboard()
+{
+    std::ifstream devStream(hidNkroKeyboardDevPath);
+    unsigned int major;
+    unsigned int minor;
+    char colon;
+
+    // The hidg device nodes are numbered after the minor of the function
+    if (!(devStream >> major >> colon >> minor))
+    {
+        return;
+    }
+
+    std::string path = "/dev/hidg" + std::to_string(minor);
+
+    // The boot protocol keyboard still works without it
+    nkroKeyboardFd = open(path.c_str(), O_RDWR | O_CLOEXEC | O_NONBLOCK);
+    if (nkroKeyboardFd < 0)
+    {
+        lg2::error("Failed to open input device {PATH} {ERROR}", "PATH", path,
+                   "ERROR", strerror(errno));
+        return;
+    }
+
+    lg2::info("Using N-key rollover keyboard {PATH}", "PATH", path);
+}
+
+void GadgetSink::disconnect()
+{
+    if (keyboardFd >= 0)
+    {
+        close(keyboardFd);
+        keyboardFd = -1;
+    }
+
+    if (pointerFd >= 0)
+    {
+        close(pointerFd);
+        pointerFd = -1;
+    }
+
+    if (nkroKeyboardFd >= 0)
+    {
+        close(nkroKeyboardFd);
+        nkroKeyboardFd = -1;
+    }
+
+    try
+    {
+        hidUdcStream << "" << std::endl;
+    }
+    catch (std::ofstream::failure& e)
+    {
+        lg2::error("Failed to disconnect HID gadget {ERROR}", "ERROR",
+                   e.what());
+    }
+}
+
+bool GadgetSink::isOpen(Device d) const
+{
+    return getFd(d) >= 0;
+}
+
+ssize_t GadgetSink::write(Device d, const uint8_t* report, size_t len)
+{
+    return ::write(getFd(d), report, len);
+}
+
+int GadgetSink::poll(Device d, std::chrono::milliseconds timeout)
+{
+    pollfd pfd = {getFd(d), POLLOUT, 0};
+    int rc = ::poll(&pfd, 1, timeout.count());
+
+    if (rc > 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)))
+    {
+        // The gadget hangs up when the host disconnects
+        errno = ESHUTDOWN;
+        return -1;
+    }
+
+    return rc;
+}
+
+LocalSink::LocalSink(const std::string& p, size_t c) :
+    connected(false), fd(-1), nkroKeyboard(false), eagainEvery(0),
+    writeCount(0), eagainCount(0), next(0), capacity(std::max(c, (size_t)1)),
+    pollInterval(0)
+{
+    if (p.empty())
+    {
+        return;
+    }
+
+    // Opening a FIFO blocks until the reader has opened it as well
+    fd = open(p.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        lg2::error("Failed to open input record file {PATH} {ERROR}", "PATH",
+                   p, "ERROR", strerror(errno));
+        elog<Open>(xyz::openbmc_project::Common::File::Open::ERRNO(errno),
+                   xyz::openbmc_project::Common::File::Open::PATH(p.c_str()));
+    }
+}
+
+LocalSink::~LocalSink()
+{
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+}
+
+void LocalSink::connect()
+{
+    std::lock_guard<std::mutex> lk(mutex);
+
+    connected = true;
+}
+
+void LocalSink::disconnect()
+{
+    std::lock_guard<std::mutex> lk(mutex);
+
+    connected = false;
+}
+
+bool LocalSink::isOpen(Device d) const
+{
+    std::lock_guard<std::mutex> lk(mutex);
+
+    return connected && (d != Device::nkroKeyboard || nkroKeyboard);
+}
+
+ssize_t LocalSink::write(Device d, const uint8_t* report, size_t len)
+{
+    std::lock_guard<std::mutex> lk(mutex);
+    auto now = std::chrono::steady_clock::now();
+    Record record;
+
+    if (!connected || (d == Device::nkroKeyboard && !nkroKeyboard))
+    {
+        errno = ESHUTDOWN;
+        return -1;
+    }
+
+    if (len > sizeof(record.report))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // The host hasn't polled the previous report yet
+    writeCount++;
+    if (now < readyTime[(int)d] || (eagainEvery && !(writeCount % eagainEvery)))
+    {
+        eagainCount++;
+        errno = EAGAIN;
+        return -1;
+    }
+    readyTime[(int)d] = now + pollInterval;
+
+    memset(&record, 0, sizeof(record));
+    record.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           now.time_since_epoch())
+                           .count();
+    record.device = (uint8_t)d;
+    record.length = (uint8_t)len;
+    memcpy(record.report, report, len);
+
+    if (records.size() < capacity)
+    {
+        records.push_back(record);
+    }
+    else
+    {
+        records[next] = record;
+        next = (next + 1) % capacity;
+    }
+
+    if (fd >= 0 && ::write(fd, &record, sizeof(record)) != sizeof(record))
+    {
+        lg2::error("Failed to write input record {ERROR}", "ERROR",
+                   strerror(errno));
+    }
+
+    return len;
+}
+
+int LocalSink::poll(Device d, std::chrono::milliseconds timeout)
+{
+    std::chrono::steady_clock::time_point ready;
+
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+
+        if (!connected)
+        {
+            errno = ESHUTDOWN;
+            return -1;
+        }
+
+        ready = readyTime[(int)d];
+    }
+
+    auto now = std::chrono::steady_clock::now();
+
+    if (ready <= now)
+    {
+        return 1;
+    }
+
+    if (ready - now > timeout)
+    {
+        std::this_thread::sleep_for(timeout);
+        return 0;
+    }
+
+    std::this_thread::sleep_until(ready);
+    return 1;
+}
+
+void LocalSink::setPollInterval(std::chrono::microseconds interval)
+{
+    std::lock_guard<std::mutex> lk(mutex);
+
+    pollInterval = interval;
+}
+
+void LocalSink::setEagainEvery(unsigned int n)
+{
+    std::lock_guard<std::mutex> lk(mutex);
+
+    eagainEvery = n;
+}
+
+void LocalSink::setNkroKeyboard(bool present)
+{
+    std::lock_guard<std::mutex> lk(mutex);
+
+    nkroKeyboard = present;
+}
+
+std::vector<LocalSink::Record> LocalSink::getRecords() const
+{
+    std::lock_guard<std::mutex> lk(mutex);
+    std::vector<Record> ordered;
+
+    ordered.reserve(records.size());
+    ordered.insert(ordered.end(), records.begin() + next, records.end());
+    ordered.insert(ordered.end(), records.begin(), records.begin() + next);
+
+    return ordered;
+}
+
+void LocalSink::clearRecords()
+{
+    std::lock_guard<std::mutex> lk(mutex);
+
+    records.clear();
+    next = 0;
+    writeCount = 0;
+    eagainCount = 0;
+}
+
+uint64_t LocalSink::getEagainCount() const
+{
+    std::lock_guard<std::mutex> lk(mutex);
+
+    return eagainCount;
+}
+
+} // namespace ikvm
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ikvm
+{
+
+/*
+ * @class HidSink
+ * @brief Interface of the backends delivering HID reports to the host
+ */
+class HidSink
+{
+  public:
+    /* @brief HID devices presented to the host */
+    enum class Device
+    {
+        keyboard,
+        pointer,
+        /* @brief Report protocol keyboard with a bitmap of the keys that
+         *        don't fit in the boot protocol keyboard report */
+        nkroKeyboard,
+    };
+
+    HidSink() = default;
+    virtual ~HidSink() = default;
+    HidSink(const HidSink&) = delete;
+    HidSink& operator=(const HidSink&) = delete;
+    HidSink(HidSink&&) = delete;
+    HidSink& operator=(HidSink&&) = delete;
+
+    /* @brief Connects the HID devices to the host */
+    virtual void connect() = 0;
+    /* @brief Disconnects the HID devices from the host */
+    virtual void disconnect() = 0;
+    /*
+     * @brief Gets whether or not a device accepts reports
+     *
+     * @param[in] d - HID device
+     *
+     * @return Boolean indicating if the device is open
+     */
+    virtual bool isOpen(Device d) const = 0;
+    /*
+     * @brief Writes a report to a device without blocking
+     *
+     * @param[in] d      - HID device
+     * @param[in] report - Report data
+     * @param[in] len    - Length of the report
+     *
+     * @return Number of bytes written, or -1 with errno set; EAGAIN if the
+     *         host hasn't read the previous report yet
+     */
+    virtual ssize_t write(Device d, const uint8_t* report, size_t len) = 0;
+    /*
+     * @brief Waits until a device accepts a new report
+     *
+     * @param[in] d       - HID device
+     * @param[in] timeout - Maximum time to wait
+     *
+     * @return 1 if the device is writable, 0 on timeout, or -1 with errno
+     *         set; ESHUTDOWN if the host has gone away
+     */
+    virtual int poll(Device d, std::chrono::milliseconds timeout) = 0;
+};
+
+/*
+ * @class GadgetSink
+ * @brief Delivers HID reports through the USB HID gadget of the BMC
+ */
+class GadgetSink : public HidSink
+{
+  public:
+    /*
+     * @brief Constructs GadgetSink object
+     *
+     * @param[in] kbdPath - Path to the USB keyboard device
+     * @param[in] ptrPath - Path to the USB mouse device
+     * @param[in] udc     - Name of UDC
+     */
+    GadgetSink(const std::string& kbdPath, const std::string& ptrPath,
+               const std::string& udc);
+    ~GadgetSink() override;
+    GadgetSink(const GadgetSink&) = delete;
+    GadgetSink& operator=(const GadgetSink&) = delete;
+    GadgetSink(GadgetSink&&) = delete;
+    GadgetSink& operator=(GadgetSink&&) = delete;
+
+    /* @brief Connects HID gadget to host and opens the devices */
+    void connect() override;
+    /* @brief Closes the devices and disconnects HID gadget from host */
+    void disconnect() override;
+    bool isOpen(Device d) const override;
+    ssize_t write(Device d, const uint8_t* report, size_t len) override;
+    int poll(Device d, std::chrono::milliseconds timeout) override;
+
+  private:
+    /* @brief Path to the HID gadget UDC */
+    static constexpr const char* hidUdcPath =
+        "/sys/kernel/config/usb_gadget/obmc_hid/UDC";
+    /* @brief Path to the device number of the N-key rollover keyboard
+     *        function, which exists if create_usbhid.sh was run in nkro mode */
+    static constexpr const char* hidNkroKeyboardDevPath =
+        "/sys/kernel/config/usb_gadget/obmc_hid/functions/hid.2/dev";
+    /* @brief Path to the USB virtual hub */
+    static constexpr const char* usbVirtualHubPath =
+        "/sys/bus/platform/devices/1e6a0000.usb-vhub";
+
+    /*
+     * @brief Gets the file descriptor of a device
+     *
+     * @param[in] d - HID device
+     */
+    inline int getFd(Device d) const
+    {
+        switch (d)
+        {
+            case Device::keyboard:
+                return keyboardFd;
+            case Device::pointer:
+                return pointerFd;
+            case Device::nkroKeyboard:
+                return nkroKeyboardFd;
+        }
+
+        return -1;
+    }
+
+    /* @brief Opens the N-key rollover keyboard device if the gadget has one */
+    void openNkroKeyboard();
+
+    /* @brief File descriptor for the USB keyboard device */
+    int keyboardFd;
+    /* @brief File descriptor for the USB mouse device */
+    int pointerFd;
+    /* @brief File descriptor for the USB N-key rollover keyboard device */
+    int nkroKeyboardFd;
+    /* @brief Path to the USB keyboard device */
+    std::string keyboardPath;
+    /* @brief Path to the USB mouse device */
+    std::string pointerPath;
+    /* @brief Name of UDC */
+    std::string udcName;
+    /* @brief Handle of the HID gadget UDC */
+    std::ofstream hidUdcStream;
+};
+
+/*
+ * @class LocalSink
+ * @brief Stand-in for the USB HID gadget that records timestamped reports
+ *        to an in-memory ring and optionally to a file, FIFO or pipe, for
+ *        measuring the input path outside of a BMC
+ */
+class LocalSink : public HidSink
+{
+  public:
+    /*
+     * @struct Record
+     * @brief Report as written to the device, also the format of the
+     *        records written to the output file
+     */
+    struct Record
+    {
+        /* @brief Time of the write on the steady clock in nanoseconds */
+        uint64_t timestamp;
+        /* @brief Device written to, a HidSink::Device value */
+        uint8_t device;
+        /* @brief Length of the report */
+        uint8_t length;
+        /* @brief Report data */
+        uint8_t report[30];
+    };
+
+    /*
+     * @brief Constructs LocalSink object
+     *
+     * @param[in] p - Path to write records to, e.g. a FIFO or /dev/fd/N
+     *                for an inherited pipe; empty to only keep them in
+     *                memory
+     * @param[in] c - Number of most recent records kept in memory
+     */
+    explicit LocalSink(const std::string& p = "", size_t c = 4096);
+    ~LocalSink() override;
+    LocalSink(const LocalSink&) = delete;
+    LocalSink& operator=(const LocalSink&) = delete;
+    LocalSink(LocalSink&&) = delete;
+    LocalSink& operator=(LocalSink&&) = delete;
+
+    void connect() override;
+    void disconnect() override;
+    bool isOpen(Device d) const override;
+    ssize_t write(Device d, const uint8_t* report, size_t len) override;
+    int poll(Device d, std::chrono::milliseconds timeout) override;
+
+    /*
+     * @brief Sets how long the host takes to read a report; writes within
+     *        that time after the previous one fail with EAGAIN
+     *
+     * @param[in] interval - Polling interval of the emulated host
+     */
+    void setPollInterval(std::chrono::microseconds interval);
+    /*
+     * @brief Makes every n-th write attempt fail with EAGAIN
+     *
+     * @param[in] n - Period of the injected failures, 0 to disable
+     */
+    void setEagainEvery(unsigned int n);
+    /*
+     * @brief Sets whether the emulated gadget has an N-key rollover
+     *        keyboard besides the boot protocol one
+     *
+     * @param[in] present - Boolean indicating if the device is present
+     */
+    void setNkroKeyboard(bool present);
+
+    /*
+     * @brief Gets the records kept in memory, oldest first
+     *
+     * @return Copy of the records
+     */
+    std::vector<Record> getRecords() const;
+    /* @brief Clears the records kept in memory and the counters */
+    void clearRecords();
+    /*
+     * @brief Gets the number of writes that failed with EAGAIN
+     *
+     * @return Number of rejected writes
+     */
+    uint64_t getEagainCount() const;
+
+  private:
+    /* @brief Boolean to indicate whether the devices are connected */
+    bool connected;
+    /* @brief File descriptor for the output file, -1 if none */
+    int fd;
+    /* @brief Boolean to indicate whether there is an N-key rollover keyboard */
+    bool nkroKeyboard;
+    /* @brief Period of injected EAGAIN failures, 0 if disabled */
+    unsigned int eagainEvery;
+    /* @brief Number of write attempts */
+    uint64_t writeCount;
+    /* @brief Number of writes that failed with EAGAIN */
+    uint64_t eagainCount;
+    /* @brief Index of the next record to overwrite once the ring is full */
+    size_t next;
+    /* @brief Maximum number of records kept in memory */
+    size_t capacity;
+    /* @brief Polling interval of the emulated host */
+    std::chrono::microseconds pollInterval;
+    /* @brief Time at which each device accepts its next report */
+    std::chrono::steady_clock::time_point readyTime[3];
+    /* @brief Ring of the most recent records */
+    std::vector<Record> records;
+    /* @brief Mutex for the records and counters */
+    mutable std::mutex mutex;
+};
+
+} // namespace ikvm
@@ -0,0 +1,146 @@
+/*
+ * Stand-in for the chassis state service, to test suspending the capture
+ * without a host: run it with obmc-ikvm on a private session bus, e.g.
+ * under dbus-run-session, and change the power state with busctl --user
+ * set-property or let the stand-in toggle it.
+ */
+
+#include "ikvm_dbus.hpp"
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <sdbusplus/asio/connection.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+
+namespace ikvm
+{
+
+/* @brief Chassis power state of a powered host */
+static constexpr const char* chassisPowerOn =
+    "xyz.openbmc_project.State.Chassis.PowerState.On";
+
+/*
+ * @struct Options
+ * @brief Options of the stand-in
+ */
+struct Options
+{
+    bool off = false;
+    /* @brief Seconds between toggles of the power state, 0 for never */
+    int toggle = 0;
+};
+
+static void printUsage()
+{
+    fprintf(stderr, "Usage: ikvm_host_standin [options]\n");
+    fprintf(stderr, "-o, --off              Start with the host powered off\n");
+    fprintf(stderr, "-t, --toggle seconds   Toggle the power state (never)\n");
+    fprintf(stderr, "-h, --help             Show this message and exit\n");
+}
+
+static Options parseOptions(int argc, char* argv[])
+{
+    Options options;
+    int option;
+    const char* opts = "ot:h";
+    struct option lopts[] = {{"off", 0, nullptr, 'o'},
+                             {"toggle", 1, nullptr, 't'},
+                             {"help", 0, nullptr, 'h'},
+                             {nullptr, 0, nullptr, 0}};
+
+    while ((option = getopt_long(argc, argv, opts, lopts, nullptr)) != -1)
+    {
+        switch (option)
+        {
+            case 'o':
+                options.off = true;
+                break;
+            case 't':
+                options.toggle = std::max(atoi(optarg), 0);
+                break;
+            case 'h':
+                printUsage();
+                exit(0);
+            default:
+                printUsage();
+                exit(1);
+        }
+    }
+
+    return options;
+}
+
+/*
+ * @brief Toggles the power state periodically
+ *
+ * @param[in] timer  - Timer of the toggles
+ * @param[in] iface  - Chassis state interface
+ * @param[in] period - Time between toggles
+ * @param[in] off    - Whether the host is currently powered off
+ */
+static void scheduleToggle(
+    boost::asio::steady_timer& timer,
+    const std::shared_ptr<sdbusplus::asio::dbus_interface>& iface,
+    std::chrono::seconds period, bool off)
+{
+    timer.expires_after(period);
+    timer.async_wait(
+        [&timer, iface, period, off](const boost::system::error_code& ec) {
+            if (ec)
+            {
+                return;
+            }
+
+            iface->set_property("CurrentPowerState",
+                                std::string(off ? chassisPowerOn
+                                                : DBus::chassisPowerOff));
+            printf("Power %s\n", off ? "on" : "off");
+            fflush(stdout);
+            scheduleToggle(timer, iface, period, !off);
+        });
+}
+
+static int run(const Options& options)
+{
+    boost::asio::io_context io;
+    auto conn = std::make_shared<sdbusplus::asio::connection>(io);
+    sdbusplus::asio::object_server server(conn);
+    boost::asio::steady_timer timer(io);
+
+    conn->request_name(DBus::chassisService);
+
+    auto iface = server.add_interface(DBus::chassisPath,
+                                      DBus::chassisInterface);
+
+    iface->register_property(
+        "CurrentPowerState",
+        std::string(options.off ? DBus::chassisPowerOff : chassisPowerOn),
+        sdbusplus::asio::PropertyPermission::readWrite);
+    iface->initialize();
+
+    if (options.toggle)
+    {
+        scheduleToggle(timer, iface, std::chrono::seconds(options.toggle),
+                       options.off);
+    }
+
+    io.run();
+
+    return 0;
+}
+
+} // namespace ikvm
+
+int main(int argc, char* argv[])
+{
+    return ikvm::run(ikvm::parseOptions(argc, argv));
+}
@@ -1,296 +1,474 @@
 #include "ikvm_input.hpp"
 
+#include "ikvm_flight_recorder.hpp"
 #include "ikvm_server.hpp"
+#include "ikvm_trace.hpp"
 #include "scancodes.hpp"
 
 #include <err.h>
 #include <errno.h>
-#include <fcntl.h>
 #include <rfb/keysym.h>
-#include <sys/stat.h>
 #include <sys/types.h>
 
-#include <phosphor-logging/elog-errors.hpp>
-#include <phosphor-logging/elog.hpp>
-#include <phosphor-logging/lg2.hpp>
-#include <xyz/openbmc_project/Common/File/error.hpp>
+#include <algorithm>
 
-namespace fs = std::filesystem;
+#include <phosphor-logging/lg2.hpp>
 
 namespace ikvm
 {
-using namespace phosphor::logging;
-using namespace sdbusplus::xyz::openbmc_project::Common::File::Error;
 
-Input::Input(const std::string& kbdPath, const std::string& ptrPath,
-             const std::string& udc) :
-    keyboardFd(-1), pointerFd(-1), keyboardReport{0}, pointerReport{0},
-    keyboardPath(kbdPath), pointerPath(ptrPath), udcName(udc)
+Input::Input(std::unique_ptr<HidSink> s, const std::string& layout) :
+    levelScancode(0), levelModifiers(0), keyboardReport{0}, nkroReport{0},
+    pointerReport{0},
+    sink(std::move(s)), pointerCoalescer(PTR_REPORT_INTERVAL),
+    pasteCancel(false), pasteEnabled(false), pasteStatus{false, 0, 0, 0.0},
+    eventCount(0), lastEventTime(0)
 {
-    hidUdcStream.exceptions(std::ofstream::failbit | std::ofstream::badbit);
-    hidUdcStream.open(hidUdcPath, std::ios::out | std::ios::app);
-}
+    auto l = Keymap::parseLayout(layout);
 
-Input::~Input()
-{
-    if (keyboardFd >= 0)
+    if (l)
     {
-        close(keyboardFd);
+        keymap = Keymap(*l);
     }
-
-    if (pointerFd >= 0)
+    else
     {
-        close(pointerFd);
+        lg2::error("Unknown keyboard layout {LAYOUT}, using us", "LAYOUT",
+                   layout);
     }
+}
 
-    disconnect();
-    hidUdcStream.close();
+Input::~Input()
+{
+    cancelPaste();
 }
 
 void Input::connect()
 {
-    try
+    sink->connect();
+}
+
+void Input::disconnect()
+{
+    cancelPaste();
+    sink->disconnect();
+}
+
+void Input::keyEvent(rfbBool down, rfbKeySym key, rfbClientPtr cl)
+{
+    Server::ClientData* cd = (Server::ClientData*)cl->clientData;
+    Input* input = cd->input;
+    std::optional<HidSink::Device> sendKeyboard;
+    /* Account the event and update the activity time for session timeout */
+    cd->inputEvent();
+
+    if (!input->sink->isOpen(HidSink::Device::keyboard))
+    {
+        return;
+    }
+
+    // Typing by hand takes over from any paste in progress
+    input->pasteCancel = true;
+
+    std::unique_lock<std::mutex> keLock(input->keyEventMutex);
+
+    Keymap::KeyCode code = input->keymap.lookup(key);
+    uint8_t sc = code.scancode;
+
+    if (sc)
     {
-        if (udcName.empty())
+        // Unless the host is US, type characters with the modifiers the
+        // host layout needs rather than those held on the client
+        if (down && input->keymap.getLayout() != Keymap::Layout::us &&
+            (key < 0xff00 || key > 0xffff))
         {
-            bool found = false;
-            for (const auto& port : fs::directory_iterator(usbVirtualHubPath))
-            {
-                // /sys/bus/platform/devices/1e6a0000.usb-vhub/1e6a0000.usb-vhub:pX
-                if (fs::is_directory(port) && !fs::is_symlink(port))
-                {
-                    for (const auto& gadget :
-                         fs::directory_iterator(port.path()))
-                    {
-                        // Kernel 6.0:
-                        // /sys/.../1e6a0000.usb-vhub:pX/gadget.Y/suspended
-                        // Kernel 5.15:
-                        // /sys/.../1e6a0000.usb-vhub:pX/gadget/suspended
-                        if (fs::is_directory(gadget) &&
-                            gadget.path().string().find("gadget") !=
-                                std::string::npos &&
-                            !fs::exists(gadget.path() / "suspended"))
-                        {
-                            const std::string portId = port.path().filename();
-                            hidUdcStream << portId << std::endl;
-                            found = true;
-                            break;
-                        }
-                    }
-                }
-                if (found)
-                {
-                    break;
-                }
-            }
+            input->levelScancode = sc;
+            input->levelModifiers = code.modifiers;
         }
-        else // If UDC has been specified by '-u' parameter, connect to it.
+        else if (!down && sc == input->levelScancode)
         {
-            hidUdcStream << udcName << std::endl;
+            input->levelScancode = 0;
         }
+
+        sendKeyboard = input->updateKey(sc, down);
     }
-    catch (fs::filesystem_error& e)
+    else
     {
-        lg2::error("Failed to search USB virtual hub port {ERROR}", "ERROR",
-                   e.what());
-        return;
+        uint8_t mod = keyToMod(key);
+
+        if (mod)
+        {
+            if (down)
+            {
+                input->keyboardReport[0] |= mod;
+            }
+            else
+            {
+                input->keyboardReport[0] &= ~mod;
+            }
+            sendKeyboard = HidSink::Device::keyboard;
+        }
     }
-    catch (std::ofstream::failure& e)
+
+    uint8_t report[NKRO_REPORT_LENGTH];
+
+    if (sendKeyboard == HidSink::Device::nkroKeyboard)
     {
-        lg2::error("Failed to connect HID gadget {ERROR}", "ERROR", e.what());
-        return;
+        memcpy(report, input->nkroReport, NKRO_REPORT_LENGTH);
     }
-
-    if (!keyboardPath.empty())
+    else
     {
-        keyboardFd =
-            open(keyboardPath.c_str(), O_RDWR | O_CLOEXEC | O_NONBLOCK);
-        if (keyboardFd < 0)
+        memcpy(report, input->keyboardReport, KEY_REPORT_LENGTH);
+        if (input->levelScancode)
         {
-            lg2::error("Failed to open input device {PATH} {ERROR}", "PATH",
-                       keyboardPath.c_str(), "ERROR", strerror(errno));
-            elog<Open>(xyz::openbmc_project::Common::File::Open::ERRNO(errno),
-                       xyz::openbmc_project::Common::File::Open::PATH(
-                           keyboardPath.c_str()));
+            report[0] = (report[0] & ~Keymap::levelMask) |
+                        input->levelModifiers;
         }
     }
 
-    if (!pointerPath.empty())
+    keLock.unlock();
+
+    if (sendKeyboard)
     {
-        pointerFd = open(pointerPath.c_str(), O_RDWR | O_CLOEXEC | O_NONBLOCK);
-        if (pointerFd < 0)
-        {
-            lg2::error("Failed to open input device {PATH} {ERROR}", "PATH",
-                       pointerPath.c_str(), "ERROR", strerror(errno));
-            elog<Open>(xyz::openbmc_project::Common::File::Open::ERRNO(errno),
-                       xyz::openbmc_project::Common::File::Open::PATH(
-                           pointerPath.c_str()));
-        }
+        input->writeKeyboard(report, *sendKeyboard);
     }
 }
 
-void Input::disconnect()
+void Input::extendedKeyEvent(rfbBool down, rfbKeySym key, uint32_t code,
+                             rfbClientPtr cl)
 {
-    if (keyboardFd >= 0)
+    uint8_t sc = Keymap::xtToScancode(code);
+
+    // Fall back to the keysym for keys missing from the XT table
+    if (!sc)
     {
-        close(keyboardFd);
-        keyboardFd = -1;
+        keyEvent(down, key, cl);
+        return;
     }
 
-    if (pointerFd >= 0)
+    Server::ClientData* cd = (Server::ClientData*)cl->clientData;
+    Input* input = cd->input;
+    std::optional<HidSink::Device> sendKeyboard;
+    /* Account the event and update the activity time for session timeout */
+    cd->inputEvent();
+
+    if (!input->sink->isOpen(HidSink::Device::keyboard))
     {
-        close(pointerFd);
-        pointerFd = -1;
+        return;
     }
 
-    try
+    input->pasteCancel = true;
+
+    std::unique_lock<std::mutex> keLock(input->keyEventMutex);
+
+    // The client sends the physical key, so the host layout produces the
+    // right character with the modifiers held on the client
+    if (sc >= USBHID_KEY_LEFTCTRL && sc <= USBHID_KEY_RIGHTMETA)
     {
-        hidUdcStream << "" << std::endl;
+        uint8_t mod = 1 << (sc - USBHID_KEY_LEFTCTRL);
+        uint8_t mods = input->keyboardReport[0];
+
+        input->keyboardReport[0] = down ? (mods | mod) : (mods & ~mod);
+        if (input->keyboardReport[0] != mods)
+        {
+            sendKeyboard = HidSink::Device::keyboard;
+        }
+    }
+    else
+    {
+        sendKeyboard = input->updateKey(sc, down);
+    }
+
+    uint8_t report[NKRO_REPORT_LENGTH];
+
+    if (sendKeyboard == HidSink::Device::nkroKeyboard)
+    {
+        memcpy(report, input->nkroReport, NKRO_REPORT_LENGTH);
+    }
+    else
+    {
+        memcpy(report, input->keyboardReport, KEY_REPORT_LENGTH);
     }
-    catch (std::ofstream::failure& e)
+
+    keLock.unlock();
+
+    if (sendKeyboard)
     {
-        lg2::error("Failed to disconnect HID gadget {ERROR}", "ERROR",
-                   e.what());
+        input->writeKeyboard(report, *sendKeyboard);
     }
 }
 
-void Input::keyEvent(rfbBool down, rfbKeySym key, rfbClientPtr cl)
+void Input::pointerEvent(int buttonMask, int x, int y, rfbClientPtr cl)
 {
     Server::ClientData* cd = (Server::ClientData*)cl->clientData;
     Input* input = cd->input;
-    bool sendKeyboard = false;
-    /* Update the last activity time for session timeout */
-    cd->lastActivityTime = std::chrono::steady_clock::now();
+    /* Account the event and update the activity time for session timeout */
+    cd->inputEvent();
 
-    if (input->keyboardFd < 0)
+    if (!input->sink->isOpen(HidSink::Device::pointer))
     {
         return;
     }
 
-    std::unique_lock<std::mutex> keLock(input->keyEventMutex);
+    rfbDefaultPtrAddEvent(buttonMask, x, y, cl);
 
-    if (down)
-    {
-        uint8_t sc = keyToScancode(key);
+    // The coordinates are in the client's framebuffer, which the server
+    // thread only swaps once the clients know of a new resolution
+    input->sendPointer(buttonMask, x, y, cl->screen->width,
+                       cl->screen->height);
+}
 
-        if (sc)
+void Input::sendPointer(int buttonMask, int x, int y, unsigned int width,
+                        unsigned int height)
+{
+    if (buttonMask > 4)
+    {
+        pointerReport[0] = 0;
+        if (buttonMask == 8)
         {
-            if (input->keysDown.find(key) == input->keysDown.end())
-            {
-                for (unsigned int i = 2; i < KEY_REPORT_LENGTH; ++i)
-                {
-                    if (!input->keyboardReport[i])
-                    {
-                        input->keyboardReport[i] = sc;
-                        input->keysDown.insert(std::make_pair(key, i));
-                        sendKeyboard = true;
-                        break;
-                    }
-                }
-            }
+            pointerReport[5] = 1;
         }
-        else
+        else if (buttonMask == 16)
         {
-            uint8_t mod = keyToMod(key);
-
-            if (mod)
-            {
-                input->keyboardReport[0] |= mod;
-                sendKeyboard = true;
-            }
+            pointerReport[5] = 0xff;
         }
     }
     else
     {
-        auto it = input->keysDown.find(key);
+        pointerReport[0] = ((buttonMask & 0x4) >> 1) |
+                           ((buttonMask & 0x2) << 1) | (buttonMask & 0x1);
+        pointerReport[5] = 0;
+    }
 
-        if (it != input->keysDown.end())
-        {
-            input->keyboardReport[it->second] = 0;
-            input->keysDown.erase(it);
-            sendKeyboard = true;
-        }
-        else
-        {
-            uint8_t mod = keyToMod(key);
+    if (x >= 0 && (unsigned int)x < width)
+    {
+        uint16_t xx = scaleCoordinate(x, width);
 
-            if (mod)
-            {
-                input->keyboardReport[0] &= ~mod;
-                sendKeyboard = true;
-            }
-        }
+        memcpy(&pointerReport[1], &xx, sizeof(xx));
     }
 
-    keLock.unlock();
+    if (y >= 0 && (unsigned int)y < height)
+    {
+        uint16_t yy = scaleCoordinate(y, height);
 
-    if (sendKeyboard)
+        memcpy(&pointerReport[3], &yy, sizeof(yy));
+    }
+
+    // Motion-only reports are merged until the polling interval elapses;
+    // button and wheel changes go out straight away, after any earlier
+    // change that is still queued
+    if (pointerCoalescer.submit(pointerReport))
     {
-        input->writeKeyboard(input->keyboardReport);
+        if (writePointer(pointerCoalescer.getReport()))
+        {
+            pointerCoalescer.written(std::chrono::steady_clock::now());
+        }
     }
+
+    flushPointer();
 }
 
-void Input::pointerEvent(int buttonMask, int x, int y, rfbClientPtr cl)
+void Input::cutText(char* str, int len, rfbClientPtr cl)
 {
     Server::ClientData* cd = (Server::ClientData*)cl->clientData;
     Input* input = cd->input;
-    Server* server = (Server*)cl->screen->screenData;
-    const Video& video = server->getVideo();
-    /* Update the last activity time for session timeout */
-    cd->lastActivityTime = std::chrono::steady_clock::now();
+    /* Account the event and update the activity time for session timeout */
+    cd->inputEvent();
 
-    if (input->pointerFd < 0)
+    // Typing whatever a client copies could run commands on the host, so
+    // pasting must be enabled first
+    if (!input->getPasteEnabled() ||
+        !input->sink->isOpen(HidSink::Device::keyboard) || len < 0)
     {
         return;
     }
 
-    if (buttonMask > 4)
+    // An empty clipboard cancels the paste in progress
+    input->pasteText(std::string(str, len));
+}
+
+void Input::pasteText(const std::string& text)
+{
+    cancelPaste();
+
+    if (text.empty() || !sink->isOpen(HidSink::Device::keyboard))
     {
-        input->pointerReport[0] = 0;
-        if (buttonMask == 8)
+        return;
+    }
+
+    if (text.size() > PASTE_LENGTH_MAX)
+    {
+        lg2::warning("Truncating pasted text from {LENGTH} characters",
+                     "LENGTH", text.size());
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(pasteMutex);
+
+        pasteStatus.active = true;
+        pasteStatus.typed = 0;
+        pasteStatus.total = std::min(text.size(), PASTE_LENGTH_MAX);
+        pasteStatus.charsPerSecond = 0.0;
+        pasteStart = std::chrono::steady_clock::now();
+    }
+
+    pasteCancel = false;
+    paster = std::thread(&Input::pasteThread, this,
+                         text.substr(0, PASTE_LENGTH_MAX));
+}
+
+void Input::cancelPaste()
+{
+    pasteCancel = true;
+
+    if (paster.joinable())
+    {
+        paster.join();
+    }
+}
+
+void Input::stopPaste()
+{
+    pasteCancel = true;
+}
+
+void Input::setPasteEnabled(bool enabled)
+{
+    pasteEnabled.store(enabled, std::memory_order_relaxed);
+    if (!enabled)
+    {
+        stopPaste();
+    }
+}
+
+Input::PasteStatus Input::getPasteStatus()
+{
+    std::lock_guard<std::mutex> lk(pasteMutex);
+
+    return pasteStatus;
+}
+
+void Input::pasteThread(std::string text)
+{
+    uint8_t report[KEY_REPORT_LENGTH] = {0};
+    size_t i;
+
+    for (i = 0; i < text.size() && !pasteCancel && getPasteEnabled(); ++i)
+    {
+        rfbKeySym key = (unsigned char)text[i];
+
+        if (key == '\r' || key == '\n')
         {
-            input->pointerReport[5] = 1;
+            // Type a CR LF pair as a single return
+            if (key == '\r' && i + 1 < text.size() && text[i + 1] == '\n')
+            {
+                continue;
+            }
+
+            key = XK_Return;
         }
-        else if (buttonMask == 16)
+        else if (key == '\t')
         {
-            input->pointerReport[5] = 0xff;
+            key = XK_Tab;
         }
+
+        Keymap::KeyCode code = keymap.lookup(key);
+
+        // Press and release each key, waiting for the host to poll in
+        // between so that no report gets overwritten; dead keys are
+        // followed by a space to type the accent on its own
+        if (code.scancode &&
+            (!typePasteKey(report, code.scancode, code.modifiers) ||
+             (code.dead && !typePasteKey(report, USBHID_KEY_SPACE, 0))))
+        {
+            break;
+        }
+
+        std::lock_guard<std::mutex> lk(pasteMutex);
+        pasteStatus.typed = i + 1;
     }
-    else
+
+    // Restore the state of keys held by the client
     {
-        input->pointerReport[0] =
-            ((buttonMask & 0x4) >> 1) | ((buttonMask & 0x2) << 1) |
-            (buttonMask & 0x1);
-        input->pointerReport[5] = 0;
+        std::lock_guard<std::mutex> keLock(keyEventMutex);
+
+        memcpy(report, keyboardReport, KEY_REPORT_LENGTH);
     }
+    writeKeyboard(report);
+
+    std::lock_guard<std::mutex> lk(pasteMutex);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - pasteStart);
 
-    if (x >= 0 && (unsigned int)x < video.getWidth())
+    pasteStatus.active = false;
+    if (elapsed.count() > 0)
     {
-        uint16_t xx = (video.getWidth() > 1)
-                          ? (uint16_t)(x * SHRT_MAX / (video.getWidth() - 1))
-                          : 0;
+        pasteStatus.charsPerSecond =
+            (double)pasteStatus.typed * 1000.0 / (double)elapsed.count();
+    }
+
+    lg2::info("Typed {TYPED} of {TOTAL} pasted characters in {MSEC} ms, "
+              "{RATE} chars/s",
+              "TYPED", pasteStatus.typed, "TOTAL", pasteStatus.total, "MSEC",
+              elapsed.count(), "RATE", pasteStatus.charsPerSecond);
+}
+
+bool Input::typePasteKey(uint8_t* report, uint8_t sc, uint8_t mods)
+{
+    report[0] = mods;
+    report[2] = sc;
 
-        memcpy(&input->pointerReport[1], &xx, sizeof(xx));
+    if (!waitKeyboard(PASTE_WRITE_TIMEOUT) || !writeKeyboard(report))
+    {
+        return false;
     }
 
-    if (y >= 0 && (unsigned int)y < video.getHeight())
+    report[0] = 0;
+    report[2] = 0;
+
+    return waitKeyboard(PASTE_WRITE_TIMEOUT) && writeKeyboard(report);
+}
+
+bool Input::waitKeyboard(std::chrono::milliseconds timeout)
+{
+    constexpr std::chrono::milliseconds slice(50);
+
+    // Poll in slices so that a cancelled paste stops promptly
+    while (timeout.count() > 0 && !pasteCancel)
     {
-        uint16_t yy = (video.getHeight() > 1)
-                          ? (uint16_t)(y * SHRT_MAX / (video.getHeight() - 1))
-                          : 0;
+        int rc = sink->poll(HidSink::Device::keyboard,
+                            std::min(timeout, slice));
+
+        if (rc > 0)
+        {
+            return true;
+        }
+
+        if (rc < 0 && errno != EINTR)
+        {
+            if (errno != ESHUTDOWN)
+            {
+                lg2::error("Failed to poll keyboard device {ERROR}", "ERROR",
+                           strerror(errno));
+            }
+            return false;
+        }
 
-        memcpy(&input->pointerReport[3], &yy, sizeof(yy));
+        timeout -= slice;
     }
 
-    rfbDefaultPtrAddEvent(buttonMask, x, y, cl);
-    input->writePointer(input->pointerReport);
+    if (!pasteCancel)
+    {
+        lg2::error("Timed out waiting for the host to read pasted keys");
+    }
+
+    return false;
 }
 
 void Input::sendWakeupPacket()
 {
     uint8_t wakeupReport[KEY_REPORT_LENGTH] = {0};
 
-    if (pointerFd >= 0)
+    if (sink->isOpen(HidSink::Device::pointer))
     {
         uint16_t xy = SHRT_MAX / 2;
 
@@ -300,7 +478,7 @@ void Input::sendWakeupPacket()
         writePointer(wakeupReport);
     }
 
-    if (keyboardFd >= 0)
+    if (sink->isOpen(HidSink::Device::keyboard))
     {
         memset(&wakeupReport[0], 0, KEY_REPORT_LENGTH);
 
@@ -317,238 +495,132 @@ void Input::sendWakeupPacket()
     }
 }
 
-uint8_t Input::keyToMod(rfbKeySym key)
+void Input::flushPointer()
 {
-    uint8_t mod = 0;
+    auto now = std::chrono::steady_clock::now();
 
-    if (key >= XK_Shift_L && key <= XK_Control_R)
+    if (!sink->isOpen(HidSink::Device::pointer) ||
+        !pointerCoalescer.isDue(now))
     {
-        mod = shiftCtrlMap[key - XK_Shift_L];
+        return;
     }
-    else if (key >= XK_Meta_L && key <= XK_Alt_R)
+
+    // Don't wait for a busy device; the report stays queued and is
+    // superseded by newer motion or retried on the next flush
+    if (writePointer(pointerCoalescer.getReport(), false))
     {
-        mod = metaAltMap[key - XK_Meta_L];
+        pointerCoalescer.written(now);
     }
+}
 
-    return mod;
+long int Input::getPointerDelay(long int usec)
+{
+    auto delay =
+        pointerCoalescer.timeUntilDue(std::chrono::steady_clock::now());
+
+    return (delay.count() < usec) ? (long int)delay.count() : usec;
 }
 
-uint8_t Input::keyToScancode(rfbKeySym key)
+uint8_t Input::keyToMod(rfbKeySym key)
 {
-    uint8_t scancode = 0;
+    uint8_t mod = 0;
 
-    if ((key >= 'A' && key <= 'Z') || (key >= 'a' && key <= 'z'))
+    if (key >= XK_Shift_L && key <= XK_Control_R)
     {
-        scancode = USBHID_KEY_A + ((key & 0x5F) - 'A');
+        mod = shiftCtrlMap[key - XK_Shift_L];
     }
-    else if (key >= '1' && key <= '9')
+    else if (key >= XK_Meta_L && key <= XK_Alt_R)
     {
-        scancode = USBHID_KEY_1 + (key - '1');
+        mod = metaAltMap[key - XK_Meta_L];
     }
-    else if (key >= XK_F1 && key <= XK_F12)
+    else if (key == XK_ISO_Level3_Shift)
     {
-        scancode = USBHID_KEY_F1 + (key - XK_F1);
+        mod = Keymap::altGr;
     }
-    else if (key >= XK_KP_F1 && key <= XK_KP_F4)
+
+    return mod;
+}
+
+std::optional<HidSink::Device> Input::updateKey(uint8_t sc, bool down)
+{
+    if (down && !keysDown.test(sc))
     {
-        scancode = USBHID_KEY_F1 + (key - XK_KP_F1);
+        keysDown.set(sc);
+
+        // Boot protocol hosts only see the first six keys down
+        for (unsigned int i = 2; i < KEY_REPORT_LENGTH; ++i)
+        {
+            if (!keyboardReport[i])
+            {
+                keyboardReport[i] = sc;
+                return HidSink::Device::keyboard;
+            }
+        }
+
+        // Report protocol hosts combine both keyboards; keys beyond the
+        // bitmap wait for a free slot in the boot protocol report
+        if (sc < NKRO_KEY_USAGES &&
+            sink->isOpen(HidSink::Device::nkroKeyboard))
+        {
+            nkroReport[sc / 8] |= 1 << (sc % 8);
+            return HidSink::Device::nkroKeyboard;
+        }
     }
-    else if (key >= XK_KP_1 && key <= XK_KP_9)
+    else if (!down && keysDown.test(sc))
     {
-        scancode = USBHID_KEY_KP_1 + (key - XK_KP_1);
+        keysDown.reset(sc);
+
+        if (testKeyBit(sc))
+        {
+            nkroReport[sc / 8] &= ~(1 << (sc % 8));
+            return HidSink::Device::nkroKeyboard;
+        }
+
+        for (unsigned int i = 2; i < KEY_REPORT_LENGTH; ++i)
+        {
+            if (keyboardReport[i] == sc)
+            {
+                keyboardReport[i] = nextKeyDown();
+                return HidSink::Device::keyboard;
+            }
+        }
     }
-    else
+
+    return std::nullopt;
+}
+
+uint8_t Input::nextKeyDown() const
+{
+    // Keys already in the N-key rollover report stay there, as moving them
+    // would release and press them again on the host
+    for (unsigned int sc = 1; sc < keysDown.size(); ++sc)
     {
-        switch (key)
+        if (keysDown.test(sc) && !testKeyBit(sc) &&
+            std::find(&keyboardReport[2], &keyboardReport[KEY_REPORT_LENGTH],
+                      sc) == &keyboardReport[KEY_REPORT_LENGTH])
         {
-            case XK_exclam:
-                scancode = USBHID_KEY_1;
-                break;
-            case XK_at:
-                scancode = USBHID_KEY_2;
-                break;
-            case XK_numbersign:
-                scancode = USBHID_KEY_3;
-                break;
-            case XK_dollar:
-                scancode = USBHID_KEY_4;
-                break;
-            case XK_percent:
-                scancode = USBHID_KEY_5;
-                break;
-            case XK_asciicircum:
-                scancode = USBHID_KEY_6;
-                break;
-            case XK_ampersand:
-                scancode = USBHID_KEY_7;
-                break;
-            case XK_asterisk:
-                scancode = USBHID_KEY_8;
-                break;
-            case XK_parenleft:
-                scancode = USBHID_KEY_9;
-                break;
-            case XK_0:
-            case XK_parenright:
-                scancode = USBHID_KEY_0;
-                break;
-            case XK_Return:
-                scancode = USBHID_KEY_RETURN;
-                break;
-            case XK_Escape:
-                scancode = USBHID_KEY_ESC;
-                break;
-            case XK_BackSpace:
-                scancode = USBHID_KEY_BACKSPACE;
-                break;
-            case XK_Tab:
-            case XK_KP_Tab:
-                scancode = USBHID_KEY_TAB;
-                break;
-            case XK_space:
-            case XK_KP_Space:
-                scancode = USBHID_KEY_SPACE;
-                break;
-            case XK_minus:
-            case XK_underscore:
-                scancode = USBHID_KEY_MINUS;
-                break;
-            case XK_plus:
-            case XK_equal:
-                scancode = USBHID_KEY_EQUAL;
-                break;
-            case XK_bracketleft:
-            case XK_braceleft:
-                scancode = USBHID_KEY_LEFTBRACE;
-                break;
-            case XK_bracketright:
-            case XK_braceright:
-                scancode = USBHID_KEY_RIGHTBRACE;
-                break;
-            case XK_backslash:
-            case XK_bar:
-                scancode = USBHID_KEY_BACKSLASH;
-                break;
-            case XK_colon:
-            case XK_semicolon:
-                scancode = USBHID_KEY_SEMICOLON;
-                break;
-            case XK_quotedbl:
-            case XK_apostrophe:
-                scancode = USBHID_KEY_APOSTROPHE;
-                break;
-            case XK_grave:
-            case XK_asciitilde:
-                scancode = USBHID_KEY_GRAVE;
-                break;
-            case XK_comma:
-            case XK_less:
-                scancode = USBHID_KEY_COMMA;
-                break;
-            case XK_period:
-            case XK_greater:
-                scancode = USBHID_KEY_DOT;
-                break;
-            case XK_slash:
-            case XK_question:
-                scancode = USBHID_KEY_SLASH;
-                break;
-            case XK_Caps_Lock:
-                scancode = USBHID_KEY_CAPSLOCK;
-                break;
-            case XK_Print:
-                scancode = USBHID_KEY_PRINT;
-                break;
-            case XK_Scroll_Lock:
-                scancode = USBHID_KEY_SCROLLLOCK;
-                break;
-            case XK_Pause:
-                scancode = USBHID_KEY_PAUSE;
-                break;
-            case XK_Insert:
-            case XK_KP_Insert:
-                scancode = USBHID_KEY_INSERT;
-                break;
-            case XK_Home:
-            case XK_KP_Home:
-                scancode = USBHID_KEY_HOME;
-                break;
-            case XK_Page_Up:
-            case XK_KP_Page_Up:
-                scancode = USBHID_KEY_PAGEUP;
-                break;
-            case XK_Delete:
-            case XK_KP_Delete:
-                scancode = USBHID_KEY_DELETE;
-                break;
-            case XK_End:
-            case XK_KP_End:
-                scancode = USBHID_KEY_END;
-                break;
-            case XK_Page_Down:
-            case XK_KP_Page_Down:
-                scancode = USBHID_KEY_PAGEDOWN;
-                break;
-            case XK_Right:
-            case XK_KP_Right:
-                scancode = USBHID_KEY_RIGHT;
-                break;
-            case XK_Left:
-            case XK_KP_Left:
-                scancode = USBHID_KEY_LEFT;
-                break;
-            case XK_Down:
-            case XK_KP_Down:
-                scancode = USBHID_KEY_DOWN;
-                break;
-            case XK_Up:
-            case XK_KP_Up:
-                scancode = USBHID_KEY_UP;
-                break;
-            case XK_Num_Lock:
-                scancode = USBHID_KEY_NUMLOCK;
-                break;
-            case XK_KP_Enter:
-                scancode = USBHID_KEY_KP_ENTER;
-                break;
-            case XK_KP_Equal:
-                scancode = USBHID_KEY_KP_EQUAL;
-                break;
-            case XK_KP_Multiply:
-                scancode = USBHID_KEY_KP_MULTIPLY;
-                break;
-            case XK_KP_Add:
-                scancode = USBHID_KEY_KP_ADD;
-                break;
-            case XK_KP_Subtract:
-                scancode = USBHID_KEY_KP_SUBTRACT;
-                break;
-            case XK_KP_Decimal:
-                scancode = USBHID_KEY_KP_DECIMAL;
-                break;
-            case XK_KP_Divide:
-                scancode = USBHID_KEY_KP_DIVIDE;
-                break;
-            case XK_KP_0:
-                scancode = USBHID_KEY_KP_0;
-                break;
-            case XK_Menu:
-                scancode = USBHID_MENU;
-                break;
+            return sc;
         }
     }
 
-    return scancode;
+    return 0;
 }
 
-bool Input::writeKeyboard(const uint8_t* report)
+bool Input::writeKeyboard(const uint8_t* report, HidSink::Device d)
 {
     std::unique_lock<std::mutex> lk(keyMutex);
     uint retryCount = HID_REPORT_RETRY_MAX;
+    ssize_t length = (d == HidSink::Device::nkroKeyboard) ? NKRO_REPORT_LENGTH
+                                                          : KEY_REPORT_LENGTH;
 
     while (retryCount > 0)
     {
-        if (write(keyboardFd, report, KEY_REPORT_LENGTH) == KEY_REPORT_LENGTH)
+        ssize_t rc = sink->write(d, report, length);
+
+        IKVM_PROBE(keyboard_write, HID_REPORT_RETRY_MAX - retryCount, rc,
+                   (rc < 0) ? errno : 0);
+
+        if (rc == length)
         {
             return true;
         }
@@ -564,6 +636,9 @@ bool Input::writeKeyboard(const uint8_t* report)
             break;
         }
 
+        FlightRecorder::record(FlightRecorder::Event::hidEagain, 0,
+                               HID_REPORT_RETRY_MAX - retryCount);
+
         lk.unlock();
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
         lk.lock();
@@ -573,16 +648,22 @@ bool Input::writeKeyboard(const uint8_t* report)
     return false;
 }
 
-void Input::writePointer(const uint8_t* report)
+bool Input::writePointer(const uint8_t* report, bool retry)
 {
     std::unique_lock<std::mutex> lk(ptrMutex);
     uint retryCount = HID_REPORT_RETRY_MAX;
 
     while (retryCount > 0)
     {
-        if (write(pointerFd, report, PTR_REPORT_LENGTH) == PTR_REPORT_LENGTH)
+        ssize_t rc =
+            sink->write(HidSink::Device::pointer, report, PTR_REPORT_LENGTH);
+
+        IKVM_PROBE(pointer_write, HID_REPORT_RETRY_MAX - retryCount, rc,
+                   (rc < 0) ? errno : 0);
+
+        if (rc == PTR_REPORT_LENGTH)
         {
-            break;
+            return true;
         }
 
         if (errno != EAGAIN)
@@ -596,11 +677,21 @@ void Input::writePointer(const uint8_t* report)
             break;
         }
 
+        FlightRecorder::record(FlightRecorder::Event::hidEagain, 1,
+                               HID_REPORT_RETRY_MAX - retryCount);
+
+        if (!retry)
+        {
+            break;
+        }
+
         lk.unlock();
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
         lk.lock();
         retryCount--;
     }
+
+    return false;
 }
 
 } // namespace ikvm
@@ -1,12 +1,20 @@
 #pragma once
 
+#include "ikvm_hid_sink.hpp"
+#include "ikvm_keymap.hpp"
+#include "ikvm_pointer.hpp"
+
 #include <rfb/rfb.h>
 
-#include <filesystem>
-#include <fstream>
-#include <map>
+#include <atomic>
+#include <climits>
+#include <bitset>
+#include <chrono>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
+#include <thread>
 
 namespace ikvm
 {
@@ -18,25 +26,68 @@ namespace ikvm
 class Input
 {
   public:
+    /*
+     * @struct PasteStatus
+     * @brief Progress of typing pasted text on the USB keyboard device
+     */
+    struct PasteStatus
+    {
+        /* @brief Boolean to indicate whether text is being typed */
+        bool active;
+        /* @brief Number of characters of the text processed so far */
+        size_t typed;
+        /* @brief Number of characters in the text */
+        size_t total;
+        /* @brief Achieved typing rate in characters per second */
+        double charsPerSecond;
+    };
+
     /*
      * @brief Constructs Input object
      *
-     * @param[in] kbdPath - Path to the USB keyboard device
-     * @param[in] ptrPath - Path to the USB mouse device
-     * @param[in] udc - Name of UDC
+     * @param[in] s      - HID sink to write reports to
+     * @param[in] layout - Keyboard layout of the host
      */
-    Input(const std::string& kbdPath, const std::string& ptrPath,
-          const std::string& udc);
+    explicit Input(std::unique_ptr<HidSink> s,
+                   const std::string& layout = "us");
     ~Input();
     Input(const Input&) = delete;
     Input& operator=(const Input&) = delete;
     Input(Input&&) = delete;
     Input& operator=(Input&&) = delete;
 
-    /* @brief Connects HID gadget to host */
+    /* @brief Connects HID devices to host */
     void connect();
-    /* @brief Disconnects HID gadget from host */
+    /* @brief Disconnects HID devices from host */
     void disconnect();
+    /* @brief Counts an event from a client, waking up an idle capture */
+    inline void countEvent()
+    {
+        lastEventTime.store(
+            std::chrono::steady_clock::now().time_since_epoch().count(),
+            std::memory_order_relaxed);
+        eventCount.fetch_add(1, std::memory_order_release);
+    }
+    /*
+     * @brief Gets the number of events received from the clients
+     *
+     * @return Number of key, pointer and clipboard events
+     */
+    inline uint64_t getEventCount() const
+    {
+        return eventCount.load(std::memory_order_acquire);
+    }
+    /*
+     * @brief Gets the time of the last event received from the clients
+     *
+     * @return Time of the event on the steady clock
+     */
+    inline std::chrono::steady_clock::time_point getLastEventTime() const
+    {
+        return std::chrono::steady_clock::time_point(
+            std::chrono::steady_clock::duration(
+                lastEventTime.load(std::memory_order_relaxed)));
+    }
     /*
      * @brief RFB client key event handler
      *
@@ -45,6 +96,18 @@ class Input
      * @param[in] cl   - Handle to the RFB client
      */
     static void keyEvent(rfbBool down, rfbKeySym key, rfbClientPtr cl);
+    /*
+     * @brief RFB client QEMU extended key event handler; presses the
+     *        physical key given by the XT scancode, using the key code only
+     *        if the scancode is unknown
+     *
+     * @param[in] down - Boolean indicating whether key is pressed or not
+     * @param[in] key  - Key code
+     * @param[in] code - QEMU key code (XT scancode)
+     * @param[in] cl   - Handle to the RFB client
+     */
+    static void extendedKeyEvent(rfbBool down, rfbKeySym key, uint32_t code,
+                                 rfbClientPtr cl);
     /*
      * @brief RFB client pointer event handler
      *
@@ -55,14 +118,103 @@ class Input
      * @param[in] cl         - Handle to the RFB client
      */
     static void pointerEvent(int buttonMask, int x, int y, rfbClientPtr cl);
+    /*
+     * @brief RFB client cut text handler; types the text on the keyboard
+     *        if pasting is enabled
+     *
+     * @param[in] str - Latin-1 text from the client clipboard
+     * @param[in] len - Length of the text
+     * @param[in] cl  - Handle to the RFB client
+     */
+    static void cutText(char* str, int len, rfbClientPtr cl);
+
+    /*
+     * @brief Starts typing text on the USB keyboard device from a
+     *        background thread, cancelling any paste in progress
+     *
+     * @param[in] text - Latin-1 text to type
+     */
+    void pasteText(const std::string& text);
+    /* @brief Cancels the paste in progress and waits for it to stop */
+    void cancelPaste();
+    /*
+     * @brief Asks the paste in progress to stop, without waiting for it;
+     *        callable from any thread
+     */
+    void stopPaste();
+    /*
+     * @brief Enables or disables typing the client clipboard; disabling it
+     *        stops the paste in progress. Callable from any thread
+     *
+     * @param[in] enabled - Boolean indicating if pasting is enabled
+     */
+    void setPasteEnabled(bool enabled);
+    /*
+     * @brief Gets whether the client clipboard is typed on the host
+     *
+     * @return Boolean indicating if pasting is enabled
+     */
+    inline bool getPasteEnabled() const
+    {
+        return pasteEnabled.load(std::memory_order_relaxed);
+    }
+    /*
+     * @brief Gets the progress of the current or last paste
+     *
+     * @return Status of the paste
+     */
+    PasteStatus getPasteStatus();
 
     /* @brief Sends a wakeup data packet to the USB input device */
     void sendWakeupPacket();
+    /*
+     * @brief Updates the pointer report and writes it, or leaves it to be
+     *        coalesced with the next motion
+     *
+     * @param[in] buttonMask - Bitmask indicating which buttons have been
+     *                         pressed
+     * @param[in] x          - Pointer x-coordinate
+     * @param[in] y          - Pointer y-coordinate
+     * @param[in] width      - Width of the framebuffer
+     * @param[in] height     - Height of the framebuffer
+     */
+    void sendPointer(int buttonMask, int x, int y, unsigned int width,
+                     unsigned int height);
+    /* @brief Writes the coalesced pointer report if it is due */
+    void flushPointer();
+    /*
+     * @brief Gets the time until the coalesced pointer report is due
+     *
+     * @param[in] usec - Upper bound to return, in microseconds
+     *
+     * @return Microseconds until the pointer report should be flushed,
+     *         bounded by usec
+     */
+    long int getPointerDelay(long int usec);
+
+    /*
+     * @brief Scales a pointer coordinate to the range of the absolute HID
+     *        pointer
+     *
+     * @param[in] pos  - Coordinate on the framebuffer
+     * @param[in] size - Width or height of the framebuffer
+     *
+     * @return Coordinate in the range 0 to SHRT_MAX
+     */
+    static inline uint16_t scaleCoordinate(int pos, unsigned int size)
+    {
+        return (size > 1) ? (uint16_t)(pos * SHRT_MAX / (size - 1)) : 0;
+    }
 
   private:
     static constexpr int NUM_MODIFIER_BITS = 4;
     static constexpr int KEY_REPORT_LENGTH = 8;
     static constexpr int PTR_REPORT_LENGTH = 6;
+    /* @brief Number of key usages covered by the N-key rollover bitmap */
+    static constexpr int NKRO_KEY_USAGES = 0xa0;
+    /* @brief Length of the N-key rollover report, a bitmap of the keys */
+    static constexpr int NKRO_REPORT_LENGTH = NKRO_KEY_USAGES / 8;
+    static_assert(NKRO_REPORT_LENGTH >= KEY_REPORT_LENGTH);
 
     /* @brief HID modifier bits mapped to shift and control key codes */
     static constexpr uint8_t shiftCtrlMap[NUM_MODIFIER_BITS] = {
@@ -78,57 +230,138 @@ class Input
         0x04, // left alt
         0x40  // right alt
     };
-    /* @brief Path to the HID gadget UDC */
-    static constexpr const char* hidUdcPath =
-        "/sys/kernel/config/usb_gadget/obmc_hid/UDC";
-    /* @brief Path to the USB virtual hub */
-    static constexpr const char* usbVirtualHubPath =
-        "/sys/bus/platform/devices/1e6a0000.usb-vhub";
     /* @brief Retry limit for writing an HID report */
     static constexpr int HID_REPORT_RETRY_MAX = 5;
+    /* @brief Maximum number of characters typed from one paste */
+    static constexpr size_t PASTE_LENGTH_MAX = 65536;
+    /* @brief Time to wait for the host to accept a pasted key report */
+    static constexpr std::chrono::milliseconds PASTE_WRITE_TIMEOUT{1000};
+    /*
+     * @brief Minimum interval between pointer motion reports, matching the
+     *        125Hz polling rate hosts commonly use for HID mice
+     */
+    static constexpr std::chrono::microseconds PTR_REPORT_INTERVAL{8000};
+    static_assert(PTR_REPORT_LENGTH == PointerCoalescer::reportLength);
     /*
      * @brief Translates a RFB-specific key code to HID modifier bit
      *
      * @param[in] key - key code
      */
     static uint8_t keyToMod(rfbKeySym key);
+
     /*
-     * @brief Translates a RFB-specific key code to HID scancode
+     * @brief Thread function typing pasted text
      *
-     * @param[in] key - key code
+     * @param[in] text - Latin-1 text to type
+     */
+    void pasteThread(std::string text);
+    /*
+     * @brief Presses and releases a key for pasted text
+     *
+     * @param[in] report - Keyboard report data to use
+     * @param[in] sc     - HID scancode of the key
+     * @param[in] mods   - HID modifier bits to hold with the key
+     *
+     * @return Boolean indicating if both reports have been written
+     */
+    bool typePasteKey(uint8_t* report, uint8_t sc, uint8_t mods);
+    /*
+     * @brief Waits until the host has consumed the previous keyboard report
+     *
+     * @param[in] timeout - Maximum time to wait
+     *
+     * @return Boolean indicating if the device accepts a new report
      */
-    static uint8_t keyToScancode(rfbKeySym key);
+    bool waitKeyboard(std::chrono::milliseconds timeout);
 
-    bool writeKeyboard(const uint8_t* report);
-    void writePointer(const uint8_t* report);
+    /*
+     * @brief Presses or releases a non-modifier key in the keyboard
+     *        reports; called with keyEventMutex held
+     *
+     * @param[in] sc   - HID scancode of the key
+     * @param[in] down - Boolean indicating whether key is pressed or not
+     *
+     * @return Device whose report has changed, if any
+     */
+    std::optional<HidSink::Device> updateKey(uint8_t sc, bool down);
+    /*
+     * @brief Finds a key that is down but in none of the keyboard reports
+     *
+     * @return HID scancode of the key, or 0 if there is none
+     */
+    uint8_t nextKeyDown() const;
+    /*
+     * @brief Gets whether a key is set in the N-key rollover report
+     *
+     * @param[in] sc - HID scancode of the key
+     */
+    inline bool testKeyBit(uint8_t sc) const
+    {
+        return sc < NKRO_KEY_USAGES && (nkroReport[sc / 8] & (1 << (sc % 8)));
+    }
+    /*
+     * @brief Writes a report to a USB keyboard device
+     *
+     * @param[in] report - Keyboard report data
+     * @param[in] d      - Boot protocol or N-key rollover keyboard
+     *
+     * @return Boolean indicating if the report has been written
+     */
+    bool writeKeyboard(const uint8_t* report,
+                       HidSink::Device d = HidSink::Device::keyboard);
+    /*
+     * @brief Writes a report to the USB mouse device
+     *
+     * @param[in] report - Pointer report data
+     * @param[in] retry  - If false, gives up as soon as the device is busy
+     *
+     * @return Boolean indicating if the report has been written
+     */
+    bool writePointer(const uint8_t* report, bool retry = true);
 
-    /* @brief File descriptor for the USB keyboard device */
-    int keyboardFd;
-    /* @brief File descriptor for the USB mouse device */
-    int pointerFd;
-    /* @brief Data for keyboard report */
+    /* @brief HID scancode of the character key typed with levelModifiers */
+    uint8_t levelScancode;
+    /* @brief HID modifiers the host layout needs for levelScancode */
+    uint8_t levelModifiers;
+    /* @brief Data for the boot protocol keyboard report */
     uint8_t keyboardReport[KEY_REPORT_LENGTH];
+    /*
+     * @brief Data for the N-key rollover report, holding the keys that
+     *        don't fit in the six slots of the boot protocol report
+     */
+    uint8_t nkroReport[NKRO_REPORT_LENGTH];
     /* @brief Data for pointer report */
     uint8_t pointerReport[PTR_REPORT_LENGTH];
-    /* @brief Path to the USB keyboard device */
-    std::string keyboardPath;
-    /* @brief Path to the USB mouse device */
-    std::string pointerPath;
-    /* @brief Name of UDC */
-    std::string udcName;
-    /*
-     * @brief Mapping of RFB key code to report data index to keep track
-     *        of which keys are down
-     */
-    std::map<int, int> keysDown;
-    /* @brief Handle of the HID gadget UDC */
-    std::ofstream hidUdcStream;
+    /* @brief HID sink delivering reports to the host */
+    std::unique_ptr<HidSink> sink;
+    /* @brief HID scancodes of the keys that are down */
+    std::bitset<256> keysDown;
+    /* @brief Keysym to HID scancode tables for the host layout */
+    Keymap keymap;
+    /* @brief Coalesces pointer motion to the HID polling interval */
+    PointerCoalescer pointerCoalescer;
     /* @brief Mutex for sending keyboard reports */
     std::mutex keyMutex;
     /* @brief Mutex for sending pointer reports */
     std::mutex ptrMutex;
     /* @brief Mutex for key events */
     std::mutex keyEventMutex;
+    /* @brief Thread typing pasted text */
+    std::thread paster;
+    /* @brief Boolean to request the paste in progress to stop */
+    std::atomic<bool> pasteCancel;
+    /* @brief Boolean to type the client clipboard, off by default */
+    std::atomic<bool> pasteEnabled;
+    /* @brief Progress of the current or last paste */
+    PasteStatus pasteStatus;
+    /* @brief Time at which the current or last paste started */
+    std::chrono::steady_clock::time_point pasteStart;
+    /* @brief Mutex for paste progress */
+    std::mutex pasteMutex;
+    /* @brief Number of events received from the clients */
+    std::atomic<uint64_t> eventCount;
+    /* @brief Steady clock ticks of the last event from the clients */
+    std::atomic<std::chrono::steady_clock::rep> lastEventTime;
 };
 
 } // namespace ikvm
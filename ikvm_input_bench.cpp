@@ -0,0 +1,71 @@
+#include "ikvm_hid_sink.hpp"
+#include "ikvm_input.hpp"
+#include "ikvm_server.hpp"
+
+#include <rfb/keysym.h>
+
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+namespace ikvm
+{
+
+// Scaling of every coordinate along one axis of the framebuffer
+static void BM_ScaleCoordinate(benchmark::State& state)
+{
+    unsigned int size = state.range(0);
+
+    for (auto _ : state)
+    {
+        for (unsigned int pos = 0; pos < size; ++pos)
+        {
+            benchmark::DoNotOptimize(Input::scaleCoordinate(pos, size));
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_ScaleCoordinate)
+    ->ArgName("size")
+    ->Arg(600)
+    ->Arg(800)
+    ->Arg(1200)
+    ->Arg(1920);
+
+// Key press and release from the RFB handler to the written report, with a
+// local sink standing in for the USB gadget
+static void BM_KeyEvent(benchmark::State& state)
+{
+    auto sink = std::make_unique<LocalSink>("", 64);
+    Input input(std::move(sink), state.range(0) ? "de" : "us");
+    Server::ClientData clientData(0, &input);
+    auto cl = std::make_unique<rfbClientRec>();
+    std::vector<rfbKeySym> keys;
+
+    for (rfbKeySym key = XK_space; key <= XK_asciitilde; ++key)
+    {
+        keys.push_back(key);
+    }
+
+    cl->clientData = &clientData;
+    input.connect();
+
+    for (auto _ : state)
+    {
+        for (rfbKeySym key : keys)
+        {
+            Input::keyEvent(TRUE, key, cl.get());
+            Input::keyEvent(FALSE, key, cl.get());
+        }
+    }
+
+    input.disconnect();
+    state.SetItemsProcessed(state.iterations() * keys.size() * 2);
+}
+BENCHMARK(BM_KeyEvent)->ArgName("de")->Arg(0)->Arg(1);
+
+} // namespace ikvm
+
+BENCHMARK_MAIN();
@@ -0,0 +1,453 @@
+#include "ikvm_hid_sink.hpp"
+#include "ikvm_input.hpp"
+#include "ikvm_server.hpp"
+#include "scancodes.hpp"
+
+#include <errno.h>
+#include <rfb/keysym.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace ikvm
+{
+
+class InputTest : public ::testing::Test
+{
+  protected:
+    using Device = HidSink::Device;
+
+    void SetUp() override
+    {
+        auto s = std::make_unique<LocalSink>();
+
+        sink = s.get();
+        input = std::make_unique<Input>(std::move(s));
+        input->connect();
+
+        client = std::make_unique<rfbClientRec>();
+        clientData = std::make_unique<Server::ClientData>(0, input.get());
+        client->clientData = clientData.get();
+    }
+
+    void TearDown() override
+    {
+        input->disconnect();
+    }
+
+    // Helper to get the reports written so far to a device
+    std::vector<LocalSink::Record> deviceRecords(
+        Device d = Device::keyboard) const
+    {
+        std::vector<LocalSink::Record> records = sink->getRecords();
+
+        std::erase_if(records, [d](const LocalSink::Record& r) {
+            return r.device != (uint8_t)d;
+        });
+
+        return records;
+    }
+
+    LocalSink* sink;
+    std::unique_ptr<Input> input;
+    std::unique_ptr<rfbClientRec> client;
+    std::unique_ptr<Server::ClientData> clientData;
+};
+
+TEST_F(InputTest, KeyEventWritesReports)
+{
+    Input::keyEvent(TRUE, XK_Shift_L, client.get());
+    Input::keyEvent(TRUE, XK_A, client.get());
+    Input::keyEvent(FALSE, XK_A, client.get());
+    Input::keyEvent(FALSE, XK_Shift_L, client.get());
+
+    auto records = deviceRecords();
+
+    ASSERT_EQ(records.size(), 4u);
+    EXPECT_EQ(records[0].length, 8);
+    EXPECT_EQ(records[0].report[0], 0x02);
+    EXPECT_EQ(records[0].report[2], 0);
+    EXPECT_EQ(records[1].report[0], 0x02);
+    EXPECT_EQ(records[1].report[2], USBHID_KEY_A);
+    EXPECT_EQ(records[2].report[2], 0);
+    EXPECT_EQ(records[3].report[0], 0);
+
+    for (size_t i = 1; i < records.size(); ++i)
+    {
+        EXPECT_GE(records[i].timestamp, records[i - 1].timestamp);
+    }
+}
+
+TEST_F(InputTest, NoReportsWhileDisconnected)
+{
+    input->disconnect();
+    Input::keyEvent(TRUE, XK_a, client.get());
+
+    EXPECT_TRUE(sink->getRecords().empty());
+    EXPECT_EQ(sink->write(Device::keyboard, (const uint8_t*)"", 0), -1);
+    EXPECT_EQ(errno, ESHUTDOWN);
+}
+
+TEST_F(InputTest, BackpressureIsRetried)
+{
+    // The release arrives before the host has polled the press
+    sink->setPollInterval(std::chrono::milliseconds(15));
+
+    Input::keyEvent(TRUE, XK_a, client.get());
+    Input::keyEvent(FALSE, XK_a, client.get());
+
+    auto records = deviceRecords();
+
+    ASSERT_EQ(records.size(), 2u);
+    EXPECT_EQ(records[0].report[2], USBHID_KEY_A);
+    EXPECT_EQ(records[1].report[2], 0);
+    EXPECT_GE(records[1].timestamp - records[0].timestamp, 15000000u);
+    EXPECT_GT(sink->getEagainCount(), 0u);
+}
+
+TEST_F(InputTest, InjectedEagainIsRetried)
+{
+    sink->setEagainEvery(2);
+
+    for (rfbKeySym key = XK_a; key <= XK_z; ++key)
+    {
+        Input::keyEvent(TRUE, key, client.get());
+        Input::keyEvent(FALSE, key, client.get());
+    }
+
+    // Every report but the first fails once before it is retried
+    EXPECT_EQ(deviceRecords().size(), 52u);
+    EXPECT_EQ(sink->getEagainCount(), 51u);
+}
+
+TEST_F(InputTest, SeventhKeyWaitsForSlot)
+{
+    for (rfbKeySym key = XK_a; key <= XK_g; ++key)
+    {
+        Input::keyEvent(TRUE, key, client.get());
+    }
+    Input::keyEvent(FALSE, XK_a, client.get());
+
+    auto records = deviceRecords();
+
+    // Without an N-key rollover keyboard the seventh key takes the slot
+    // of the first one released
+    ASSERT_EQ(records.size(), 7u);
+    EXPECT_EQ(records[5].report[7], USBHID_KEY_F);
+    EXPECT_EQ(records[6].report[2], USBHID_KEY_G);
+    EXPECT_TRUE(deviceRecords(Device::nkroKeyboard).empty());
+}
+
+TEST_F(InputTest, SeventhKeyUsesNkroKeyboard)
+{
+    sink->setNkroKeyboard(true);
+
+    for (rfbKeySym key = XK_a; key <= XK_g; ++key)
+    {
+        Input::keyEvent(TRUE, key, client.get());
+    }
+    Input::keyEvent(FALSE, XK_a, client.get());
+    Input::keyEvent(FALSE, XK_g, client.get());
+
+    auto records = deviceRecords();
+    auto nkroRecords = deviceRecords(Device::nkroKeyboard);
+
+    // The boot protocol report keeps the first six keys and the bitmap
+    // only the others, so that no key is down on both keyboards
+    ASSERT_EQ(records.size(), 7u);
+    EXPECT_EQ(records[5].report[7], USBHID_KEY_F);
+    EXPECT_EQ(records[6].report[2], 0);
+
+    ASSERT_EQ(nkroRecords.size(), 2u);
+    EXPECT_EQ(nkroRecords[0].length, 20);
+    for (int i = 0; i < 20; ++i)
+    {
+        EXPECT_EQ(nkroRecords[0].report[i],
+                  (i == USBHID_KEY_G / 8) ? 1 << (USBHID_KEY_G % 8) : 0);
+        EXPECT_EQ(nkroRecords[1].report[i], 0);
+    }
+}
+
+TEST_F(InputTest, PasteIsPacedToHost)
+{
+    sink->setPollInterval(std::chrono::milliseconds(1));
+    input->setPasteEnabled(true);
+
+    input->pasteText("Hi!\n");
+    for (int i = 0; i < 100 && input->getPasteStatus().active; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    Input::PasteStatus status = input->getPasteStatus();
+
+    ASSERT_FALSE(status.active);
+    EXPECT_EQ(status.typed, 4u);
+
+    // Press and release per character, then the restored client state
+    auto records = deviceRecords();
+
+    ASSERT_EQ(records.size(), 9u);
+    EXPECT_EQ(records[0].report[0], 0x02);
+    EXPECT_EQ(records[0].report[2], USBHID_KEY_H);
+    EXPECT_EQ(records[2].report[2], USBHID_KEY_I);
+    EXPECT_EQ(records[4].report[2], USBHID_KEY_1);
+    EXPECT_EQ(records[6].report[2], USBHID_KEY_RETURN);
+    EXPECT_EQ(records[8].report[2], 0);
+
+    // No report was overwritten before the host polled it
+    for (size_t i = 1; i < records.size(); ++i)
+    {
+        EXPECT_GE(records[i].timestamp - records[i - 1].timestamp, 1000000u);
+    }
+}
+
+TEST_F(InputTest, PasteIsOptIn)
+{
+    char text[] = "ls\n";
+
+    sink->setPollInterval(std::chrono::milliseconds(1));
+
+    Input::cutText(text, 3, client.get());
+    EXPECT_FALSE(input->getPasteStatus().active);
+    EXPECT_TRUE(deviceRecords().empty());
+
+    input->setPasteEnabled(true);
+    Input::cutText(text, 3, client.get());
+    for (int i = 0; i < 100 && input->getPasteStatus().active; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    EXPECT_EQ(input->getPasteStatus().typed, 3u);
+}
+
+TEST_F(InputTest, DisablingPasteStopsIt)
+{
+    sink->setPollInterval(std::chrono::milliseconds(5));
+    input->setPasteEnabled(true);
+
+    input->pasteText(std::string(100, 'a'));
+    for (int i = 0; i < 1000 && !input->getPasteStatus().typed; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    input->setPasteEnabled(false);
+    for (int i = 0; i < 100 && input->getPasteStatus().active; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    Input::PasteStatus status = input->getPasteStatus();
+
+    ASSERT_FALSE(status.active);
+    EXPECT_GT(status.typed, 0u);
+    EXPECT_LT(status.typed, 100u);
+}
+
+TEST_F(InputTest, KeyEventLatency)
+{
+    constexpr int events = 2000;
+    std::vector<uint64_t> latencies;
+
+    for (int i = 0; i < events; ++i)
+    {
+        auto t = std::chrono::steady_clock::now();
+        uint64_t sent = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            t.time_since_epoch())
+                            .count();
+
+        Input::keyEvent(i % 2 == 0, XK_a, client.get());
+
+        auto records = sink->getRecords();
+
+        ASSERT_FALSE(records.empty());
+        latencies.push_back(records.back().timestamp - sent);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    EXPECT_EQ(deviceRecords().size(), (size_t)events);
+    ::testing::Test::RecordProperty("p50_ns",
+                                    (int)latencies[latencies.size() / 2]);
+    ::testing::Test::RecordProperty(
+        "p99_ns", (int)latencies[latencies.size() * 99 / 100]);
+}
+
+TEST_F(InputTest, PointerEventLatency)
+{
+    constexpr int events = 500;
+    constexpr unsigned int width = 800;
+    std::vector<uint64_t> sent;
+    std::vector<uint64_t> latencies;
+    size_t covered = 0;
+
+    // A client moving the pointer at 1 kHz, with the server loop flushing
+    // the coalesced report after every event
+    for (int i = 0; i < events; ++i)
+    {
+        sent.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch())
+                           .count());
+        input->sendPointer(0, i % width, 300, width, 600);
+        input->flushPointer();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    for (int i = 0; i < 20; ++i)
+    {
+        input->flushPointer();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    auto records = sink->getRecords();
+
+    // Each report carries the latest position, so its latency is counted
+    // from the oldest event it superseded
+    for (const auto& r : records)
+    {
+        uint16_t x;
+
+        memcpy(&x, &r.report[1], sizeof(x));
+        while (covered < sent.size() &&
+               Input::scaleCoordinate(covered % width, width) <= x)
+        {
+            latencies.push_back(r.timestamp - sent[covered]);
+            covered++;
+        }
+    }
+
+    ASSERT_FALSE(records.empty());
+    EXPECT_EQ(covered, sent.size());
+    EXPECT_LT(records.size(), (size_t)events);
+
+    std::sort(latencies.begin(), latencies.end());
+
+    ::testing::Test::RecordProperty("reports", (int)records.size());
+    ::testing::Test::RecordProperty("p50_ns",
+                                    (int)latencies[latencies.size() / 2]);
+    ::testing::Test::RecordProperty(
+        "p99_ns", (int)latencies[latencies.size() * 99 / 100]);
+}
+
+TEST_F(InputTest, ThroughputUnderLoad)
+{
+    constexpr int keys = 50;
+
+    // A host polling at 1 kHz that also rejects some writes, while the
+    // pointer moves between every key event
+    sink->setPollInterval(std::chrono::milliseconds(1));
+    sink->setEagainEvery(7);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < keys * 2; ++i)
+    {
+        input->sendPointer(0, i % 800, 300, 800, 600);
+        Input::keyEvent(i % 2 == 0, XK_a, client.get());
+        input->flushPointer();
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    auto records = deviceRecords();
+    auto pointerRecords = deviceRecords(Device::pointer);
+
+    // Every key report gets through, pointer reports being merged instead
+    ASSERT_EQ(records.size(), (size_t)keys * 2);
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        EXPECT_EQ(records[i].report[2], (i % 2 == 0) ? USBHID_KEY_A : 0);
+    }
+    EXPECT_FALSE(pointerRecords.empty());
+    EXPECT_GT(sink->getEagainCount(), 0u);
+
+    ::testing::Test::RecordProperty(
+        "key_reports_per_s", (int)(records.size() * 1000000 /
+                                   std::max<int64_t>(elapsed.count(), 1)));
+    ::testing::Test::RecordProperty("pointer_reports",
+                                    (int)pointerRecords.size());
+    ::testing::Test::RecordProperty("eagain",
+                                    (int)sink->getEagainCount());
+}
+
+TEST(LocalSinkTest, RingKeepsMostRecentRecords)
+{
+    LocalSink sink("", 4);
+
+    sink.connect();
+    for (uint8_t i = 0; i < 6; ++i)
+    {
+        ASSERT_EQ(sink.write(HidSink::Device::pointer, &i, 1), 1);
+    }
+
+    auto records = sink.getRecords();
+
+    ASSERT_EQ(records.size(), 4u);
+    for (uint8_t i = 0; i < 4; ++i)
+    {
+        EXPECT_EQ(records[i].report[0], i + 2);
+        EXPECT_EQ(records[i].device, (uint8_t)HidSink::Device::pointer);
+    }
+
+    sink.clearRecords();
+    EXPECT_TRUE(sink.getRecords().empty());
+}
+
+TEST(LocalSinkTest, WritesRecordsToPipe)
+{
+    int fds[2];
+
+    ASSERT_EQ(pipe(fds), 0);
+
+    {
+        LocalSink sink("/dev/fd/" + std::to_string(fds[1]));
+        uint8_t report[6] = {1, 2, 3, 4, 5, 6};
+
+        sink.connect();
+        ASSERT_EQ(sink.write(HidSink::Device::pointer, report, 6), 6);
+    }
+
+    LocalSink::Record record;
+
+    ASSERT_EQ(read(fds[0], &record, sizeof(record)),
+              (ssize_t)sizeof(record));
+    EXPECT_EQ(record.length, 6);
+    EXPECT_EQ(record.report[5], 6);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(LocalSinkTest, PollWaitsForHost)
+{
+    LocalSink sink;
+    uint8_t report = 0;
+
+    sink.connect();
+    sink.setPollInterval(std::chrono::milliseconds(20));
+
+    ASSERT_EQ(sink.write(HidSink::Device::keyboard, &report, 1), 1);
+    EXPECT_EQ(sink.write(HidSink::Device::keyboard, &report, 1), -1);
+    EXPECT_EQ(errno, EAGAIN);
+
+    // The devices are polled independently
+    EXPECT_EQ(sink.poll(HidSink::Device::pointer,
+                        std::chrono::milliseconds(0)),
+              1);
+    EXPECT_EQ(sink.poll(HidSink::Device::keyboard,
+                        std::chrono::milliseconds(1)),
+              0);
+    EXPECT_EQ(sink.poll(HidSink::Device::keyboard,
+                        std::chrono::milliseconds(50)),
+              1);
+    EXPECT_EQ(sink.write(HidSink::Device::keyboard, &report, 1), 1);
+}
+
+} // namespace ikvm
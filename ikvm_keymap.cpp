@@ -0,0 +1,620 @@
+#include "ikvm_keymap.hpp"
+
+#include "scancodes.hpp"
+
+#include <rfb/keysym.h>
+
+#include <algorithm>
+#include <array>
+#include <span>
+
+namespace ikvm
+{
+namespace
+{
+/*
+ * @struct Entry
+ * @brief Keysym to HID key mapping used to generate the lookup tables
+ */
+struct Entry
+{
+    rfbKeySym key;
+    Keymap::KeyCode code;
+};
+
+constexpr uint8_t S = Keymap::shift;
+constexpr uint8_t AG = Keymap::altGr;
+
+// Keysyms outside of the Latin-1 and function key pages
+constexpr rfbKeySym keysymDeadGrave = 0xfe50;
+constexpr rfbKeySym keysymDeadAcute = 0xfe51;
+constexpr rfbKeySym keysymDeadCircumflex = 0xfe52;
+constexpr rfbKeySym keysymDeadDiaeresis = 0xfe57;
+constexpr rfbKeySym keysymEuroSign = 0x20ac;
+
+constexpr Entry key(rfbKeySym k, uint8_t sc, uint8_t mods = 0)
+{
+    return {k, {sc, mods, false}};
+}
+
+constexpr Entry deadKey(rfbKeySym k, uint8_t sc, uint8_t mods = 0)
+{
+    return {k, {sc, mods, true}};
+}
+
+} // namespace
+
+struct Keymap::Tables
+{
+    /* @brief Maximum number of keysyms outside of the dense pages */
+    static constexpr size_t otherMax = 16;
+
+    /* @brief Keys for the Latin-1 keysyms 0x0000 - 0x00ff */
+    std::array<KeyCode, 256> latin1;
+    /* @brief Keys for the function keysyms 0xff00 - 0xffff */
+    std::array<KeyCode, 256> misc;
+    /* @brief Keys for any other keysyms, sorted by keysym */
+    std::array<Entry, otherMax> other;
+    /* @brief Number of valid entries in other */
+    size_t otherCount;
+
+    constexpr void add(std::span<const Entry> entries)
+    {
+        for (const auto& e : entries)
+        {
+            if (e.key <= 0xff)
+            {
+                latin1[e.key] = e.code;
+            }
+            else if (e.key >= 0xff00 && e.key <= 0xffff)
+            {
+                misc[e.key & 0xff] = e.code;
+            }
+            else
+            {
+                // Fails to compile if otherMax is too small
+                other.at(otherCount++) = e;
+            }
+        }
+
+        std::sort(other.begin(), other.begin() + otherCount,
+                  [](const Entry& a, const Entry& b) { return a.key < b.key; });
+    }
+
+    constexpr void addLetters()
+    {
+        for (uint8_t i = 0; i < 26; ++i)
+        {
+            latin1['a' + i] = {(uint8_t)(USBHID_KEY_A + i), 0, false};
+            latin1['A' + i] = {(uint8_t)(USBHID_KEY_A + i), S, false};
+        }
+    }
+
+    constexpr void addFunctionKeys()
+    {
+        for (uint8_t i = 0; i < 12; ++i)
+        {
+            misc[(XK_F1 + i) & 0xff] = {(uint8_t)(USBHID_KEY_F1 + i), 0,
+                                        false};
+        }
+
+        for (uint8_t i = 0; i < 4; ++i)
+        {
+            misc[(XK_KP_F1 + i) & 0xff] = {(uint8_t)(USBHID_KEY_F1 + i), 0,
+                                           false};
+        }
+
+        for (uint8_t i = 0; i < 9; ++i)
+        {
+            misc[(XK_KP_1 + i) & 0xff] = {(uint8_t)(USBHID_KEY_KP_1 + i), 0,
+                                          false};
+        }
+
+        add(miscKeys);
+    }
+
+    /* @brief Layout independent keys of the function keysym page */
+    static constexpr Entry miscKeys[] = {
+        key(XK_Return, USBHID_KEY_RETURN),
+        key(XK_Escape, USBHID_KEY_ESC),
+        key(XK_BackSpace, USBHID_KEY_BACKSPACE),
+        key(XK_Tab, USBHID_KEY_TAB),
+        key(XK_KP_Tab, USBHID_KEY_TAB),
+        key(XK_KP_Space, USBHID_KEY_SPACE),
+        key(XK_Caps_Lock, USBHID_KEY_CAPSLOCK),
+        key(XK_Print, USBHID_KEY_PRINT),
+        key(XK_Scroll_Lock, USBHID_KEY_SCROLLLOCK),
+        key(XK_Pause, USBHID_KEY_PAUSE),
+        key(XK_Insert, USBHID_KEY_INSERT),
+        key(XK_KP_Insert, USBHID_KEY_INSERT),
+        key(XK_Home, USBHID_KEY_HOME),
+        key(XK_KP_Home, USBHID_KEY_HOME),
+        key(XK_Page_Up, USBHID_KEY_PAGEUP),
+        key(XK_KP_Page_Up, USBHID_KEY_PAGEUP),
+        key(XK_Delete, USBHID_KEY_DELETE),
+        key(XK_KP_Delete, USBHID_KEY_DELETE),
+        key(XK_End, USBHID_KEY_END),
+        key(XK_KP_End, USBHID_KEY_END),
+        key(XK_Page_Down, USBHID_KEY_PAGEDOWN),
+        key(XK_KP_Page_Down, USBHID_KEY_PAGEDOWN),
+        key(XK_Right, USBHID_KEY_RIGHT),
+        key(XK_KP_Right, USBHID_KEY_RIGHT),
+        key(XK_Left, USBHID_KEY_LEFT),
+        key(XK_KP_Left, USBHID_KEY_LEFT),
+        key(XK_Down, USBHID_KEY_DOWN),
+        key(XK_KP_Down, USBHID_KEY_DOWN),
+        key(XK_Up, USBHID_KEY_UP),
+        key(XK_KP_Up, USBHID_KEY_UP),
+        key(XK_Num_Lock, USBHID_KEY_NUMLOCK),
+        key(XK_KP_Enter, USBHID_KEY_KP_ENTER),
+        key(XK_KP_Equal, USBHID_KEY_KP_EQUAL),
+        key(XK_KP_Multiply, USBHID_KEY_KP_MULTIPLY),
+        key(XK_KP_Add, USBHID_KEY_KP_ADD),
+        key(XK_KP_Subtract, USBHID_KEY_KP_SUBTRACT),
+        key(XK_KP_Decimal, USBHID_KEY_KP_DECIMAL),
+        key(XK_KP_Divide, USBHID_KEY_KP_DIVIDE),
+        key(XK_KP_0, USBHID_KEY_KP_0),
+        key(XK_Menu, USBHID_MENU),
+    };
+};
+
+namespace
+{
+constexpr Entry usKeys[] = {
+    key(XK_space, USBHID_KEY_SPACE),
+    key(XK_1, USBHID_KEY_1),
+    key(XK_exclam, USBHID_KEY_1, S),
+    key(XK_2, USBHID_KEY_2),
+    key(XK_at, USBHID_KEY_2, S),
+    key(XK_3, USBHID_KEY_3),
+    key(XK_numbersign, USBHID_KEY_3, S),
+    key(XK_4, USBHID_KEY_4),
+    key(XK_dollar, USBHID_KEY_4, S),
+    key(XK_5, USBHID_KEY_5),
+    key(XK_percent, USBHID_KEY_5, S),
+    key(XK_6, USBHID_KEY_6),
+    key(XK_asciicircum, USBHID_KEY_6, S),
+    key(XK_7, USBHID_KEY_7),
+    key(XK_ampersand, USBHID_KEY_7, S),
+    key(XK_8, USBHID_KEY_8),
+    key(XK_asterisk, USBHID_KEY_8, S),
+    key(XK_9, USBHID_KEY_9),
+    key(XK_parenleft, USBHID_KEY_9, S),
+    key(XK_0, USBHID_KEY_0),
+    key(XK_parenright, USBHID_KEY_0, S),
+    key(XK_minus, USBHID_KEY_MINUS),
+    key(XK_underscore, USBHID_KEY_MINUS, S),
+    key(XK_equal, USBHID_KEY_EQUAL),
+    key(XK_plus, USBHID_KEY_EQUAL, S),
+    key(XK_bracketleft, USBHID_KEY_LEFTBRACE),
+    key(XK_braceleft, USBHID_KEY_LEFTBRACE, S),
+    key(XK_bracketright, USBHID_KEY_RIGHTBRACE),
+    key(XK_braceright, USBHID_KEY_RIGHTBRACE, S),
+    key(XK_backslash, USBHID_KEY_BACKSLASH),
+    key(XK_bar, USBHID_KEY_BACKSLASH, S),
+    key(XK_semicolon, USBHID_KEY_SEMICOLON),
+    key(XK_colon, USBHID_KEY_SEMICOLON, S),
+    key(XK_apostrophe, USBHID_KEY_APOSTROPHE),
+    key(XK_quotedbl, USBHID_KEY_APOSTROPHE, S),
+    key(XK_grave, USBHID_KEY_GRAVE),
+    key(XK_asciitilde, USBHID_KEY_GRAVE, S),
+    key(XK_comma, USBHID_KEY_COMMA),
+    key(XK_less, USBHID_KEY_COMMA, S),
+    key(XK_period, USBHID_KEY_DOT),
+    key(XK_greater, USBHID_KEY_DOT, S),
+    key(XK_slash, USBHID_KEY_SLASH),
+    key(XK_question, USBHID_KEY_SLASH, S),
+};
+
+// German QWERTZ
+constexpr Entry deKeys[] = {
+    key(XK_space, USBHID_KEY_SPACE),
+    key(XK_y, USBHID_KEY_Z),
+    key(XK_Y, USBHID_KEY_Z, S),
+    key(XK_z, USBHID_KEY_Y),
+    key(XK_Z, USBHID_KEY_Y, S),
+    key(XK_at, USBHID_KEY_Q, AG),
+    key(keysymEuroSign, USBHID_KEY_E, AG),
+    key(XK_mu, USBHID_KEY_M, AG),
+    key(XK_1, USBHID_KEY_1),
+    key(XK_exclam, USBHID_KEY_1, S),
+    key(XK_2, USBHID_KEY_2),
+    key(XK_quotedbl, USBHID_KEY_2, S),
+    key(XK_twosuperior, USBHID_KEY_2, AG),
+    key(XK_3, USBHID_KEY_3),
+    key(XK_section, USBHID_KEY_3, S),
+    key(XK_threesuperior, USBHID_KEY_3, AG),
+    key(XK_4, USBHID_KEY_4),
+    key(XK_dollar, USBHID_KEY_4, S),
+    key(XK_5, USBHID_KEY_5),
+    key(XK_percent, USBHID_KEY_5, S),
+    key(XK_6, USBHID_KEY_6),
+    key(XK_ampersand, USBHID_KEY_6, S),
+    key(XK_7, USBHID_KEY_7),
+    key(XK_slash, USBHID_KEY_7, S),
+    key(XK_braceleft, USBHID_KEY_7, AG),
+    key(XK_8, USBHID_KEY_8),
+    key(XK_parenleft, USBHID_KEY_8, S),
+    key(XK_bracketleft, USBHID_KEY_8, AG),
+    key(XK_9, USBHID_KEY_9),
+    key(XK_parenright, USBHID_KEY_9, S),
+    key(XK_bracketright, USBHID_KEY_9, AG),
+    key(XK_0, USBHID_KEY_0),
+    key(XK_equal, USBHID_KEY_0, S),
+    key(XK_braceright, USBHID_KEY_0, AG),
+    key(XK_ssharp, USBHID_KEY_MINUS),
+    key(XK_question, USBHID_KEY_MINUS, S),
+    key(XK_backslash, USBHID_KEY_MINUS, AG),
+    deadKey(XK_acute, USBHID_KEY_EQUAL),
+    deadKey(XK_grave, USBHID_KEY_EQUAL, S),
+    key(keysymDeadAcute, USBHID_KEY_EQUAL),
+    key(keysymDeadGrave, USBHID_KEY_EQUAL, S),
+    deadKey(XK_asciicircum, USBHID_KEY_GRAVE),
+    key(keysymDeadCircumflex, USBHID_KEY_GRAVE),
+    key(XK_degree, USBHID_KEY_GRAVE, S),
+    key(XK_udiaeresis, USBHID_KEY_LEFTBRACE),
+    key(XK_Udiaeresis, USBHID_KEY_LEFTBRACE, S),
+    key(XK_plus, USBHID_KEY_RIGHTBRACE),
+    key(XK_asterisk, USBHID_KEY_RIGHTBRACE, S),
+    key(XK_asciitilde, USBHID_KEY_RIGHTBRACE, AG),
+    key(XK_odiaeresis, USBHID_KEY_SEMICOLON),
+    key(XK_Odiaeresis, USBHID_KEY_SEMICOLON, S),
+    key(XK_adiaeresis, USBHID_KEY_APOSTROPHE),
+    key(XK_Adiaeresis, USBHID_KEY_APOSTROPHE, S),
+    key(XK_numbersign, USBHID_KEY_HASH),
+    key(XK_apostrophe, USBHID_KEY_HASH, S),
+    key(XK_less, USBHID_KEY_102ND),
+    key(XK_greater, USBHID_KEY_102ND, S),
+    key(XK_bar, USBHID_KEY_102ND, AG),
+    key(XK_comma, USBHID_KEY_COMMA),
+    key(XK_semicolon, USBHID_KEY_COMMA, S),
+    key(XK_period, USBHID_KEY_DOT),
+    key(XK_colon, USBHID_KEY_DOT, S),
+    key(XK_minus, USBHID_KEY_SLASH),
+    key(XK_underscore, USBHID_KEY_SLASH, S),
+};
+
+// French AZERTY
+constexpr Entry frKeys[] = {
+    key(XK_space, USBHID_KEY_SPACE),
+    key(XK_a, USBHID_KEY_Q),
+    key(XK_A, USBHID_KEY_Q, S),
+    key(XK_q, USBHID_KEY_A),
+    key(XK_Q, USBHID_KEY_A, S),
+    key(XK_z, USBHID_KEY_W),
+    key(XK_Z, USBHID_KEY_W, S),
+    key(XK_w, USBHID_KEY_Z),
+    key(XK_W, USBHID_KEY_Z, S),
+    key(XK_m, USBHID_KEY_SEMICOLON),
+    key(XK_M, USBHID_KEY_SEMICOLON, S),
+    key(keysymEuroSign, USBHID_KEY_E, AG),
+    key(XK_ampersand, USBHID_KEY_1),
+    key(XK_1, USBHID_KEY_1, S),
+    key(XK_eacute, USBHID_KEY_2),
+    key(XK_2, USBHID_KEY_2, S),
+    key(XK_asciitilde, USBHID_KEY_2, AG),
+    key(XK_quotedbl, USBHID_KEY_3),
+    key(XK_3, USBHID_KEY_3, S),
+    key(XK_numbersign, USBHID_KEY_3, AG),
+    key(XK_apostrophe, USBHID_KEY_4),
+    key(XK_4, USBHID_KEY_4, S),
+    key(XK_braceleft, USBHID_KEY_4, AG),
+    key(XK_parenleft, USBHID_KEY_5),
+    key(XK_5, USBHID_KEY_5, S),
+    key(XK_bracketleft, USBHID_KEY_5, AG),
+    key(XK_minus, USBHID_KEY_6),
+    key(XK_6, USBHID_KEY_6, S),
+    key(XK_bar, USBHID_KEY_6, AG),
+    key(XK_egrave, USBHID_KEY_7),
+    key(XK_7, USBHID_KEY_7, S),
+    key(XK_grave, USBHID_KEY_7, AG),
+    key(XK_underscore, USBHID_KEY_8),
+    key(XK_8, USBHID_KEY_8, S),
+    key(XK_backslash, USBHID_KEY_8, AG),
+    key(XK_ccedilla, USBHID_KEY_9),
+    key(XK_9, USBHID_KEY_9, S),
+    key(XK_asciicircum, USBHID_KEY_9, AG),
+    key(XK_agrave, USBHID_KEY_0),
+    key(XK_0, USBHID_KEY_0, S),
+    key(XK_at, USBHID_KEY_0, AG),
+    key(XK_parenright, USBHID_KEY_MINUS),
+    key(XK_degree, USBHID_KEY_MINUS, S),
+    key(XK_bracketright, USBHID_KEY_MINUS, AG),
+    key(XK_equal, USBHID_KEY_EQUAL),
+    key(XK_plus, USBHID_KEY_EQUAL, S),
+    key(XK_braceright, USBHID_KEY_EQUAL, AG),
+    key(keysymDeadCircumflex, USBHID_KEY_LEFTBRACE),
+    key(keysymDeadDiaeresis, USBHID_KEY_LEFTBRACE, S),
+    key(XK_dollar, USBHID_KEY_RIGHTBRACE),
+    key(XK_sterling, USBHID_KEY_RIGHTBRACE, S),
+    key(XK_currency, USBHID_KEY_RIGHTBRACE, AG),
+    key(XK_ugrave, USBHID_KEY_APOSTROPHE),
+    key(XK_percent, USBHID_KEY_APOSTROPHE, S),
+    key(XK_asterisk, USBHID_KEY_HASH),
+    key(XK_mu, USBHID_KEY_HASH, S),
+    key(XK_twosuperior, USBHID_KEY_GRAVE),
+    key(XK_less, USBHID_KEY_102ND),
+    key(XK_greater, USBHID_KEY_102ND, S),
+    key(XK_comma, USBHID_KEY_M),
+    key(XK_question, USBHID_KEY_M, S),
+    key(XK_semicolon, USBHID_KEY_COMMA),
+    key(XK_period, USBHID_KEY_COMMA, S),
+    key(XK_colon, USBHID_KEY_DOT),
+    key(XK_slash, USBHID_KEY_DOT, S),
+    key(XK_exclam, USBHID_KEY_SLASH),
+    key(XK_section, USBHID_KEY_SLASH, S),
+};
+
+// Japanese 106/109 key
+constexpr Entry jpKeys[] = {
+    key(XK_space, USBHID_KEY_SPACE),
+    key(XK_1, USBHID_KEY_1),
+    key(XK_exclam, USBHID_KEY_1, S),
+    key(XK_2, USBHID_KEY_2),
+    key(XK_quotedbl, USBHID_KEY_2, S),
+    key(XK_3, USBHID_KEY_3),
+    key(XK_numbersign, USBHID_KEY_3, S),
+    key(XK_4, USBHID_KEY_4),
+    key(XK_dollar, USBHID_KEY_4, S),
+    key(XK_5, USBHID_KEY_5),
+    key(XK_percent, USBHID_KEY_5, S),
+    key(XK_6, USBHID_KEY_6),
+    key(XK_ampersand, USBHID_KEY_6, S),
+    key(XK_7, USBHID_KEY_7),
+    key(XK_apostrophe, USBHID_KEY_7, S),
+    key(XK_8, USBHID_KEY_8),
+    key(XK_parenleft, USBHID_KEY_8, S),
+    key(XK_9, USBHID_KEY_9),
+    key(XK_parenright, USBHID_KEY_9, S),
+    key(XK_0, USBHID_KEY_0),
+    key(XK_minus, USBHID_KEY_MINUS),
+    key(XK_equal, USBHID_KEY_MINUS, S),
+    key(XK_asciicircum, USBHID_KEY_EQUAL),
+    key(XK_asciitilde, USBHID_KEY_EQUAL, S),
+    key(XK_at, USBHID_KEY_LEFTBRACE),
+    key(XK_grave, USBHID_KEY_LEFTBRACE, S),
+    key(XK_bracketleft, USBHID_KEY_RIGHTBRACE),
+    key(XK_braceleft, USBHID_KEY_RIGHTBRACE, S),
+    key(XK_semicolon, USBHID_KEY_SEMICOLON),
+    key(XK_plus, USBHID_KEY_SEMICOLON, S),
+    key(XK_colon, USBHID_KEY_APOSTROPHE),
+    key(XK_asterisk, USBHID_KEY_APOSTROPHE, S),
+    key(XK_bracketright, USBHID_KEY_HASH),
+    key(XK_braceright, USBHID_KEY_HASH, S),
+    key(XK_comma, USBHID_KEY_COMMA),
+    key(XK_less, USBHID_KEY_COMMA, S),
+    key(XK_period, USBHID_KEY_DOT),
+    key(XK_greater, USBHID_KEY_DOT, S),
+    key(XK_slash, USBHID_KEY_SLASH),
+    key(XK_question, USBHID_KEY_SLASH, S),
+    key(XK_backslash, USBHID_KEY_RO),
+    key(XK_underscore, USBHID_KEY_RO, S),
+    key(XK_yen, USBHID_KEY_YEN),
+    key(XK_bar, USBHID_KEY_YEN, S),
+    key(XK_Zenkaku_Hankaku, USBHID_KEY_GRAVE),
+    key(XK_Henkan_Mode, USBHID_KEY_HENKAN),
+    key(XK_Muhenkan, USBHID_KEY_MUHENKAN),
+    key(XK_Hiragana_Katakana, USBHID_KEY_KATAKANAHIRAGANA),
+};
+
+constexpr Keymap::Tables makeTables(std::span<const Entry> layoutKeys)
+{
+    Keymap::Tables t{};
+
+    t.addLetters();
+    t.addFunctionKeys();
+    t.add(layoutKeys);
+
+    return t;
+}
+
+constexpr Keymap::Tables usTables = makeTables(usKeys);
+constexpr Keymap::Tables deTables = makeTables(deKeys);
+constexpr Keymap::Tables frTables = makeTables(frKeys);
+constexpr Keymap::Tables jpTables = makeTables(jpKeys);
+
+static_assert(usTables.latin1['a'].scancode == USBHID_KEY_A);
+static_assert(deTables.latin1['z'].scancode == USBHID_KEY_Y);
+static_assert(frTables.latin1['a'].scancode == USBHID_KEY_Q);
+static_assert(usTables.misc[XK_Return & 0xff].scancode == USBHID_KEY_RETURN);
+
+/*
+ * @struct XtEntry
+ * @brief QEMU key code to HID key mapping used to generate the XT table
+ */
+struct XtEntry
+{
+    uint8_t code;
+    uint8_t scancode;
+};
+
+// XT scancode set 1; keys sent with the 0xe0 prefix have bit 7 set
+constexpr XtEntry xtKeys[] = {
+    {0x01, USBHID_KEY_ESC},
+    {0x0c, USBHID_KEY_MINUS},
+    {0x0d, USBHID_KEY_EQUAL},
+    {0x0e, USBHID_KEY_BACKSPACE},
+    {0x0f, USBHID_KEY_TAB},
+    {0x10, USBHID_KEY_Q},
+    {0x11, USBHID_KEY_W},
+    {0x12, USBHID_KEY_E},
+    {0x13, USBHID_KEY_R},
+    {0x14, USBHID_KEY_T},
+    {0x15, USBHID_KEY_Y},
+    {0x16, USBHID_KEY_U},
+    {0x17, USBHID_KEY_I},
+    {0x18, USBHID_KEY_O},
+    {0x19, USBHID_KEY_P},
+    {0x1a, USBHID_KEY_LEFTBRACE},
+    {0x1b, USBHID_KEY_RIGHTBRACE},
+    {0x1c, USBHID_KEY_RETURN},
+    {0x1d, USBHID_KEY_LEFTCTRL},
+    {0x1e, USBHID_KEY_A},
+    {0x1f, USBHID_KEY_S},
+    {0x20, USBHID_KEY_D},
+    {0x21, USBHID_KEY_F},
+    {0x22, USBHID_KEY_G},
+    {0x23, USBHID_KEY_H},
+    {0x24, USBHID_KEY_J},
+    {0x25, USBHID_KEY_K},
+    {0x26, USBHID_KEY_L},
+    {0x27, USBHID_KEY_SEMICOLON},
+    {0x28, USBHID_KEY_APOSTROPHE},
+    {0x29, USBHID_KEY_GRAVE},
+    {0x2a, USBHID_KEY_LEFTSHIFT},
+    {0x2b, USBHID_KEY_BACKSLASH},
+    {0x2c, USBHID_KEY_Z},
+    {0x2d, USBHID_KEY_X},
+    {0x2e, USBHID_KEY_C},
+    {0x2f, USBHID_KEY_V},
+    {0x30, USBHID_KEY_B},
+    {0x31, USBHID_KEY_N},
+    {0x32, USBHID_KEY_M},
+    {0x33, USBHID_KEY_COMMA},
+    {0x34, USBHID_KEY_DOT},
+    {0x35, USBHID_KEY_SLASH},
+    {0x36, USBHID_KEY_RIGHTSHIFT},
+    {0x37, USBHID_KEY_KP_MULTIPLY},
+    {0x38, USBHID_KEY_LEFTALT},
+    {0x39, USBHID_KEY_SPACE},
+    {0x3a, USBHID_KEY_CAPSLOCK},
+    {0x45, USBHID_KEY_NUMLOCK},
+    {0x46, USBHID_KEY_SCROLLLOCK},
+    {0x47, USBHID_KEY_KP_7},
+    {0x48, USBHID_KEY_KP_8},
+    {0x49, USBHID_KEY_KP_9},
+    {0x4a, USBHID_KEY_KP_SUBTRACT},
+    {0x4b, USBHID_KEY_KP_4},
+    {0x4c, USBHID_KEY_KP_5},
+    {0x4d, USBHID_KEY_KP_6},
+    {0x4e, USBHID_KEY_KP_ADD},
+    {0x4f, USBHID_KEY_KP_1},
+    {0x50, USBHID_KEY_KP_2},
+    {0x51, USBHID_KEY_KP_3},
+    {0x52, USBHID_KEY_KP_0},
+    {0x53, USBHID_KEY_KP_DECIMAL},
+    {0x54, USBHID_KEY_PRINT},
+    {0x56, USBHID_KEY_102ND},
+    {0x57, USBHID_KEY_F11},
+    {0x58, USBHID_KEY_F12},
+    {0x59, USBHID_KEY_KP_EQUAL},
+    {0x70, USBHID_KEY_KATAKANAHIRAGANA},
+    {0x73, USBHID_KEY_RO},
+    {0x79, USBHID_KEY_HENKAN},
+    {0x7b, USBHID_KEY_MUHENKAN},
+    {0x7d, USBHID_KEY_YEN},
+    {0x7e, USBHID_KEY_KP_COMMA},
+    {0x9c, USBHID_KEY_KP_ENTER},
+    {0x9d, USBHID_KEY_RIGHTCTRL},
+    {0xb5, USBHID_KEY_KP_DIVIDE},
+    {0xb7, USBHID_KEY_PRINT},
+    {0xb8, USBHID_KEY_RIGHTALT},
+    {0xc6, USBHID_KEY_PAUSE},
+    {0xc7, USBHID_KEY_HOME},
+    {0xc8, USBHID_KEY_UP},
+    {0xc9, USBHID_KEY_PAGEUP},
+    {0xcb, USBHID_KEY_LEFT},
+    {0xcd, USBHID_KEY_RIGHT},
+    {0xcf, USBHID_KEY_END},
+    {0xd0, USBHID_KEY_DOWN},
+    {0xd1, USBHID_KEY_PAGEDOWN},
+    {0xd2, USBHID_KEY_INSERT},
+    {0xd3, USBHID_KEY_DELETE},
+    {0xdb, USBHID_KEY_LEFTMETA},
+    {0xdc, USBHID_KEY_RIGHTMETA},
+    {0xdd, USBHID_MENU},
+    {0xde, USBHID_KEY_POWER},
+};
+
+constexpr std::array<uint8_t, 256> makeXtScancodes()
+{
+    std::array<uint8_t, 256> t{};
+
+    // Digit row 1 - 0
+    for (uint8_t i = 0; i < 10; ++i)
+    {
+        t[0x02 + i] = USBHID_KEY_1 + i;
+    }
+
+    // F1 - F10
+    for (uint8_t i = 0; i < 10; ++i)
+    {
+        t[0x3b + i] = USBHID_KEY_F1 + i;
+    }
+
+    for (const auto& e : xtKeys)
+    {
+        t[e.code] = e.scancode;
+    }
+
+    return t;
+}
+
+static_assert(makeXtScancodes()[0x1e] == USBHID_KEY_A);
+static_assert(makeXtScancodes()[0xc8] == USBHID_KEY_UP);
+
+} // namespace
+
+const std::array<uint8_t, 256> Keymap::xtScancodes = makeXtScancodes();
+
+Keymap::Keymap(Layout l) : layout(l)
+{
+    switch (layout)
+    {
+        case Layout::de:
+            tables = &deTables;
+            break;
+        case Layout::fr:
+            tables = &frTables;
+            break;
+        case Layout::jp:
+            tables = &jpTables;
+            break;
+        case Layout::us:
+        default:
+            tables = &usTables;
+            break;
+    }
+
+    latin1 = tables->latin1.data();
+    misc = tables->misc.data();
+}
+
+std::optional<Keymap::Layout> Keymap::parseLayout(std::string_view name)
+{
+    if (name == "us")
+    {
+        return Layout::us;
+    }
+    else if (name == "de")
+    {
+        return Layout::de;
+    }
+    else if (name == "fr")
+    {
+        return Layout::fr;
+    }
+    else if (name == "jp")
+    {
+        return Layout::jp;
+    }
+
+    return std::nullopt;
+}
+
+Keymap::KeyCode Keymap::lookupOther(rfbKeySym key) const
+{
+    auto end = tables->other.begin() + tables->otherCount;
+    auto it = std::lower_bound(
+        tables->other.begin(), end, key,
+        [](const Entry& e, rfbKeySym k) { return e.key < k; });
+
+    if (it != end && it->key == key)
+    {
+        return it->code;
+    }
+
+    return {0, 0, false};
+}
+
+} // namespace ikvm
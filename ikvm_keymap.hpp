@@ -0,0 +1,146 @@
+#pragma once
+
+#include <rfb/rfb.h>
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace ikvm
+{
+/*
+ * @class Keymap
+ * @brief Translates RFB key codes (X keysyms) to HID scancodes for the
+ *        keyboard layout configured on the host
+ */
+class Keymap
+{
+  public:
+    /* @brief Host keyboard layouts */
+    enum class Layout
+    {
+        us,
+        de,
+        fr,
+        jp,
+    };
+
+    /*
+     * @struct KeyCode
+     * @brief HID key producing a keysym on the host
+     */
+    struct KeyCode
+    {
+        /* @brief HID scancode, 0 if the keysym can't be typed */
+        uint8_t scancode;
+        /* @brief HID modifier bits the host layout needs for the keysym */
+        uint8_t modifiers;
+        /*
+         * @brief Boolean to indicate the key is a dead key for the keysym,
+         *        which then needs a space to be typed on its own
+         */
+        bool dead;
+    };
+
+    /* @brief HID modifier bit for shift */
+    static constexpr uint8_t shift = 0x02;
+    /* @brief HID modifier bit for AltGr (right alt) */
+    static constexpr uint8_t altGr = 0x40;
+    /* @brief HID modifier bits selecting the shift level of a key */
+    static constexpr uint8_t levelMask = 0x02 | 0x20 | 0x40;
+
+    /*
+     * @brief Constructs Keymap object
+     *
+     * @param[in] l - Keyboard layout of the host
+     */
+    explicit Keymap(Layout l = Layout::us);
+    ~Keymap() = default;
+    Keymap(const Keymap&) = default;
+    Keymap& operator=(const Keymap&) = default;
+    Keymap(Keymap&&) = default;
+    Keymap& operator=(Keymap&&) = default;
+
+    /*
+     * @brief Parses the name of a keyboard layout
+     *
+     * @param[in] name - Layout name, e.g. "us" or "de"
+     *
+     * @return The layout, or nothing if the name is unknown
+     */
+    static std::optional<Layout> parseLayout(std::string_view name);
+
+    /*
+     * @brief Looks up the HID key for a RFB key code in constant time
+     *
+     * @param[in] key - key code
+     *
+     * @return HID key, with a zero scancode if the key code isn't mapped
+     */
+    inline KeyCode lookup(rfbKeySym key) const
+    {
+        if (key <= 0xff)
+        {
+            return latin1[key];
+        }
+
+        if (key >= 0xff00 && key <= 0xffff)
+        {
+            return misc[key & 0xff];
+        }
+
+        return lookupOther(key);
+    }
+
+    /*
+     * @brief Translates a QEMU key code, which is the XT scancode of the
+     *        physical key with bit 7 set for keys using the 0xe0 prefix,
+     *        independent of the keyboard layout
+     *
+     * @param[in] code - QEMU key code
+     *
+     * @return HID scancode, one of 0xe0 - 0xe7 for modifier keys, or 0 if
+     *         the key code isn't mapped
+     */
+    static inline uint8_t xtToScancode(uint32_t code)
+    {
+        return (code < xtScancodes.size()) ? xtScancodes[code] : 0;
+    }
+
+    /*
+     * @brief Gets the keyboard layout
+     *
+     * @return Keyboard layout of the host
+     */
+    inline Layout getLayout() const
+    {
+        return layout;
+    }
+
+    /* @brief Lookup tables of a layout, defined with the layouts */
+    struct Tables;
+
+  private:
+    /*
+     * @brief Looks up a key code outside of the Latin-1 and function key
+     *        pages in the sorted table of the layout
+     *
+     * @param[in] key - key code
+     */
+    KeyCode lookupOther(rfbKeySym key) const;
+
+    /* @brief HID scancodes indexed by QEMU key code */
+    static const std::array<uint8_t, 256> xtScancodes;
+
+    /* @brief Keyboard layout of the host */
+    Layout layout;
+    /* @brief Lookup tables generated at compile time for the layout */
+    const Tables* tables;
+    /* @brief Dense table for the Latin-1 keysyms 0x0000 - 0x00ff */
+    const KeyCode* latin1;
+    /* @brief Dense table for the function keysyms 0xff00 - 0xffff */
+    const KeyCode* misc;
+};
+
+} // namespace ikvm
@@ -0,0 +1,78 @@
+#include "ikvm_keymap.hpp"
+#include "ikvm_keymap_legacy.hpp"
+
+#include <rfb/keysym.h>
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+namespace ikvm
+{
+
+// Mix of keysyms as sent while typing: mostly letters and digits, some
+// punctuation, navigation keys and keypad
+static std::vector<rfbKeySym> typingKeys()
+{
+    std::vector<rfbKeySym> keys;
+
+    for (rfbKeySym key = XK_space; key <= XK_asciitilde; ++key)
+    {
+        keys.push_back(key);
+    }
+    for (rfbKeySym key = XK_a; key <= XK_z; ++key)
+    {
+        keys.push_back(key);
+    }
+    for (rfbKeySym key :
+         {XK_Return, XK_BackSpace, XK_Tab, XK_Escape, XK_Left, XK_Right,
+          XK_Up, XK_Down, XK_Home, XK_End, XK_Delete, XK_F1, XK_F12,
+          XK_KP_Enter, XK_KP_5, XK_KP_Add, XK_Menu, XK_Shift_L})
+    {
+        keys.push_back(key);
+    }
+
+    return keys;
+}
+
+static void BM_KeymapLookup(benchmark::State& state)
+{
+    Keymap keymap((Keymap::Layout)state.range(0));
+    std::vector<rfbKeySym> keys = typingKeys();
+
+    for (auto _ : state)
+    {
+        for (rfbKeySym key : keys)
+        {
+            benchmark::DoNotOptimize(keymap.lookup(key));
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_KeymapLookup)
+    ->ArgName("layout")
+    ->Arg((int)Keymap::Layout::us)
+    ->Arg((int)Keymap::Layout::de)
+    ->Arg((int)Keymap::Layout::fr)
+    ->Arg((int)Keymap::Layout::jp);
+
+static void BM_LegacyKeyToScancode(benchmark::State& state)
+{
+    std::vector<rfbKeySym> keys = typingKeys();
+
+    for (auto _ : state)
+    {
+        for (rfbKeySym key : keys)
+        {
+            benchmark::DoNotOptimize(legacy::keyToScancode(key));
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_LegacyKeyToScancode);
+
+} // namespace ikvm
+
+BENCHMARK_MAIN();
@@ -0,0 +1,331 @@
+#include "ikvm_keymap.hpp"
+#include "ikvm_keymap_legacy.hpp"
+#include "scancodes.hpp"
+
+#include <rfb/keysym.h>
+
+#include <algorithm>
+#include <bitset>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace ikvm
+{
+
+// Reads the report descriptors of the boot and the N-key rollover keyboards
+// written by create_usbhid.sh, in that order
+static std::vector<std::vector<uint8_t>> keyboardDescriptors()
+{
+    std::ifstream script(USBHID_SCRIPT);
+    std::vector<std::vector<uint8_t>> descriptors;
+    std::string line;
+
+    while (std::getline(script, line))
+    {
+        std::vector<uint8_t> desc;
+        size_t pos = 0;
+
+        if (line.find("printf") == std::string::npos ||
+            (line.find("hid.0/report_desc") == std::string::npos &&
+             line.find("hid.2/report_desc") == std::string::npos))
+        {
+            continue;
+        }
+
+        while ((pos = line.find("\\x", pos)) != std::string::npos)
+        {
+            desc.push_back(std::stoi(line.substr(pos + 2, 2), nullptr, 16));
+            pos += 4;
+        }
+        descriptors.push_back(desc);
+    }
+
+    return descriptors;
+}
+
+// Gets the ranges of the keyboard usages a report descriptor lets the
+// keyboard send, from its input items that aren't constant
+static std::vector<std::pair<int, int>> keyRanges(
+    const std::vector<uint8_t>& desc)
+{
+    std::vector<std::pair<int, int>> ranges;
+    int usagePage = 0;
+    int logicalMax = 0;
+    int usageMin = 0;
+    int usageMax = 0;
+
+    for (size_t i = 0; i < desc.size();)
+    {
+        int size = (desc[i] & 3) == 3 ? 4 : desc[i] & 3;
+        int type = (desc[i] >> 2) & 3;
+        int tag = desc[i] >> 4;
+        int value = 0;
+
+        for (int b = 0; b < size && i + 1 + b < desc.size(); ++b)
+        {
+            value |= desc[i + 1 + b] << (8 * b);
+        }
+        i += 1 + size;
+
+        if (type == 1 && tag == 0)
+        {
+            usagePage = value;
+        }
+        else if (type == 1 && tag == 2)
+        {
+            // Logical values are signed
+            logicalMax = size == 1 ? (int8_t)value
+                                   : size == 2 ? (int16_t)value : value;
+        }
+        else if (type == 2 && tag == 1)
+        {
+            usageMin = value;
+        }
+        else if (type == 2 && tag == 2)
+        {
+            usageMax = value;
+        }
+        else if (type == 0 && tag == 8)
+        {
+            bool constant = value & 1;
+            bool variable = value & 2;
+
+            if (usagePage == 7 && !constant)
+            {
+                ranges.emplace_back(usageMin,
+                                    variable ? usageMax
+                                             : std::min(usageMax, logicalMax));
+            }
+            usageMin = usageMax = 0;
+        }
+    }
+
+    return ranges;
+}
+
+// Checks that every usage is within the key ranges of the boot keyboard,
+// and those Input sets in the bitmap within the N-key rollover keyboard
+static void expectInDescriptors(const std::bitset<256>& usages)
+{
+    std::vector<std::vector<uint8_t>> descriptors = keyboardDescriptors();
+
+    ASSERT_EQ(descriptors.size(), 2u);
+
+    for (size_t i = 0; i < descriptors.size(); ++i)
+    {
+        const std::vector<uint8_t>& desc = descriptors[i];
+        std::vector<std::pair<int, int>> ranges = keyRanges(desc);
+        // Modifiers and keys beyond the bitmap stay on the boot keyboard
+        int usageEnd = (i == 0) ? 256 : 0xa0;
+
+        for (int usage = 1; usage < usageEnd; ++usage)
+        {
+            bool found = false;
+
+            for (const auto& [first, last] : ranges)
+            {
+                found |= usage >= first && usage <= last;
+            }
+
+            EXPECT_TRUE(!usages.test(usage) || found)
+                << "usage 0x" << std::hex << usage << " of descriptor "
+                << std::dec << desc.size() << " bytes long";
+        }
+    }
+}
+
+TEST(KeymapTest, ParseLayout)
+{
+    EXPECT_EQ(Keymap::parseLayout("us"), Keymap::Layout::us);
+    EXPECT_EQ(Keymap::parseLayout("de"), Keymap::Layout::de);
+    EXPECT_EQ(Keymap::parseLayout("fr"), Keymap::Layout::fr);
+    EXPECT_EQ(Keymap::parseLayout("jp"), Keymap::Layout::jp);
+    EXPECT_FALSE(Keymap::parseLayout("").has_value());
+    EXPECT_FALSE(Keymap::parseLayout("US").has_value());
+    EXPECT_FALSE(Keymap::parseLayout("dvorak").has_value());
+}
+
+TEST(KeymapTest, UsMatchesLegacyMapping)
+{
+    Keymap keymap(Keymap::Layout::us);
+
+    for (rfbKeySym key = 0; key <= 0x1ffff; ++key)
+    {
+        ASSERT_EQ(keymap.lookup(key).scancode, legacy::keyToScancode(key))
+            << "keysym 0x" << std::hex << key;
+    }
+
+    // Unicode keysyms
+    for (rfbKeySym key = 0x1000000; key <= 0x110ffff; ++key)
+    {
+        ASSERT_EQ(keymap.lookup(key).scancode, 0) << "keysym 0x" << std::hex
+                                                  << key;
+    }
+}
+
+TEST(KeymapTest, UsModifiers)
+{
+    Keymap keymap(Keymap::Layout::us);
+
+    EXPECT_EQ(keymap.lookup(XK_a).modifiers, 0);
+    EXPECT_EQ(keymap.lookup(XK_A).modifiers, Keymap::shift);
+    EXPECT_EQ(keymap.lookup(XK_1).modifiers, 0);
+    EXPECT_EQ(keymap.lookup(XK_exclam).modifiers, Keymap::shift);
+    EXPECT_EQ(keymap.lookup(XK_minus).modifiers, 0);
+    EXPECT_EQ(keymap.lookup(XK_underscore).modifiers, Keymap::shift);
+    EXPECT_EQ(keymap.lookup(XK_question).modifiers, Keymap::shift);
+    EXPECT_EQ(keymap.lookup(XK_Return).modifiers, 0);
+    EXPECT_FALSE(keymap.lookup(XK_asciicircum).dead);
+}
+
+TEST(KeymapTest, German)
+{
+    Keymap keymap(Keymap::Layout::de);
+
+    EXPECT_EQ(keymap.lookup(XK_z).scancode, USBHID_KEY_Y);
+    EXPECT_EQ(keymap.lookup(XK_Y).scancode, USBHID_KEY_Z);
+    EXPECT_EQ(keymap.lookup(XK_Y).modifiers, Keymap::shift);
+    EXPECT_EQ(keymap.lookup(XK_at).scancode, USBHID_KEY_Q);
+    EXPECT_EQ(keymap.lookup(XK_at).modifiers, Keymap::altGr);
+    EXPECT_EQ(keymap.lookup(XK_odiaeresis).scancode, USBHID_KEY_SEMICOLON);
+    EXPECT_EQ(keymap.lookup(XK_less).scancode, USBHID_KEY_102ND);
+    EXPECT_EQ(keymap.lookup(0x20ac).scancode, USBHID_KEY_E);
+    EXPECT_EQ(keymap.lookup(0x20ac).modifiers, Keymap::altGr);
+    EXPECT_TRUE(keymap.lookup(XK_asciicircum).dead);
+    EXPECT_EQ(keymap.lookup(XK_F5).scancode, USBHID_KEY_F5);
+}
+
+TEST(KeymapTest, French)
+{
+    Keymap keymap(Keymap::Layout::fr);
+
+    EXPECT_EQ(keymap.lookup(XK_a).scancode, USBHID_KEY_Q);
+    EXPECT_EQ(keymap.lookup(XK_q).scancode, USBHID_KEY_A);
+    EXPECT_EQ(keymap.lookup(XK_w).scancode, USBHID_KEY_Z);
+    EXPECT_EQ(keymap.lookup(XK_m).scancode, USBHID_KEY_SEMICOLON);
+    EXPECT_EQ(keymap.lookup(XK_1).scancode, USBHID_KEY_1);
+    EXPECT_EQ(keymap.lookup(XK_1).modifiers, Keymap::shift);
+    EXPECT_EQ(keymap.lookup(XK_eacute).scancode, USBHID_KEY_2);
+    EXPECT_EQ(keymap.lookup(XK_comma).scancode, USBHID_KEY_M);
+}
+
+TEST(KeymapTest, Japanese)
+{
+    Keymap keymap(Keymap::Layout::jp);
+
+    EXPECT_EQ(keymap.lookup(XK_at).scancode, USBHID_KEY_LEFTBRACE);
+    EXPECT_EQ(keymap.lookup(XK_at).modifiers, 0);
+    EXPECT_EQ(keymap.lookup(XK_backslash).scancode, USBHID_KEY_RO);
+    EXPECT_EQ(keymap.lookup(XK_bar).scancode, USBHID_KEY_YEN);
+    EXPECT_EQ(keymap.lookup(XK_Henkan_Mode).scancode, USBHID_KEY_HENKAN);
+
+    // Japanese input keys don't exist on the other layouts
+    EXPECT_EQ(Keymap().lookup(XK_Henkan_Mode).scancode, 0);
+}
+
+TEST(KeymapTest, AllLayoutsTypePrintableAscii)
+{
+    for (auto layout : {Keymap::Layout::us, Keymap::Layout::de,
+                        Keymap::Layout::fr, Keymap::Layout::jp})
+    {
+        Keymap keymap(layout);
+
+        for (rfbKeySym key = XK_space; key <= XK_asciitilde; ++key)
+        {
+            EXPECT_NE(keymap.lookup(key).scancode, 0)
+                << "layout " << (int)layout << " keysym 0x" << std::hex
+                << key;
+        }
+    }
+}
+
+TEST(KeymapTest, LayoutsInDescriptors)
+{
+    std::bitset<256> usages;
+
+    for (auto layout : {Keymap::Layout::us, Keymap::Layout::de,
+                        Keymap::Layout::fr, Keymap::Layout::jp})
+    {
+        Keymap keymap(layout);
+
+        for (rfbKeySym key = 0; key <= 0x1ffff; ++key)
+        {
+            usages.set(keymap.lookup(key).scancode);
+        }
+    }
+
+    expectInDescriptors(usages);
+}
+
+TEST(KeymapTest, XtScancodes)
+{
+    EXPECT_EQ(Keymap::xtToScancode(0x01), USBHID_KEY_ESC);
+    EXPECT_EQ(Keymap::xtToScancode(0x02), USBHID_KEY_1);
+    EXPECT_EQ(Keymap::xtToScancode(0x0b), USBHID_KEY_0);
+    EXPECT_EQ(Keymap::xtToScancode(0x10), USBHID_KEY_Q);
+    EXPECT_EQ(Keymap::xtToScancode(0x2c), USBHID_KEY_Z);
+    EXPECT_EQ(Keymap::xtToScancode(0x3b), USBHID_KEY_F1);
+    EXPECT_EQ(Keymap::xtToScancode(0x44), USBHID_KEY_F10);
+    EXPECT_EQ(Keymap::xtToScancode(0x58), USBHID_KEY_F12);
+    EXPECT_EQ(Keymap::xtToScancode(0x56), USBHID_KEY_102ND);
+    EXPECT_EQ(Keymap::xtToScancode(0x73), USBHID_KEY_RO);
+    EXPECT_EQ(Keymap::xtToScancode(0x7d), USBHID_KEY_YEN);
+
+    // Keys with the 0xe0 prefix
+    EXPECT_EQ(Keymap::xtToScancode(0x1c), USBHID_KEY_RETURN);
+    EXPECT_EQ(Keymap::xtToScancode(0x9c), USBHID_KEY_KP_ENTER);
+    EXPECT_EQ(Keymap::xtToScancode(0x48), USBHID_KEY_KP_8);
+    EXPECT_EQ(Keymap::xtToScancode(0xc8), USBHID_KEY_UP);
+    EXPECT_EQ(Keymap::xtToScancode(0xd3), USBHID_KEY_DELETE);
+
+    // Modifiers
+    EXPECT_EQ(Keymap::xtToScancode(0x1d), USBHID_KEY_LEFTCTRL);
+    EXPECT_EQ(Keymap::xtToScancode(0x2a), USBHID_KEY_LEFTSHIFT);
+    EXPECT_EQ(Keymap::xtToScancode(0x38), USBHID_KEY_LEFTALT);
+    EXPECT_EQ(Keymap::xtToScancode(0xb8), USBHID_KEY_RIGHTALT);
+    EXPECT_EQ(Keymap::xtToScancode(0xdb), USBHID_KEY_LEFTMETA);
+
+    EXPECT_EQ(Keymap::xtToScancode(0x00), 0);
+    EXPECT_EQ(Keymap::xtToScancode(0x80), 0);
+    EXPECT_EQ(Keymap::xtToScancode(0x100), 0);
+    EXPECT_EQ(Keymap::xtToScancode(0xe11d45), 0);
+}
+
+TEST(KeymapTest, XtScancodesInDescriptors)
+{
+    std::bitset<256> usages;
+
+    // Keypad comma, power and keypad equals are beyond the keys of a US
+    // keyboard, like the Japanese ones
+    for (uint32_t code = 0; code < 256; ++code)
+    {
+        usages.set(Keymap::xtToScancode(code));
+    }
+
+    expectInDescriptors(usages);
+}
+
+TEST(KeymapTest, XtScancodesAreUnique)
+{
+    std::bitset<256> seen;
+
+    for (uint32_t code = 0; code < 256; ++code)
+    {
+        uint8_t sc = Keymap::xtToScancode(code);
+
+        // Print screen is sent with and without the 0xe0 prefix
+        if (!sc || code == 0x54)
+        {
+            continue;
+        }
+
+        EXPECT_FALSE(seen.test(sc)) << "key code 0x" << std::hex << code;
+        seen.set(sc);
+    }
+}
+
+} // namespace ikvm
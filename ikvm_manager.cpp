@@ -1,52 +1,200 @@
 #include "ikvm_manager.hpp"
 
+#include "ikvm_dbus.hpp"
+#include "ikvm_flight_recorder.hpp"
+#include "ikvm_replay.hpp"
+#include "ikvm_video.hpp"
+
 #include <thread>
 
+#include <phosphor-logging/lg2.hpp>
+
 namespace ikvm
 {
 Manager::Manager(const Args& args) :
     continueExecuting(true), serverDone(false), videoDone(true),
-    videoPaused(false),
-    input(args.getKeyboardPath(), args.getPointerPath(), args.getUdcName()),
-    video(args.getVideoPath(), input, args.getFrameRate(),
-          args.getSubsampling()),
-    server(args, input, video)
-{}
+    videoPaused(false), hostPowered(true),
+    input(makeHidSink(args), args.getKeyboardLayout()),
+    video(makeFrameSource(args, input)), settings(args, *video),
+    server(args, input, *video),
+    rate(video->getFrameRate(), args.getIdleRate()),
+    pacer(video->getFrameRate()), inputEvents(0)
+{
+    if (!args.getDumpPath().empty())
+    {
+        FlightRecorder::dumpOnSignal(args.getDumpPath());
+    }
+
+    input.setPasteEnabled(args.getPasteEnabled());
+
+    // The server probed the frame source, which may have changed its values
+    settings.readBack(*video);
+    if (server.getDBus())
+    {
+        server.getDBus()->publishSettings(settings);
+        server.getDBus()->publishPaste(input);
+        server.getDBus()->watchHostPower([this](bool powered) {
+            if (hostPowered.exchange(powered) != powered)
+            {
+                lg2::info("Host power changed, capture {STATE}", "STATE",
+                          powered ? "resumed" : "suspended");
+            }
+        });
+    }
+}
+
+std::unique_ptr<HidSink> Manager::makeHidSink(const Args& args)
+{
+    if (!args.getInputSinkPath().empty())
+    {
+        auto sink = std::make_unique<LocalSink>(args.getInputSinkPath());
+
+        sink->setPollInterval(
+            std::chrono::microseconds(args.getInputSinkPoll()));
+        sink->setEagainEvery(args.getInputSinkEagain());
+
+        return sink;
+    }
+
+    return std::make_unique<GadgetSink>(
+        args.getKeyboardPath(), args.getPointerPath(), args.getUdcName());
+}
+
+std::unique_ptr<FrameSource> Manager::makeFrameSource(const Args& args,
+                                                      Input& input)
+{
+    if (!args.getReplayPath().empty())
+    {
+        return std::make_unique<Replay>(args.getReplayPath(),
+                                        args.getFrameRate());
+    }
+
+    return std::make_unique<Video>(args.getVideoPath(), input,
+                                   args.getFrameRate(), args.getSubsampling());
+}
 
 void Manager::run()
 {
     std::thread run(serverThread, this);
+    Settings::Values values;
+
+    bool burst = false;
 
     while (continueExecuting)
     {
-        if (server.wantsFrame())
+        pace(burst);
+        burst = false;
+
+        // No capture while the host is off, the clients are shown a
+        // message until it is powered again
+        if (server.wantsFrame() && hostPowered)
         {
-            video.start();
-            video.getFrame();
-            server.sendFrame();
+            video->start();
+
+            // Client input brings a static screen back to the full rate and
+            // captures the next frames as they come
+            if (input.getEventCount() != inputEvents)
+            {
+                inputEvents = input.getEventCount();
+                rate.boost();
+            }
+
+            // Without signal, frames would only time out; the device is
+            // kept open for the timings to be polled
+            if (video->getSignal().present())
+            {
+                auto now = std::chrono::steady_clock::now();
+
+                server.hidePlaceholder();
+                if (rate.due(now))
+                {
+                    video->getFrame();
+                    server.sendFrame();
+                    rate.captured(now, server.lastFrameChanged());
+                    pacer.captured(now);
+                    burst = rate.inBurst();
+                }
+            }
+            else
+            {
+                server.showPlaceholder(noSignalMessage);
+            }
         }
         else
         {
-            video.stop();
+            video->stop();
+            if (server.wantsFrame())
+            {
+                server.showPlaceholder(hostOffMessage);
+            }
         }
 
-        if (video.needsResize())
+        // Resizes are staged for the server thread to swap the framebuffer,
+        // settings are applied between frames with the server thread paused;
+        // otherwise the server thread handles client messages meanwhile
+        if (video->needsResize())
         {
-            waitServer(true);
-            video.resize();
+            video->resize();
             server.resize();
-            setVideoDone();
         }
-        else
+
+        server.updateSignalStats();
+        server.getStats().set(
+            Stats::Gauge::fps,
+            pacer.getAchievedRate(std::chrono::steady_clock::now()));
+
+        if (settings.take(values))
         {
+            waitServer(true);
+            applySettings(values);
             setVideoDone();
-            waitServer();
         }
     }
 
     run.join();
 }
 
+void Manager::applySettings(const Settings::Values& values)
+{
+    if (values.frameRate != video->getFrameRate())
+    {
+        video->setFrameRate(values.frameRate);
+        rate.setFullRate(values.frameRate);
+        pacer.setFrameRate(values.frameRate);
+    }
+    if (values.subsampling != video->getSubsampling())
+    {
+        video->setSubsampling(values.subsampling);
+    }
+    if (values.quality != video->getQuality())
+    {
+        video->setQuality(values.quality);
+    }
+
+    server.applySettings(values);
+
+    lg2::info("Applied settings: {RATE} fps, subsampling {SUB}, quality "
+              "{QUALITY}, CRC {CRC}, timeout {TIMEOUT} s, bandwidth {BW} "
+              "kbit/s, client bandwidth {CLIENT_BW} kbit/s",
+              "RATE", values.frameRate, "SUB", values.subsampling, "QUALITY",
+              values.quality, "CRC", values.calcFrameCRC, "TIMEOUT",
+              values.timeoutSeconds, "BW", values.bandwidth, "CLIENT_BW",
+              values.clientBandwidth);
+}
+
+void Manager::pace(bool burst)
+{
+    Stats& stats = server.getStats();
+    uint64_t skipped = pacer.getSkipped();
+
+    // Frames of a burst after client input are captured as they come
+    auto late = burst ? pacer.waitUntil(rate.getNextBurstCapture())
+                      : pacer.wait();
+
+    stats.record(Stats::Stage::pacing, late);
+    stats.increment(Stats::Counter::lateFrames, pacer.getSkipped() - skipped);
+}
+
 void Manager::serverThread(Manager* manager)
 {
     while (manager->continueExecuting)
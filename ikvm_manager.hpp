@@ -1,11 +1,16 @@
 #pragma once
 
 #include "ikvm_args.hpp"
+#include "ikvm_capture_rate.hpp"
+#include "ikvm_frame_pacer.hpp"
 #include "ikvm_input.hpp"
+#include "ikvm_frame_source.hpp"
 #include "ikvm_server.hpp"
-#include "ikvm_video.hpp"
+#include "ikvm_settings.hpp"
 
+#include <atomic>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
 
 namespace ikvm
@@ -40,7 +45,39 @@ class Manager
      * @param[in] manager - Pointer to the Manager object
      */
     static void serverThread(Manager* manager);
+    /*
+     * @brief Creates the frame source selected on the command line
+     *
+     * @param[in] args  - Reference to Args object
+     * @param[in] input - Reference to the Input object
+     *
+     * @return The replay source if a recording is given, else the V4L2
+     *         video device
+     */
+    static std::unique_ptr<FrameSource> makeFrameSource(const Args& args,
+                                                        Input& input);
+    /*
+     * @brief Creates the HID sink selected on the command line
+     *
+     * @param[in] args - Reference to Args object
+     *
+     * @return The local sink if a record path is given, else the USB gadget
+     */
+    static std::unique_ptr<HidSink> makeHidSink(const Args& args);
 
+    /*
+     * @brief Applies changed settings to the frame source and the server
+     *
+     * @param[in] values - New values of the settings
+     */
+    void applySettings(const Settings::Values& values);
+    /*
+     * @brief Waits for the next frame deadline and records how late it was
+     *
+     * @param[in] burst - Whether the next frame is part of a burst after
+     *                    client input
+     */
+    void pace(bool burst);
     /* @brief Notifies thread waiters that RFB operations are complete */
     void setServerDone();
     /* @brief Notifies thread waiters that video operations are complete */
@@ -71,16 +108,30 @@ class Manager
     bool videoDone;
     /* @brief Boolean indicating the server thread is blocked in waitVideo() */
     bool videoPaused;
+    /* @brief Boolean indicating the host is powered, set from D-Bus */
+    std::atomic<bool> hostPowered;
     /* @brief Input object */
     Input input;
-    /* @brief Video object */
-    Video video;
+    /* @brief Frame source object */
+    std::unique_ptr<FrameSource> video;
+    /* @brief Settings changeable at runtime, outliving the server */
+    Settings settings;
     /* @brief RFB server object */
     Server server;
+    /* @brief Capture rate adapting to the screen content */
+    CaptureRate rate;
+    /* @brief Deadlines of the captures at the frame rate */
+    FramePacer pacer;
+    /* @brief Input event count last seen by the capture */
+    uint64_t inputEvents;
     /* @brief Condition variable to enable waiting for thread completion */
     std::condition_variable sync;
     /* @brief Mutex for waiting on condition variable safely */
     std::mutex lock;
+    /* @brief Message shown to the clients while the host is off */
+    static constexpr const char* hostOffMessage = "Host is powered off";
+    /* @brief Message shown to the clients while the video signal is lost */
+    static constexpr const char* noSignalMessage = "No signal";
 };
 
 } // namespace ikvm
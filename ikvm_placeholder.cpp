@@ -0,0 +1,102 @@
+#include "ikvm_placeholder.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+namespace ikvm
+{
+
+// Upper case letters of the 5x7 font, one byte per row
+static constexpr std::array<std::array<uint8_t, Placeholder::glyphHeight>, 26>
+    letters = {{
+        {0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11},
+        {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E},
+        {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E},
+        {0x1E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x1E},
+        {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F},
+        {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10},
+        {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F},
+        {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11},
+        {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E},
+        {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C},
+        {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11},
+        {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F},
+        {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11},
+        {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11},
+        {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E},
+        {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10},
+        {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D},
+        {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11},
+        {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E},
+        {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04},
+        {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E},
+        {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04},
+        {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A},
+        {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11},
+        {0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04},
+        {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F},
+    }};
+
+static constexpr std::array<uint8_t, Placeholder::glyphHeight> blank{};
+
+const std::array<uint8_t, Placeholder::glyphHeight>& Placeholder::glyph(char c)
+{
+    c = (char)toupper((unsigned char)c);
+
+    return (c >= 'A' && c <= 'Z') ? letters[c - 'A'] : blank;
+}
+
+uint32_t Placeholder::pixel(const rfbPixelFormat& format, uint8_t r,
+                            uint8_t g, uint8_t b)
+{
+    return (uint32_t)(r * format.redMax / 255) << format.redShift |
+           (uint32_t)(g * format.greenMax / 255) << format.greenShift |
+           (uint32_t)(b * format.blueMax / 255) << format.blueShift;
+}
+
+void Placeholder::draw(char* data, int width, int height,
+                       const rfbPixelFormat& format, const std::string& text)
+{
+    int bytesPerPixel = format.bitsPerPixel / 8;
+    uint32_t background = pixel(format, 0x20, 0x20, 0x20);
+    uint32_t foreground = pixel(format, 0xC0, 0xC0, 0xC0);
+    // Glyphs are a column apart and the message spans about half the width
+    int advance = glyphWidth + 1;
+    int length = std::max((int)text.size(), 1);
+    int scale = std::clamp(width / 2 / (length * advance), 1,
+                           std::max(height / (glyphHeight * 4), 1));
+    int left = (width - (length * advance - 1) * scale) / 2;
+    int top = (height - glyphHeight * scale) / 2;
+
+    for (int y = 0; y < height; ++y)
+    {
+        int row = y >= top ? (y - top) / scale : glyphHeight;
+
+        for (int x = 0; x < width; ++x)
+        {
+            uint32_t value = background;
+            int column = x >= left ? (x - left) / scale : -1;
+
+            if (row < glyphHeight && column >= 0 &&
+                column < (int)text.size() * advance &&
+                column % advance < glyphWidth &&
+                glyph(text[column / advance])[row] &
+                    (0x10 >> column % advance))
+            {
+                value = foreground;
+            }
+
+            char* p = data + ((size_t)y * width + x) * bytesPerPixel;
+
+            for (int i = 0; i < bytesPerPixel; ++i)
+            {
+                int shift = format.bigEndian ? (bytesPerPixel - 1 - i) * 8
+                                             : i * 8;
+
+                p[i] = (char)(value >> shift);
+            }
+        }
+    }
+}
+
+} // namespace ikvm
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <rfb/rfbproto.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace ikvm
+{
+
+/*
+ * @class Placeholder
+ * @brief Renders the frame shown to clients in place of the video, with a
+ *        message in a built-in 5x7 font
+ */
+class Placeholder
+{
+  public:
+    Placeholder() = delete;
+
+    /*
+     * @brief Draws a centered message on a dark background
+     *
+     * @param[out] data   - Pointer to the framebuffer
+     * @param[in]  width  - Width of the framebuffer in pixels
+     * @param[in]  height - Height of the framebuffer in pixels
+     * @param[in]  format - Pixel format of the framebuffer
+     * @param[in]  text   - Message, letters are drawn in upper case
+     */
+    static void draw(char* data, int width, int height,
+                     const rfbPixelFormat& format, const std::string& text);
+
+    /*
+     * @brief Converts a colour to a pixel of the framebuffer format
+     *
+     * @param[in] format - Pixel format of the framebuffer
+     * @param[in] r      - Red component, 0 to 255
+     * @param[in] g      - Green component, 0 to 255
+     * @param[in] b      - Blue component, 0 to 255
+     *
+     * @return Value of the pixel
+     */
+    static uint32_t pixel(const rfbPixelFormat& format, uint8_t r, uint8_t g,
+                          uint8_t b);
+
+    /* @brief Width of a glyph in font pixels */
+    static constexpr int glyphWidth = 5;
+    /* @brief Height of a glyph in font pixels */
+    static constexpr int glyphHeight = 7;
+
+  private:
+    /*
+     * @brief Gets the rows of a glyph, most significant bit on the left
+     *
+     * @param[in] c - Character to draw
+     *
+     * @return Reference to the rows, blank for characters without a glyph
+     */
+    static const std::array<uint8_t, glyphHeight>& glyph(char c);
+};
+
+} // namespace ikvm
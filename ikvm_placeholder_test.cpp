@@ -0,0 +1,104 @@
+#include "ikvm_placeholder.hpp"
+
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace ikvm
+{
+
+// 32 bits per pixel, as set up by the server for JPEG and RGB24 frames
+static rfbPixelFormat rgb32()
+{
+    rfbPixelFormat format;
+
+    memset(&format, 0, sizeof(format));
+    format.bitsPerPixel = 32;
+    format.depth = 24;
+    format.trueColour = 1;
+    format.redMax = 255;
+    format.greenMax = 255;
+    format.blueMax = 255;
+    format.redShift = 16;
+    format.greenShift = 8;
+    format.blueShift = 0;
+
+    return format;
+}
+
+TEST(PlaceholderTest, Pixel)
+{
+    rfbPixelFormat format = rgb32();
+
+    EXPECT_EQ(Placeholder::pixel(format, 0x12, 0x34, 0x56), 0x123456u);
+
+    format.bitsPerPixel = 16;
+    format.redMax = 31;
+    format.greenMax = 63;
+    format.blueMax = 31;
+    format.redShift = 11;
+    format.greenShift = 5;
+    format.blueShift = 0;
+
+    EXPECT_EQ(Placeholder::pixel(format, 0xFF, 0xFF, 0xFF), 0xFFFFu);
+    EXPECT_EQ(Placeholder::pixel(format, 0xFF, 0, 0), 0xF800u);
+}
+
+TEST(PlaceholderTest, DrawsCenteredText)
+{
+    constexpr int width = 640;
+    constexpr int height = 480;
+    rfbPixelFormat format = rgb32();
+    std::vector<uint32_t> fb(width * height);
+    std::vector<uint32_t> lower(width * height);
+    uint32_t background = Placeholder::pixel(format, 0x20, 0x20, 0x20);
+    uint32_t foreground = Placeholder::pixel(format, 0xC0, 0xC0, 0xC0);
+    size_t lit = 0;
+    int minX = width;
+    int maxX = 0;
+
+    Placeholder::draw((char*)fb.data(), width, height, format, "HH");
+
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            uint32_t p = fb[y * width + x];
+
+            ASSERT_TRUE(p == background || p == foreground);
+            if (p == foreground)
+            {
+                lit++;
+                minX = std::min(minX, x);
+                maxX = std::max(maxX, x);
+            }
+        }
+    }
+
+    // H has 17 pixels set, scaled 17 times each way
+    EXPECT_EQ(lit, 2u * 17 * 17 * 17);
+    EXPECT_NEAR(minX, width - 1 - maxX, 1);
+
+    Placeholder::draw((char*)lower.data(), width, height, format, "hh");
+    EXPECT_EQ(fb, lower);
+}
+
+TEST(PlaceholderTest, LongTextFitsSmallFrame)
+{
+    constexpr int width = 64;
+    constexpr int height = 48;
+    rfbPixelFormat format = rgb32();
+    std::vector<uint32_t> fb(width * height, 0xDEADBEEF);
+
+    // At the smallest scale the text is clipped, the whole frame is drawn
+    Placeholder::draw((char*)fb.data(), width, height, format,
+                      "Host is powered off");
+
+    for (uint32_t p : fb)
+    {
+        EXPECT_NE(p, 0xDEADBEEFu);
+    }
+}
+
+} // namespace ikvm
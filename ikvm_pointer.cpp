@@ -0,0 +1,74 @@
+#include "ikvm_pointer.hpp"
+
+#include <cstring>
+
+namespace ikvm
+{
+PointerCoalescer::PointerCoalescer(std::chrono::microseconds i) :
+    haveWritten(false), interval(i), writtenCount(0), droppedCount(0),
+    lastReport{0}
+{}
+
+bool PointerCoalescer::submit(const uint8_t* r)
+{
+    Entry entry;
+    const uint8_t* previous =
+        queue.empty() ? lastReport : queue.back().report.data();
+
+    memcpy(entry.report.data(), r, reportLength);
+
+    // Wheel clicks are relative, so every one of them has to reach the host
+    entry.transition = (queue.empty() && !haveWritten) || r[wheelIndex] ||
+                       r[buttonIndex] != previous[buttonIndex] ||
+                       r[wheelIndex] != previous[wheelIndex];
+
+    if (!entry.transition && !queue.empty() && !queue.back().transition)
+    {
+        queue.back() = entry;
+        droppedCount++;
+        return false;
+    }
+
+    if (queue.size() == maxQueued)
+    {
+        queue.pop_front();
+    }
+
+    queue.push_back(entry);
+
+    return entry.transition;
+}
+
+bool PointerCoalescer::isDue(Clock::time_point now) const
+{
+    return !queue.empty() && (queue.front().transition || !haveWritten ||
+                              now - lastWrite >= interval);
+}
+
+std::chrono::microseconds PointerCoalescer::timeUntilDue(
+    Clock::time_point now) const
+{
+    if (queue.empty())
+    {
+        return std::chrono::microseconds::max();
+    }
+
+    if (isDue(now))
+    {
+        return std::chrono::microseconds(0);
+    }
+
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        lastWrite + interval - now);
+}
+
+void PointerCoalescer::written(Clock::time_point now)
+{
+    memcpy(lastReport, queue.front().report.data(), reportLength);
+    queue.pop_front();
+    haveWritten = true;
+    lastWrite = now;
+    writtenCount++;
+}
+
+} // namespace ikvm
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+namespace ikvm
+{
+/*
+ * @class PointerCoalescer
+ * @brief Merges absolute pointer motion reports so that only the latest
+ *        position is written to the USB mouse device at the HID polling
+ *        interval. Button transitions and wheel clicks are never merged;
+ *        they stay queued, in order, until they are written.
+ */
+class PointerCoalescer
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /* @brief Length of the absolute pointer report */
+    static constexpr size_t reportLength = 6;
+    /*
+     * @brief Most reports kept while the device can't be written; the
+     *        oldest are discarded beyond this, as they are stale by then
+     */
+    static constexpr size_t maxQueued = 32;
+
+    /*
+     * @brief Constructs PointerCoalescer object
+     *
+     * @param[in] i - Minimum interval between two motion reports
+     */
+    explicit PointerCoalescer(std::chrono::microseconds i);
+    ~PointerCoalescer() = default;
+    PointerCoalescer(const PointerCoalescer&) = default;
+    PointerCoalescer& operator=(const PointerCoalescer&) = default;
+    PointerCoalescer(PointerCoalescer&&) = default;
+    PointerCoalescer& operator=(PointerCoalescer&&) = default;
+
+    /*
+     * @brief Queues a pointer report. A motion report replaces the last
+     *        queued report if that is motion too.
+     *
+     * @param[in] r - Pointer report of reportLength bytes
+     *
+     * @return True if the report changes button or wheel state and must be
+     *         written immediately
+     */
+    bool submit(const uint8_t* r);
+    /*
+     * @brief Indicates whether the queued report should be written
+     *
+     * @param[in] now - Current time
+     *
+     * @return True if a report is queued and it is a button or wheel
+     *         change or the polling interval elapsed
+     */
+    bool isDue(Clock::time_point now) const;
+    /*
+     * @brief Gets the time remaining until the queued report is due
+     *
+     * @param[in] now - Current time
+     *
+     * @return Zero if the report is due, the maximum duration if nothing
+     *         is queued
+     */
+    std::chrono::microseconds timeUntilDue(Clock::time_point now) const;
+    /*
+     * @brief Records that the oldest queued report has been written to the
+     *        device
+     *
+     * @param[in] now - Time at which the report was written
+     */
+    void written(Clock::time_point now);
+
+    /*
+     * @brief Gets the oldest queued report
+     *
+     * @return Pointer to the report data
+     */
+    inline const uint8_t* getReport() const
+    {
+        return queue.front().report.data();
+    }
+    /*
+     * @brief Gets whether a report is waiting to be written
+     *
+     * @return Boolean indicating if a report is queued
+     */
+    inline bool isPending() const
+    {
+        return !queue.empty();
+    }
+    /*
+     * @brief Gets the number of reports written to the device
+     *
+     * @return Number of written reports
+     */
+    inline uint64_t getWrittenCount() const
+    {
+        return writtenCount;
+    }
+    /*
+     * @brief Gets the number of motion reports superseded before writing
+     *
+     * @return Number of dropped reports
+     */
+    inline uint64_t getDroppedCount() const
+    {
+        return droppedCount;
+    }
+
+  private:
+    /* @brief Queued report */
+    struct Entry
+    {
+        /* @brief Report data */
+        std::array<uint8_t, reportLength> report;
+        /* @brief Boolean to indicate a button or wheel change */
+        bool transition;
+    };
+
+    /* @brief Index of the button bits in the report */
+    static constexpr size_t buttonIndex = 0;
+    /* @brief Index of the wheel value in the report */
+    static constexpr size_t wheelIndex = 5;
+
+    /* @brief Boolean to indicate that the previous report has been written */
+    bool haveWritten;
+    /* @brief Minimum interval between two motion reports */
+    std::chrono::microseconds interval;
+    /* @brief Time at which the last report was written */
+    Clock::time_point lastWrite;
+    /* @brief Number of reports written to the device */
+    uint64_t writtenCount;
+    /* @brief Number of motion reports superseded before writing */
+    uint64_t droppedCount;
+    /* @brief Reports waiting to be written, oldest first */
+    std::deque<Entry> queue;
+    /* @brief Last report written to the device */
+    uint8_t lastReport[reportLength];
+};
+
+} // namespace ikvm
@@ -0,0 +1,247 @@
+#include "ikvm_pointer.hpp"
+
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace ikvm
+{
+
+class PointerCoalescerTest : public ::testing::Test
+{
+  protected:
+    using Clock = PointerCoalescer::Clock;
+
+    // One RFB PointerEvent as seen by the server
+    struct TraceEvent
+    {
+        unsigned int usec;
+        uint8_t buttons;
+        uint8_t wheel;
+        uint16_t x;
+        uint16_t y;
+    };
+
+    static constexpr std::chrono::microseconds interval{8000};
+
+    // Helper to build an absolute pointer report
+    static void makeReport(const TraceEvent& e, uint8_t* report)
+    {
+        report[0] = e.buttons;
+        memcpy(&report[1], &e.x, sizeof(e.x));
+        memcpy(&report[3], &e.y, sizeof(e.y));
+        report[5] = e.wheel;
+    }
+
+    // Drag as emitted by noVNC: press, ~500 motion events per second for
+    // one second, release, then a couple of wheel clicks
+    static std::vector<TraceEvent> dragTrace()
+    {
+        std::vector<TraceEvent> trace;
+        unsigned int t = 0;
+
+        trace.push_back({t, 0, 0, 1000, 1000});
+        t += 2000;
+        trace.push_back({t, 1, 0, 1000, 1000});
+        for (uint16_t i = 1; i <= 500; ++i)
+        {
+            t += 2000;
+            trace.push_back({t, 1, 0, (uint16_t)(1000 + i * 20),
+                             (uint16_t)(1000 + i * 10)});
+        }
+        t += 2000;
+        trace.push_back({t, 0, 0, 11000, 6000});
+        t += 50000;
+        trace.push_back({t, 0, 1, 11000, 6000});
+        t += 1000;
+        trace.push_back({t, 0, 0, 11000, 6000});
+        t += 1000;
+        trace.push_back({t, 0, 1, 11000, 6000});
+        t += 1000;
+        trace.push_back({t, 0, 0, 11000, 6000});
+        t += 1000;
+        trace.push_back({t, 0, 0xff, 11000, 6000});
+        t += 1000;
+        trace.push_back({t, 0, 0, 11000, 6000});
+        for (uint16_t i = 1; i <= 40; ++i)
+        {
+            t += 1000;
+            trace.push_back({t, 0, 0, (uint16_t)(11000 - i * 50), 6000});
+        }
+
+        return trace;
+    }
+};
+
+TEST_F(PointerCoalescerTest, FirstReportIsWrittenImmediately)
+{
+    PointerCoalescer coalescer(interval);
+    uint8_t report[PointerCoalescer::reportLength] = {0, 1, 2, 3, 4, 0};
+
+    EXPECT_TRUE(coalescer.submit(report));
+    EXPECT_TRUE(coalescer.isPending());
+}
+
+TEST_F(PointerCoalescerTest, MotionWaitsForPollingInterval)
+{
+    PointerCoalescer coalescer(interval);
+    uint8_t report[PointerCoalescer::reportLength] = {0};
+    auto t0 = Clock::now();
+
+    EXPECT_FALSE(coalescer.isPending());
+    EXPECT_EQ(coalescer.timeUntilDue(t0), std::chrono::microseconds::max());
+
+    coalescer.submit(report);
+    coalescer.written(t0);
+
+    report[1] = 10;
+    EXPECT_FALSE(coalescer.submit(report));
+    EXPECT_FALSE(coalescer.isDue(t0 + std::chrono::microseconds(1000)));
+    EXPECT_EQ(coalescer.timeUntilDue(t0 + std::chrono::microseconds(1000)),
+              std::chrono::microseconds(7000));
+    EXPECT_TRUE(coalescer.isDue(t0 + interval));
+    EXPECT_EQ(coalescer.timeUntilDue(t0 + interval),
+              std::chrono::microseconds(0));
+}
+
+TEST_F(PointerCoalescerTest, ButtonAndWheelAreNeverMerged)
+{
+    PointerCoalescer coalescer(interval);
+    uint8_t report[PointerCoalescer::reportLength] = {0};
+    auto t0 = Clock::now();
+
+    coalescer.submit(report);
+    coalescer.written(t0);
+
+    report[0] = 1;
+    EXPECT_TRUE(coalescer.submit(report));
+    coalescer.written(t0);
+
+    report[5] = 1;
+    EXPECT_TRUE(coalescer.submit(report));
+    coalescer.written(t0);
+
+    // Consecutive clicks in the same direction are still written
+    EXPECT_TRUE(coalescer.submit(report));
+    coalescer.written(t0);
+
+    report[5] = 0;
+    EXPECT_TRUE(coalescer.submit(report));
+    coalescer.written(t0);
+
+    EXPECT_EQ(coalescer.getWrittenCount(), 5u);
+    EXPECT_EQ(coalescer.getDroppedCount(), 0u);
+}
+
+TEST_F(PointerCoalescerTest, UnwrittenTransitionsAreKept)
+{
+    PointerCoalescer coalescer(interval);
+    uint8_t report[PointerCoalescer::reportLength] = {0};
+    auto t0 = Clock::now();
+
+    coalescer.submit(report);
+    coalescer.written(t0);
+
+    // The device is busy, so none of these are written as they come in
+    report[0] = 1;
+    EXPECT_TRUE(coalescer.submit(report));
+    report[0] = 0;
+    EXPECT_TRUE(coalescer.submit(report));
+    report[1] = 10;
+    EXPECT_FALSE(coalescer.submit(report));
+    report[1] = 20;
+    EXPECT_FALSE(coalescer.submit(report));
+    report[5] = 1;
+    EXPECT_TRUE(coalescer.submit(report));
+
+    // Only the first motion report was superseded
+    EXPECT_EQ(coalescer.getDroppedCount(), 1u);
+
+    ASSERT_TRUE(coalescer.isDue(t0));
+    EXPECT_EQ(coalescer.getReport()[0], 1);
+    coalescer.written(t0);
+
+    ASSERT_TRUE(coalescer.isDue(t0));
+    EXPECT_EQ(coalescer.getReport()[0], 0);
+    coalescer.written(t0);
+
+    // Motion still waits for the polling interval
+    EXPECT_FALSE(coalescer.isDue(t0));
+    ASSERT_TRUE(coalescer.isDue(t0 + interval));
+    EXPECT_EQ(coalescer.getReport()[1], 20);
+    EXPECT_EQ(coalescer.getReport()[5], 0);
+    coalescer.written(t0 + interval);
+
+    ASSERT_TRUE(coalescer.isDue(t0 + interval));
+    EXPECT_EQ(coalescer.getReport()[5], 1);
+    coalescer.written(t0 + interval);
+
+    EXPECT_FALSE(coalescer.isPending());
+    EXPECT_EQ(coalescer.getWrittenCount(), 5u);
+}
+
+TEST_F(PointerCoalescerTest, ReplayDragTrace)
+{
+    PointerCoalescer coalescer(interval);
+    std::vector<TraceEvent> trace = dragTrace();
+    uint8_t report[PointerCoalescer::reportLength];
+    uint8_t lastWritten[PointerCoalescer::reportLength] = {0};
+    unsigned int immediate = 0;
+    auto t0 = Clock::now();
+    auto now = t0;
+
+    for (const auto& e : trace)
+    {
+        now = t0 + std::chrono::microseconds(e.usec);
+
+        // The server loop wakes up to flush due reports between events
+        if (coalescer.isDue(now))
+        {
+            memcpy(lastWritten, coalescer.getReport(), sizeof(lastWritten));
+            coalescer.written(now);
+        }
+
+        makeReport(e, report);
+        if (coalescer.submit(report))
+        {
+            immediate++;
+            memcpy(lastWritten, coalescer.getReport(), sizeof(lastWritten));
+            coalescer.written(now);
+        }
+        else if (coalescer.isDue(now))
+        {
+            memcpy(lastWritten, coalescer.getReport(), sizeof(lastWritten));
+            coalescer.written(now);
+        }
+    }
+
+    now += interval;
+    ASSERT_TRUE(coalescer.isDue(now));
+    memcpy(lastWritten, coalescer.getReport(), sizeof(lastWritten));
+    coalescer.written(now);
+
+    uint64_t written = coalescer.getWrittenCount();
+    uint64_t dropped = coalescer.getDroppedCount();
+
+    // Every event is either written or superseded by a newer one
+    EXPECT_EQ(written + dropped, trace.size());
+
+    // First report, press, release and three wheel clicks with their
+    // releases are all written as they happen
+    EXPECT_EQ(immediate, 9u);
+
+    // Motion is paced to one report per polling interval
+    auto duration = std::chrono::microseconds(trace.back().usec) + interval;
+    EXPECT_LE(written, (uint64_t)(duration / interval) + immediate);
+    EXPECT_GT(dropped, trace.size() / 2);
+
+    // The final position always reaches the host
+    makeReport(trace.back(), report);
+    EXPECT_EQ(memcmp(lastWritten, report, sizeof(report)), 0);
+
+    ::testing::Test::RecordProperty("written", (int)written);
+    ::testing::Test::RecordProperty("dropped", (int)dropped);
+}
+
+} // namespace ikvm
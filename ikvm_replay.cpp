@@ -0,0 +1,284 @@
+#include "ikvm_replay.hpp"
+
+#include "ikvm_flight_recorder.hpp"
+
+#include <errno.h>
+#include <linux/videodev2.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include <phosphor-logging/elog-errors.hpp>
+#include <phosphor-logging/elog.hpp>
+#include <phosphor-logging/lg2.hpp>
+#include <xyz/openbmc_project/Common/File/error.hpp>
+
+namespace fs = std::filesystem;
+
+namespace ikvm
+{
+
+using namespace phosphor::logging;
+using namespace sdbusplus::xyz::openbmc_project::Common::File::Error;
+
+Replay::Replay(const std::string& p, int fr) :
+    FrameSource(fr, 0), started(false), current(-1), repeatLeft(0),
+    frameCount(0), path(p)
+{}
+
+char* Replay::getData()
+{
+    // Hold back frames of a new resolution until the server has resized
+    if (!started || current < 0 || frames[current].width != width ||
+        frames[current].height != height)
+    {
+        return nullptr;
+    }
+
+    return frames[current].data.data();
+}
+
+void Replay::getFrame()
+{
+    if (!started)
+    {
+        return;
+    }
+
+    // The caller paces the frames, as it does those of the video device
+    dequeueTime = std::chrono::steady_clock::now();
+    captureTime = dequeueTime;
+
+    if (current >= 0 && repeatLeft)
+    {
+        repeatLeft--;
+    }
+    else
+    {
+        current = (current + 1) % (int)frames.size();
+        repeatLeft = frames[current].repeat - 1;
+    }
+
+    frameCount++;
+    FlightRecorder::record(FlightRecorder::Event::frameDequeue, current,
+                           frames[current].data.size());
+}
+
+void Replay::probePixelFormat()
+{
+    if (frames.empty())
+    {
+        load();
+    }
+
+    if (pixelformat == V4L2_PIX_FMT_RGB565 ||
+        pixelformat == V4L2_PIX_FMT_HEXTILE)
+    {
+        bitsPerSample = 5;
+        bytesPerPixel = 2;
+        samplesPerPixel = 1;
+    }
+
+    width = frames.front().width;
+    height = frames.front().height;
+}
+
+bool Replay::needsResize()
+{
+    if (!started || current < 0)
+    {
+        return false;
+    }
+
+    if (frames[current].width != width || frames[current].height != height)
+    {
+        width = frames[current].width;
+        height = frames[current].height;
+        return true;
+    }
+
+    return false;
+}
+
+void Replay::resize() {}
+
+void Replay::start()
+{
+    if (started)
+    {
+        return;
+    }
+
+    if (frames.empty())
+    {
+        load();
+    }
+
+    started = true;
+    current = -1;
+    repeatLeft = 0;
+    frameCount = 0;
+}
+
+void Replay::stop()
+{
+    started = false;
+    current = -1;
+}
+
+size_t Replay::getFrameSize() const
+{
+    return (current >= 0) ? frames[current].data.size() : 0;
+}
+
+void Replay::load()
+{
+    fs::path dir(path);
+    fs::path manifestPath = dir / manifestName;
+    std::ifstream manifest(manifestPath);
+    std::string line;
+    unsigned int lineNumber = 0;
+
+    if (!manifest)
+    {
+        lg2::error("Failed to open replay manifest {PATH}", "PATH",
+                   manifestPath.string());
+        elog<Open>(xyz::openbmc_project::Common::File::Open::ERRNO(ENOENT),
+                   xyz::openbmc_project::Common::File::Open::PATH(
+                       manifestPath.c_str()));
+    }
+
+    while (std::getline(manifest, line))
+    {
+        std::istringstream fields(line);
+        std::string directive;
+        bool valid = true;
+
+        lineNumber++;
+
+        if (!(fields >> directive) || directive[0] == '#')
+        {
+            continue;
+        }
+
+        if (directive == "format")
+        {
+            std::string format;
+
+            fields >> format;
+            if (format == "jpeg")
+            {
+                pixelformat = V4L2_PIX_FMT_JPEG;
+            }
+            else if (format == "rgb24")
+            {
+                pixelformat = V4L2_PIX_FMT_RGB24;
+            }
+            else if (format == "rgb565")
+            {
+                pixelformat = V4L2_PIX_FMT_RGB565;
+            }
+            else if (format == "hextile")
+            {
+                pixelformat = V4L2_PIX_FMT_HEXTILE;
+            }
+            else
+            {
+                valid = false;
+            }
+        }
+        else if (directive == "rate")
+        {
+            int rate = 0;
+
+            valid = (fields >> rate) && rate > 0;
+            if (valid)
+            {
+                frameRate = rate;
+            }
+        }
+        else if (directive == "frame")
+        {
+            std::string name;
+            Frame frame{{}, 0, 0, 1};
+
+            valid = (fields >> name >> frame.width >> frame.height) &&
+                    frame.width && frame.height;
+            if (valid && !(fields >> frame.repeat))
+            {
+                frame.repeat = 1;
+            }
+
+            std::ifstream file(dir / name, std::ios::binary);
+
+            if (valid && !file)
+            {
+                lg2::error("Failed to open replay frame {PATH}", "PATH",
+                           (dir / name).string());
+                elog<Open>(
+                    xyz::openbmc_project::Common::File::Open::ERRNO(ENOENT),
+                    xyz::openbmc_project::Common::File::Open::PATH(
+                        (dir / name).c_str()));
+            }
+
+            if (valid)
+            {
+                frame.data.assign(std::istreambuf_iterator<char>(file),
+                                  std::istreambuf_iterator<char>());
+                frame.repeat = std::max(frame.repeat, 1u);
+                frames.push_back(std::move(frame));
+            }
+        }
+        else
+        {
+            valid = false;
+        }
+
+        if (!valid)
+        {
+            lg2::error("Invalid replay manifest line {LINE}: {TEXT}", "LINE",
+                       lineNumber, "TEXT", line);
+            elog<Open>(xyz::openbmc_project::Common::File::Open::ERRNO(EINVAL),
+                       xyz::openbmc_project::Common::File::Open::PATH(
+                           manifestPath.c_str()));
+        }
+    }
+
+    if (!pixelformat || frames.empty())
+    {
+        lg2::error("Replay manifest {PATH} lacks a format or frames", "PATH",
+                   manifestPath.string());
+        elog<Open>(xyz::openbmc_project::Common::File::Open::ERRNO(EINVAL),
+                   xyz::openbmc_project::Common::File::Open::PATH(
+                       manifestPath.c_str()));
+    }
+
+    // Uncompressed frames are copied to the framebuffer as they are
+    if (pixelformat == V4L2_PIX_FMT_RGB24 ||
+        pixelformat == V4L2_PIX_FMT_RGB565)
+    {
+        size_t pixelSize = (pixelformat == V4L2_PIX_FMT_RGB565) ? 2 : 4;
+
+        for (auto& frame : frames)
+        {
+            size_t size = frame.width * frame.height * pixelSize;
+
+            if (frame.data.size() != size)
+            {
+                lg2::warning("Replay frame of {SIZE} bytes doesn't match "
+                             "{WIDTH}x{HEIGHT}",
+                             "SIZE", frame.data.size(), "WIDTH", frame.width,
+                             "HEIGHT", frame.height);
+                frame.data.resize(size, 0);
+            }
+        }
+    }
+
+    lg2::info("Replaying {COUNT} frames from {PATH} at {RATE} fps", "COUNT",
+              frames.size(), "PATH", path, "RATE", frameRate);
+}
+
+} // namespace ikvm
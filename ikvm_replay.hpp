@@ -0,0 +1,116 @@
+#pragma once
+
+#include "ikvm_frame_source.hpp"
+
+#include <string>
+#include <vector>
+
+namespace ikvm
+{
+
+/*
+ * @class Replay
+ * @brief Frame source that plays back recorded frames from a directory in
+ *        place of the V4L2 video device, for testing and benchmarking
+ *        without a video capture engine
+ *
+ * The directory holds the frame files and a text file named "manifest":
+ *
+ *   format jpeg|rgb24|rgb565|hextile
+ *   rate <frames per second>
+ *   frame <file> <width> <height> [<number of times to repeat the frame>]
+ *
+ * Frames are played in order and looped; a frame with a different width or
+ * height than the previous one triggers a resize as a resolution change of
+ * the host would.
+ */
+class Replay : public FrameSource
+{
+  public:
+    /*
+     * @brief Constructs Replay object
+     *
+     * @param[in] p  - Path to the directory of recorded frames
+     * @param[in] fr - Frame rate to play at unless the manifest sets one
+     */
+    Replay(const std::string& p, int fr = 30);
+    ~Replay() override = default;
+    Replay(const Replay&) = default;
+    Replay& operator=(const Replay&) = delete;
+    Replay(Replay&&) = default;
+    Replay& operator=(Replay&&) = delete;
+
+    /*
+     * @brief Gets the current frame data
+     *
+     * @return Pointer to the frame data, or nullptr if the frame doesn't
+     *         match the current resolution yet
+     */
+    char* getData() override;
+    /* @brief Advances to the next frame, which the caller paces */
+    void getFrame() override;
+    /* @brief Loads the manifest and frames and sets the pixel format */
+    void probePixelFormat() override;
+    /*
+     * @brief Gets whether or not the current frame changes the resolution
+     *
+     * @return Boolean indicating if the frame needs to be resized
+     */
+    bool needsResize() override;
+    /* @brief Does nothing, as all frames are loaded up front */
+    void resize() override;
+    /* @brief Starts playback from the first frame */
+    void start() override;
+    /* @brief Stops playback */
+    void stop() override;
+    /*
+     * @brief Gets the size of the current frame data
+     *
+     * @return Value of the size of the frame data in bytes
+     */
+    size_t getFrameSize() const override;
+
+    /*
+     * @brief Gets the number of frames played since playback started
+     *
+     * @return Number of frames
+     */
+    inline uint64_t getFrameCount() const
+    {
+        return frameCount;
+    }
+
+    /* @brief Name of the manifest file in the recording directory */
+    static constexpr const char* manifestName = "manifest";
+
+  private:
+    /*
+     * @struct Frame
+     * @brief Recorded frame and its resolution
+     */
+    struct Frame
+    {
+        std::vector<char> data;
+        size_t width;
+        size_t height;
+        unsigned int repeat;
+    };
+
+    /* @brief Parses the manifest and reads the frame files */
+    void load();
+
+    /* @brief Boolean to indicate whether playback is running */
+    bool started;
+    /* @brief Index of the current frame, -1 before the first frame */
+    int current;
+    /* @brief Number of times the current frame is still to be repeated */
+    unsigned int repeatLeft;
+    /* @brief Number of frames played since playback started */
+    uint64_t frameCount;
+    /* @brief Path to the directory of recorded frames */
+    const std::string path;
+    /* @brief Recorded frames in playback order */
+    std::vector<Frame> frames;
+};
+
+} // namespace ikvm
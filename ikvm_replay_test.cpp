@@ -0,0 +1,192 @@
+#include "ikvm_replay.hpp"
+
+#include <linux/videodev2.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+
+namespace ikvm
+{
+
+class ReplayTest : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        dir = fs::temp_directory_path() /
+              ("ikvm_replay_test." + std::to_string(getpid()));
+        fs::create_directories(dir);
+    }
+
+    void TearDown() override
+    {
+        fs::remove_all(dir);
+
+        // Restore the pixel format defaults changed by probing
+        FrameSource::bitsPerSample = 8;
+        FrameSource::bytesPerPixel = 4;
+        FrameSource::samplesPerPixel = 3;
+    }
+
+    // Helper to write a frame file filled with one byte value
+    void writeFrame(const std::string& name, size_t size, char value)
+    {
+        std::ofstream file(dir / name, std::ios::binary);
+
+        file << std::string(size, value);
+    }
+
+    void writeManifest(const std::string& text)
+    {
+        std::ofstream file(dir / Replay::manifestName);
+
+        file << text;
+    }
+
+    fs::path dir;
+};
+
+TEST_F(ReplayTest, ProbeReadsManifest)
+{
+    writeFrame("a.bin", 16 * 8 * 2, 'a');
+    writeManifest("# recorded on an AST2600\n"
+                  "format rgb565\n"
+                  "rate 50\n"
+                  "frame a.bin 16 8\n");
+
+    Replay replay(dir.string());
+
+    replay.probePixelFormat();
+
+    EXPECT_EQ(replay.getPixelformat(), (uint32_t)V4L2_PIX_FMT_RGB565);
+    EXPECT_EQ(replay.getFrameRate(), 50);
+    EXPECT_EQ(replay.getWidth(), 16u);
+    EXPECT_EQ(replay.getHeight(), 8u);
+    EXPECT_EQ(FrameSource::bytesPerPixel, 2);
+    EXPECT_EQ(replay.getData(), nullptr);
+}
+
+TEST_F(ReplayTest, PlaysFramesInOrderAndLoops)
+{
+    writeFrame("a.jpg", 100, 'a');
+    writeFrame("b.jpg", 200, 'b');
+    writeManifest("format jpeg\n"
+                  "rate 60\n"
+                  "frame a.jpg 800 600\n"
+                  "frame b.jpg 800 600 2\n");
+
+    Replay replay(dir.string());
+    std::string played;
+
+    replay.probePixelFormat();
+    replay.start();
+    for (int i = 0; i < 7; ++i)
+    {
+        replay.getFrame();
+        ASSERT_FALSE(replay.needsResize());
+        ASSERT_NE(replay.getData(), nullptr);
+        played += replay.getData()[0];
+    }
+
+    EXPECT_EQ(played, "abbabba");
+    EXPECT_EQ(replay.getFrameSize(), 100u);
+    EXPECT_EQ(replay.getFrameCount(), 7u);
+
+    // Playback starts over from the first frame
+    replay.stop();
+    EXPECT_EQ(replay.getData(), nullptr);
+    replay.start();
+    replay.getFrame();
+    EXPECT_EQ(replay.getData()[0], 'a');
+}
+
+TEST_F(ReplayTest, ResolutionChangeTriggersResize)
+{
+    writeFrame("small", 4 * 4 * 4, 's');
+    writeFrame("large", 8 * 4 * 4, 'l');
+    writeManifest("format rgb24\n"
+                  "rate 60\n"
+                  "frame small 4 4\n"
+                  "frame large 8 4\n");
+
+    Replay replay(dir.string());
+
+    replay.probePixelFormat();
+    replay.start();
+
+    replay.getFrame();
+    EXPECT_FALSE(replay.needsResize());
+    EXPECT_EQ(replay.getData()[0], 's');
+
+    // The new resolution frame is held back until the resize
+    replay.getFrame();
+    EXPECT_EQ(replay.getData(), nullptr);
+    EXPECT_TRUE(replay.needsResize());
+    EXPECT_EQ(replay.getWidth(), 8u);
+    EXPECT_EQ(replay.getHeight(), 4u);
+    replay.resize();
+    EXPECT_EQ(replay.getData()[0], 'l');
+    EXPECT_EQ(replay.getFrameSize(), 8u * 4u * 4u);
+
+    replay.getFrame();
+    EXPECT_TRUE(replay.needsResize());
+    EXPECT_EQ(replay.getWidth(), 4u);
+}
+
+TEST_F(ReplayTest, LeavesPacingToCaller)
+{
+    writeFrame("a.jpg", 100, 'a');
+    writeManifest("format jpeg\n"
+                  "rate 50\n"
+                  "frame a.jpg 800 600\n");
+
+    Replay replay(dir.string());
+
+    replay.probePixelFormat();
+    replay.start();
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < 6; ++i)
+    {
+        replay.getFrame();
+        EXPECT_GE(replay.getCaptureTime(), t0);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - t0;
+
+    // The rate is the one the frames are paced at, but frames are stepped
+    // as soon as they are asked for
+    EXPECT_EQ(replay.getFrameRate(), 50);
+    EXPECT_LT(elapsed, std::chrono::milliseconds(100));
+    EXPECT_EQ(replay.getFrameCount(), 6u);
+}
+
+TEST_F(ReplayTest, InvalidManifest)
+{
+    Replay missing(dir.string());
+
+    EXPECT_ANY_THROW(missing.probePixelFormat());
+
+    writeManifest("format mpeg\n");
+    Replay badFormat(dir.string());
+
+    EXPECT_ANY_THROW(badFormat.probePixelFormat());
+
+    writeManifest("format jpeg\nframe missing.jpg 800 600\n");
+    Replay missingFrame(dir.string());
+
+    EXPECT_ANY_THROW(missingFrame.probePixelFormat());
+
+    writeManifest("format jpeg\n");
+    Replay noFrames(dir.string());
+
+    EXPECT_ANY_THROW(noFrames.probePixelFormat());
+}
+
+} // namespace ikvm
@@ -1,7 +1,19 @@
 #include "ikvm_server.hpp"
 
+#include "ikvm_dbus.hpp"
+#include "ikvm_flight_recorder.hpp"
+#include "ikvm_placeholder.hpp"
+#include "ikvm_tls.hpp"
+#include "ikvm_trace.hpp"
+
+#include <arpa/inet.h>
 #include <linux/videodev2.h>
+#include <netinet/in.h>
 #include <rfb/rfbproto.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <exception>
 
 #include <boost/crc.hpp>
 #include <phosphor-logging/elog-errors.hpp>
@@ -15,18 +27,73 @@ namespace ikvm
 using namespace phosphor::logging;
 using namespace sdbusplus::xyz::openbmc_project::Common::Error;
 
-Server::Server(const Args& args, Input& i, Video& v) :
-    pendingResize(false), frameCounter(0), numClients(0),
-    timeoutSeconds(args.getTimeoutSeconds()), input(i), video(v)
+int Server::qemuEncodings[] = {qemuExtendedKeyEventEncoding, 0};
+
+rfbProtocolExtension Server::qemuExtension = {
+    .newClient = nullptr,
+    .init = nullptr,
+    .pseudoEncodings = qemuEncodings,
+    .enablePseudoEncoding = enableQemuExtendedKeyEvent,
+    .handleMessage = handleQemuMessage,
+    .close = nullptr,
+    .usage = nullptr,
+    .processArgument = nullptr,
+    .next = nullptr,
+};
+
+static uint64_t kbpsToBytes(int kbps)
+{
+    return (uint64_t)kbps * 1000 / 8;
+}
+
+// Gets whether a client is connected from the BMC itself
+static bool isLocal(int sock)
+{
+    sockaddr_storage addr{};
+    socklen_t len = sizeof(addr);
+
+    if (getpeername(sock, (sockaddr*)&addr, &len))
+    {
+        return false;
+    }
+
+    if (addr.ss_family == AF_INET)
+    {
+        in_addr_t ip = ntohl(((sockaddr_in*)&addr)->sin_addr.s_addr);
+
+        return (ip >> 24) == IN_LOOPBACKNET;
+    }
+    if (addr.ss_family == AF_INET6)
+    {
+        const in6_addr* ip = &((sockaddr_in6*)&addr)->sin6_addr;
+
+        return IN6_IS_ADDR_LOOPBACK(ip) ||
+               (IN6_IS_ADDR_V4MAPPED(ip) && ip->s6_addr[12] == IN_LOOPBACKNET);
+    }
+
+    return addr.ss_family == AF_UNIX;
+}
+
+Server::Server(const Args& args, Input& i, FrameSource& v) :
+    pendingResize(false), resizeWidth(0), resizeHeight(0), frameCounter(0),
+    numClients(0), nextClientId(0), timeoutSeconds(args.getTimeoutSeconds()),
+    clientRate(args.getClientRate()),
+    clientBandwidth(args.getClientBandwidth()),
+    maxSessions(args.getMaxSessions()), viewerRate(args.getViewerRate()),
+    viewOnlyViewers(args.getViewOnlyViewers()), sendClients(0), input(i),
+    video(v), lastSendTime(0), frameSequence(0),
+    lastErrorCount(0), lastRestarts(0), lastNoSignalMs(0), frameChanged(false),
+    lastFrameCrc(-1), lastInputEvents(0), inputPending(false)
 {
-    std::string ip("localhost");
+    std::string ip(args.getListenAddress());
     const Args::CommandLine& commandLine = args.getCommandLine();
     int argc = commandLine.argc;
 
     video.probePixelFormat();
     server = rfbGetScreen(&argc, commandLine.argv, video.getWidth(),
-                          video.getHeight(), Video::bitsPerSample,
-                          Video::samplesPerPixel, Video::bytesPerPixel);
+                          video.getHeight(), FrameSource::bitsPerSample,
+                          FrameSource::samplesPerPixel,
+                          FrameSource::bytesPerPixel);
 
     if (!server)
     {
@@ -37,7 +104,7 @@ Server::Server(const Args& args, Input& i, Video& v) :
     }
 
     framebuffer.resize(
-        video.getHeight() * video.getWidth() * Video::bytesPerPixel, 0);
+        video.getHeight() * video.getWidth() * FrameSource::bytesPerPixel, 0);
 
     rfbSetServerPixelFormat(server);
 
@@ -50,7 +117,28 @@ Server::Server(const Args& args, Input& i, Video& v) :
     server->cursor->xhot = 1;
     server->cursor->yhot = 1;
 
-    rfbStringToAddr(&ip[0], &server->listenInterface);
+    if (!rfbStringToAddr(&ip[0], &server->listenInterface))
+    {
+        lg2::error("Failed to resolve the listen address {ADDRESS}",
+                   "ADDRESS", ip);
+        elog<InvalidArgument>(
+            xyz::openbmc_project::Common::InvalidArgument::ARGUMENT_NAME(
+                "listen"),
+            xyz::openbmc_project::Common::InvalidArgument::ARGUMENT_VALUE(
+                ip.c_str()));
+    }
+
+    if (!args.getTlsCertPath().empty())
+    {
+        const std::string& cert = args.getTlsCertPath();
+        const std::string& key = args.getTlsKeyPath();
+
+        tls = std::make_unique<Tls>(cert, key.empty() ? cert : key);
+    }
+    else if (server->listenInterface != htonl(INADDR_LOOPBACK))
+    {
+        lg2::warning("Listening on {ADDRESS} without TLS", "ADDRESS", ip);
+    }
 
     rfbInitServer(server);
 
@@ -58,14 +146,45 @@ Server::Server(const Args& args, Input& i, Video& v) :
 
     server->kbdAddEvent = Input::keyEvent;
     server->ptrAddEvent = Input::pointerEvent;
+    server->setXCutText = Input::cutText;
+    rfbRegisterProtocolExtension(&qemuExtension);
 
     processTime = (1000000 / video.getFrameRate()) - 100;
 
     calcFrameCRC = args.getCalcFrameCRC();
+    bandwidth.setRate(kbpsToBytes(args.getBandwidth()));
+
+    if (!args.getMetricsPath().empty())
+    {
+        stats.serve(args.getMetricsPath());
+    }
+
+    // Changes drive the idle frame rate and the input latency statistics
+    trackChanges = args.getIdleRate() > 0 || stats.isEnabled();
+
+    try
+    {
+        dbus = std::make_unique<DBus>();
+        if (!args.getDumpPath().empty())
+        {
+            dbus->publishFlightRecorder(args.getDumpPath());
+        }
+    }
+    catch (const std::exception& e)
+    {
+        lg2::warning("Failed to publish the sessions on D-Bus: {ERROR}",
+                     "ERROR", e.what());
+    }
 }
 
 Server::~Server()
 {
+    dbus.reset();
+    for (Negotiation& n : negotiations)
+    {
+        n.thread.join();
+    }
+    rfbUnregisterProtocolExtension(&qemuExtension);
     rfbScreenCleanup(server);
 }
 
@@ -88,29 +207,205 @@ void Server::rfbSetServerPixelFormat(rfbScreenInfoPtr screen)
 
 void Server::resize()
 {
-    if (frameCounter > video.getFrameRate())
+    std::lock_guard<std::mutex> guard(resizeLock);
+
+    resizeWidth = video.getWidth();
+    resizeHeight = video.getHeight();
+    pendingResize = true;
+}
+
+void Server::run()
+{
+    // Wake up in time to flush any coalesced pointer motion
+    rfbProcessEvents(server, input.getPointerDelay(processTime));
+    input.flushPointer();
+
+    if (!negotiations.empty())
+    {
+        finishNegotiations();
+    }
+
+    // Resizes wait for new clients to settle unless they are all told of
+    // the new size in-band; the frame source already streams the new
+    // geometry, and frames are dropped until the swap
+    if (server->clientHead)
+    {
+        frameCounter++;
+    }
+    if (pendingResize &&
+        (frameCounter > video.getFrameRate() || resizeInBand()))
     {
         doResize();
     }
-    else
+
+    if (server->clientHead)
     {
-        pendingResize = true;
+        updateSessions();
     }
 }
 
-void Server::run()
+void Server::showPlaceholder(const std::string& text)
+{
+    // Drawn once the framebuffer has the geometry of the frame source
+    if (placeholder == text || pendingResize)
+    {
+        return;
+    }
+
+    placeholder = text;
+    Placeholder::draw(framebuffer.data(), video.getWidth(), video.getHeight(),
+                      server->serverFormat, text);
+    rfbMarkRectAsModified(server, 0, 0, video.getWidth(), video.getHeight());
+
+    // Clients are sent the placeholder regardless of identical frames
+    // detection, so the next frame can't match their last checksum
+    resetFrameCrcs();
+}
+
+void Server::hidePlaceholder()
+{
+    if (placeholder.empty() || pendingResize)
+    {
+        return;
+    }
+
+    // Compressed frames bypass the framebuffer, which must not show the
+    // message around the cursor; uncompressed frames overwrite it anyway
+    placeholder.clear();
+    std::fill(framebuffer.begin(), framebuffer.end(), 0);
+}
+
+void Server::applySettings(const Settings::Values& values)
 {
-    rfbProcessEvents(server, processTime);
+    processTime = (1000000 / video.getFrameRate()) - 100;
+    timeoutSeconds = values.timeoutSeconds;
+    clientBandwidth = values.clientBandwidth;
+    bandwidth.setRate(kbpsToBytes(values.bandwidth));
 
-    if (server->clientHead)
+    if (values.calcFrameCRC == calcFrameCRC)
     {
-        frameCounter++;
-        if (pendingResize && frameCounter > video.getFrameRate())
+        return;
+    }
+
+    // Checksums from before detection was turned off are stale
+    calcFrameCRC = values.calcFrameCRC;
+    resetFrameCrcs();
+}
+
+void Server::promoteViewer(rfbClientPtr gone)
+{
+    rfbClientIteratorPtr it = rfbGetClientIterator(server);
+    rfbClientPtr cl;
+    rfbClientPtr oldest = nullptr;
+
+    while ((cl = rfbClientIteratorNext(it)))
+    {
+        ClientData* cd = (ClientData*)cl->clientData;
+
+        if (cl != gone && cd &&
+            (!oldest || cd->id < ((ClientData*)oldest->clientData)->id))
+        {
+            oldest = cl;
+        }
+    }
+
+    rfbReleaseClientIterator(it);
+
+    if (oldest)
+    {
+        ClientData* cd = (ClientData*)oldest->clientData;
+
+        cd->session->priority = Session::Priority::primary;
+        oldest->viewOnly = FALSE;
+        lg2::info("Client {ID} is now the primary session", "ID", cd->id);
+    }
+}
+
+void Server::resetFrameCrcs()
+{
+    rfbClientIteratorPtr it = rfbGetClientIterator(server);
+    rfbClientPtr cl;
+
+    while ((cl = rfbClientIteratorNext(it)))
+    {
+        ClientData* cd = (ClientData*)cl->clientData;
+
+        if (cd)
+        {
+            cd->last_crc = -1;
+        }
+    }
+
+    rfbReleaseClientIterator(it);
+}
+
+void Server::measureInputLatency(std::chrono::steady_clock::time_point now)
+{
+    if (input.getEventCount() != lastInputEvents)
+    {
+        lastInputEvents = input.getEventCount();
+
+        // Later events until the screen changes are part of the same echo
+        if (!inputPending)
         {
-            doResize();
-            pendingResize = false;
+            inputPending = true;
+            inputTime = input.getLastEventTime();
         }
     }
+
+    if (inputPending && frameChanged && video.getCaptureTime() >= inputTime)
+    {
+        stats.record(Stats::Stage::input, now - inputTime);
+        inputPending = false;
+    }
+}
+
+void Server::updateSignalStats()
+{
+    const VideoSignal& signal = video.getSignal();
+    uint64_t noSignalMs =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            signal.getLostTime(std::chrono::steady_clock::now()))
+            .count();
+
+    stats.increment(Stats::Counter::restarts,
+                    signal.getRestarts() - lastRestarts);
+    stats.increment(Stats::Counter::noSignalMs, noSignalMs - lastNoSignalMs);
+    lastRestarts = signal.getRestarts();
+    lastNoSignalMs = noSignalMs;
+}
+
+void Server::updateSessions()
+{
+    auto now = std::chrono::steady_clock::now();
+    rfbClientIteratorPtr it;
+    rfbClientPtr cl;
+
+    if (now - lastSessionUpdate < sessionUpdateInterval)
+    {
+        return;
+    }
+
+    lastSessionUpdate = now;
+    it = rfbGetClientIterator(server);
+
+    while ((cl = rfbClientIteratorNext(it)))
+    {
+        ClientData* cd = (ClientData*)cl->clientData;
+
+        if (!cd || !cd->session)
+        {
+            continue;
+        }
+
+        cd->session->updateFromSocket(cl->sock);
+        cd->session->encoding.store(cl->preferredEncoding,
+                                    std::memory_order_relaxed);
+        cd->session->qualityLevel.store(cl->tightQualityLevel,
+                                        std::memory_order_relaxed);
+    }
+
+    rfbReleaseClientIterator(it);
 }
 
 void Server::sendFrame()
@@ -120,12 +415,62 @@ void Server::sendFrame()
     rfbClientPtr cl;
     int64_t frame_crc = -1;
     auto now = std::chrono::steady_clock::now();
+    bool newFrame = video.getDequeueTime() != lastDequeueTime;
+    bool delivered = false;
+    unsigned int clients = 0;
+    uint64_t clientBytes = kbpsToBytes(clientBandwidth);
+    uint64_t shareBytes = bandwidth.getRate() / std::max(sendClients, 1u);
+    int viewerPolicy = ClientRate::limit(clientRate, viewerRate, 0);
+    auto frameInterval = std::chrono::microseconds(1000000) /
+                         std::max(video.getFrameRate(), 1);
+
+    // Viewers are degraded first: they skip a frame while sending took more
+    // than half a frame interval, and leave a reserve of the shared budget
+    bool sendPressure = lastSendTime > frameInterval / 2;
+    auto calcCrc = [&]() {
+        auto crcStart = std::chrono::steady_clock::now();
+
+        frame_crc = frameCrc(data, video.getFrameSize());
+        stats.record(Stats::Stage::crc,
+                     std::chrono::steady_clock::now() - crcStart);
+    };
+
+    frameChanged = false;
+
+    if (newFrame)
+    {
+        frameSequence++;
+        lastDequeueTime = video.getDequeueTime();
+        stats.increment(Stats::Counter::frames);
+        stats.record(Stats::Stage::capture,
+                     video.getDequeueTime() - video.getCaptureTime());
+    }
+
+    if (video.getErrorCount() != lastErrorCount)
+    {
+        stats.increment(Stats::Counter::errors,
+                        video.getErrorCount() - lastErrorCount);
+        lastErrorCount = video.getErrorCount();
+    }
 
     if (!data || pendingResize)
     {
+        if (newFrame)
+        {
+            stats.increment(Stats::Counter::dropped);
+        }
         return;
     }
 
+    // The adaptive capture rate follows the changes of every new frame
+    if (newFrame && trackChanges)
+    {
+        calcCrc();
+        frameChanged = frame_crc != lastFrameCrc;
+        lastFrameCrc = frame_crc;
+        measureInputLatency(now);
+    }
+
     it = rfbGetClientIterator(server);
 
     while ((cl = rfbClientIteratorNext(it)))
@@ -138,6 +483,8 @@ void Server::sendFrame()
             continue;
         }
 
+        clients++;
+
         // Check if client has been idle for more than configured timeout
         // Only if timeout is enabled (timeoutSeconds >= 0)
         if (timeoutSeconds >= 0)
@@ -162,8 +509,66 @@ void Server::sendFrame()
             continue;
         }
 
+        if (cd->awaitingResize)
+        {
+            continue;
+        }
+
+        // Clients capped below the capture rate get every few frames of the
+        // shared capture
+        bool viewer = cd->session->priority.load(std::memory_order_relaxed) ==
+                      Session::Priority::viewer;
+        int cap = ClientRate::limit(
+            viewer ? viewerPolicy : clientRate,
+            cd->session->maxFrameRate.load(std::memory_order_relaxed),
+            cd->session->bandwidthFrameRate.load(std::memory_order_relaxed));
+
+        cd->session->frameRateLimit.store(cap, std::memory_order_relaxed);
+        if (!cd->rate.due(video.getCaptureTime(), cap, video.getFrameRate()))
+        {
+            if (newFrame)
+            {
+                cd->session->framesSkippedRate.fetch_add(
+                    1, std::memory_order_relaxed);
+            }
+            continue;
+        }
+
         if (!cd->needUpdate)
         {
+            if (newFrame)
+            {
+                cd->session->framesSkippedBackpressure.fetch_add(
+                    1, std::memory_order_relaxed);
+            }
+            continue;
+        }
+
+        // Each client gets at most its share of the bandwidth of all the
+        // clients; over budget, frames are skipped rather than queued
+        cd->bucket.setRate(
+            (clientBytes && shareBytes) ? std::min(clientBytes, shareBytes)
+                                        : std::max(clientBytes, shareBytes));
+        if (!bandwidth.conforms(now) || !cd->bucket.conforms(now))
+        {
+            if (newFrame)
+            {
+                stats.increment(Stats::Counter::throttled);
+                cd->session->framesThrottled.fetch_add(
+                    1, std::memory_order_relaxed);
+            }
+            continue;
+        }
+
+        if (viewer &&
+            (sendPressure || !bandwidth.conforms(now, viewerReserve)))
+        {
+            if (newFrame)
+            {
+                stats.increment(Stats::Counter::degraded);
+                cd->session->framesDegraded.fetch_add(
+                    1, std::memory_order_relaxed);
+            }
             continue;
         }
 
@@ -171,15 +576,14 @@ void Server::sendFrame()
         {
             if (frame_crc == -1)
             {
-                /* JFIF header contains some varying data so skip it for
-                 * checksum calculation */
-                frame_crc =
-                    boost::crc<32, 0x04C11DB7, 0xFFFFFFFF, 0xFFFFFFFF, true,
-                               true>(data + 0x30, video.getFrameSize() - 0x30);
+                calcCrc();
             }
 
             if (cd->last_crc == frame_crc)
             {
+                stats.increment(Stats::Counter::skippedCrc);
+                cd->session->framesSkippedCrc.fetch_add(
+                    1, std::memory_order_relaxed);
                 continue;
             }
 
@@ -187,6 +591,13 @@ void Server::sendFrame()
         }
 
         cd->needUpdate = false;
+        cd->rate.sent(video.getCaptureTime(), cap);
+        bandwidth.consume(video.getFrameSize());
+        cd->bucket.consume(video.getFrameSize());
+
+        auto sendStart = std::chrono::steady_clock::now();
+
+        IKVM_PROBE(send_start, cd->id, frameSequence, video.getFrameSize());
 
         if (cl->enableLastRectEncoding)
         {
@@ -239,9 +650,43 @@ void Server::sendFrame()
             default:
                 break;
         }
+
+        // Uncompressed frames are only marked as modified here, and encoded
+        // when libvncserver next processes events
+        auto sendEnd = std::chrono::steady_clock::now();
+
+        IKVM_PROBE(send_end, cd->id, frameSequence, video.getFrameSize());
+
+        stats.record(Stats::Stage::queue, sendStart - video.getDequeueTime());
+        stats.record(Stats::Stage::send, sendEnd - sendStart);
+        stats.record(Stats::Stage::total, sendEnd - video.getCaptureTime());
+        stats.increment(Stats::Counter::sent);
+        cd->session->frameSent(sendEnd - video.getCaptureTime(),
+                               video.getFrameSize());
+        FlightRecorder::record(
+            FlightRecorder::Event::frameSent, cd->id, video.getFrameSize(),
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                sendEnd - video.getCaptureTime())
+                .count());
+        delivered = true;
     }
 
     rfbReleaseClientIterator(it);
+    sendClients = clients;
+    lastSendTime = std::chrono::steady_clock::now() - now;
+
+    if (newFrame && !delivered)
+    {
+        stats.increment(Stats::Counter::dropped);
+    }
+}
+
+int64_t Server::frameCrc(const char* data, size_t size)
+{
+    /* JFIF header contains some varying data so skip it for checksum
+     * calculation */
+    return boost::crc<32, 0x04C11DB7, 0xFFFFFFFF, 0xFFFFFFFF, true, true>(
+        data + 0x30, size - 0x30);
 }
 
 rfbBool Server::rfbSendCompressedDataHextile(rfbClientPtr cl, char* buf,
@@ -277,21 +722,43 @@ void Server::clientFramebufferUpdateRequest(
     // Ignore the furMsg info. This service uses full frame update always.
     (void)furMsg;
 
+    // A request after the new size was sent comes from a client that has
+    // processed it
+    if (cd->awaitingResize && !cl->newFBSizePending)
+    {
+        cd->awaitingResize = false;
+    }
+
     cd->needUpdate = true;
 }
 
 void Server::clientGone(rfbClientPtr cl)
 {
     Server* server = (Server*)cl->screen->screenData;
+    ClientData* cd = (ClientData*)cl->clientData;
+
+    IKVM_PROBE(client_disconnect, cd ? cd->id : 0, server->numClients - 1);
+    FlightRecorder::record(FlightRecorder::Event::clientDisconnect,
+                           cd ? cd->id : 0, server->numClients - 1);
+
+    if (cd && server->dbus)
+    {
+        server->dbus->removeSession(cd->id);
+    }
 
-    delete (ClientData*)cl->clientData;
+    if (cd && cd->session->priority == Session::Priority::primary)
+    {
+        server->promoteViewer(cl);
+    }
+
+    delete cd;
     cl->clientData = nullptr;
 
     if (server->numClients-- == 1)
     {
         server->input.disconnect();
-        rfbMarkRectAsModified(server->server, 0, 0, server->video.getWidth(),
-                              server->video.getHeight());
+        rfbMarkRectAsModified(server->server, 0, 0, server->server->width,
+                              server->server->height);
     }
 }
 
@@ -299,35 +766,255 @@ enum rfbNewClientAction Server::newClient(rfbClientPtr cl)
 {
     Server* server = (Server*)cl->screen->screenData;
 
-    cl->clientData =
-        new ClientData(server->video.getFrameRate(), &server->input);
+    if (server->sessionsFull(cl))
+    {
+        return RFB_CLIENT_REFUSE;
+    }
+
+    // Clients are given a session once through the security handshake
+    if (server->tls)
+    {
+        return server->negotiate(cl);
+    }
+
+    server->openSession(cl);
+
+    return RFB_CLIENT_ACCEPT;
+}
+
+bool Server::sessionsFull(rfbClientPtr cl)
+{
+    if (!maxSessions || numClients < maxSessions)
+    {
+        return false;
+    }
+
+    lg2::info("Refusing client {ADDRESS}, {CLIENTS} sessions are open",
+              "ADDRESS", cl->host ? cl->host : "", "CLIENTS", numClients);
+    stats.increment(Stats::Counter::rejected);
+    FlightRecorder::record(FlightRecorder::Event::clientRejected, numClients);
+
+    return true;
+}
+
+void Server::openSession(rfbClientPtr cl)
+{
+    ClientData* cd = new ClientData(video.getFrameRate(), &input);
+
+    cd->id = nextClientId++;
+    cd->session = std::make_shared<Session>(cd->id, cl->host ? cl->host : "");
+    cl->clientData = cd;
     cl->clientGoneHook = clientGone;
     cl->clientFramebufferUpdateRequestHook = clientFramebufferUpdateRequest;
-    if (!server->numClients++)
+    if (!numClients++)
+    {
+        input.connect();
+        frameCounter = 0;
+    }
+    else
     {
-        server->input.connect();
-        server->pendingResize = false;
-        server->frameCounter = 0;
+        // The first session is primary, the others view alongside it
+        cd->session->priority = Session::Priority::viewer;
+        cl->viewOnly = viewOnlyViewers;
     }
 
-    return RFB_CLIENT_ACCEPT;
+    IKVM_PROBE(client_connect, cd->id, numClients);
+    FlightRecorder::record(FlightRecorder::Event::clientConnect, cd->id,
+                           numClients);
+
+    if (dbus)
+    {
+        dbus->addSession(cd->session);
+    }
+}
+
+enum rfbNewClientAction Server::negotiate(rfbClientPtr cl)
+{
+    if (negotiations.size() >= maxNegotiations)
+    {
+        lg2::info("Refusing client {ADDRESS}, {COUNT} handshakes are running",
+                  "ADDRESS", cl->host ? cl->host : "", "COUNT",
+                  negotiations.size());
+        stats.increment(Stats::Counter::rejected);
+        return RFB_CLIENT_REFUSE;
+    }
+
+    Negotiation& n = negotiations.emplace_back();
+
+    // libvncserver already sent the server version and leaves the client
+    // alone while it is on hold; the socket is also taken out of its select
+    // so that the handshake doesn't wake it up. Only clients on the BMC
+    // itself, like the web server's proxy, may do without VeNCrypt
+    int fd = cl->sock;
+    bool local = isLocal(fd);
+
+    FD_CLR(fd, &server->allFds);
+    n.cl = cl;
+    n.thread = std::thread([this, &n, fd, local]() {
+        n.minorVersion = tls->negotiate(fd, local);
+        n.done = true;
+    });
+
+    return RFB_CLIENT_ON_HOLD;
+}
+
+void Server::finishNegotiations()
+{
+    for (auto n = negotiations.begin(); n != negotiations.end();)
+    {
+        rfbClientPtr cl = n->cl;
+
+        if (!n->done)
+        {
+            ++n;
+            continue;
+        }
+
+        n->thread.join();
+        FD_SET(cl->sock, &server->allFds);
+
+        if (!n->minorVersion)
+        {
+            lg2::info("Closing client {ADDRESS}, the security handshake failed",
+                      "ADDRESS", cl->host ? cl->host : "");
+            stats.increment(Stats::Counter::rejected);
+            rfbCloseClient(cl);
+        }
+        else if (sessionsFull(cl))
+        {
+            rfbCloseClient(cl);
+        }
+        else
+        {
+            // As libvncserver leaves a client after the security handshake
+            cl->protocolMajorVersion = rfbProtocolMajorVersion;
+            cl->protocolMinorVersion = n->minorVersion;
+            cl->state = rfbClientRec::RFB_INITIALISATION;
+            cl->onHold = FALSE;
+            openSession(cl);
+        }
+
+        n = negotiations.erase(n);
+    }
+}
+
+rfbBool Server::enableQemuExtendedKeyEvent(rfbClientPtr cl, void** data,
+                                           int encoding)
+{
+    char buf[sz_rfbFramebufferUpdateMsg + sz_rfbFramebufferUpdateRectHeader];
+    rfbFramebufferUpdateMsg fu;
+    rfbFramebufferUpdateRectHeader rect;
+
+    (void)data;
+    (void)encoding;
+
+    // Clients only send extended key events once the server answers with
+    // an empty rectangle of the pseudo-encoding; write it directly so as
+    // not to interfere with a frame being assembled in the update buffer
+    fu.type = rfbFramebufferUpdate;
+    fu.pad = 0;
+    fu.nRects = Swap16IfLE(1);
+    rect.r.x = rect.r.y = rect.r.w = rect.r.h = 0;
+    rect.encoding = Swap32IfLE(qemuExtendedKeyEventEncoding);
+
+    memcpy(buf, &fu, sz_rfbFramebufferUpdateMsg);
+    memcpy(&buf[sz_rfbFramebufferUpdateMsg], &rect,
+           sz_rfbFramebufferUpdateRectHeader);
+
+    if (rfbWriteExact(cl, buf, sizeof(buf)) < 0)
+    {
+        lg2::error("Failed to enable QEMU extended key events");
+        rfbCloseClient(cl);
+    }
+
+    return TRUE;
+}
+
+rfbBool Server::handleQemuMessage(rfbClientPtr cl, void* data,
+                                  const rfbClientToServerMsg* msg)
+{
+    uint8_t buf[qemuExtendedKeyEventLength];
+    uint16_t down;
+    uint32_t keysym;
+    uint32_t keycode;
+
+    (void)data;
+
+    if (msg->type != qemuMessageType)
+    {
+        return FALSE;
+    }
+
+    if (rfbReadExact(cl, (char*)buf, 1) <= 0)
+    {
+        rfbCloseClient(cl);
+        return TRUE;
+    }
+
+    // Other QEMU messages have no known length, so the stream can't be
+    // resynchronized after them
+    if (buf[0] != qemuExtendedKeyEvent)
+    {
+        lg2::error("Unsupported QEMU client message {SUBTYPE}", "SUBTYPE",
+                   buf[0]);
+        rfbCloseClient(cl);
+        return TRUE;
+    }
+
+    if (rfbReadExact(cl, (char*)&buf[1], qemuExtendedKeyEventLength - 1) <=
+        0)
+    {
+        rfbCloseClient(cl);
+        return TRUE;
+    }
+
+    memcpy(&down, &buf[1], sizeof(down));
+    memcpy(&keysym, &buf[3], sizeof(keysym));
+    memcpy(&keycode, &buf[7], sizeof(keycode));
+
+    if (!cl->viewOnly)
+    {
+        Input::extendedKeyEvent(Swap16IfLE(down) ? TRUE : FALSE,
+                                Swap32IfLE(keysym), Swap32IfLE(keycode), cl);
+    }
+
+    return TRUE;
 }
 
 void Server::doResize()
 {
     rfbClientIteratorPtr it;
     rfbClientPtr cl;
+    size_t width;
+    size_t height;
 
-    framebuffer.resize(
-        video.getHeight() * video.getWidth() * Video::bytesPerPixel, 0);
+    {
+        std::lock_guard<std::mutex> guard(resizeLock);
+
+        width = resizeWidth;
+        height = resizeHeight;
+    }
+
+    IKVM_PROBE(server_resize, width, height, numClients);
+    FlightRecorder::record(FlightRecorder::Event::serverResize, width, height,
+                           numClients);
+
+    // The storage is only reallocated when the new geometry doesn't fit
+    framebuffer.resize(height * width * FrameSource::bytesPerPixel, 0);
 
-    rfbNewFramebuffer(server, framebuffer.data(), video.getWidth(),
-                      video.getHeight(), Video::bitsPerSample,
-                      Video::samplesPerPixel, Video::bytesPerPixel);
+    rfbNewFramebuffer(server, framebuffer.data(), width, height,
+                      FrameSource::bitsPerSample, FrameSource::samplesPerPixel,
+                      FrameSource::bytesPerPixel);
 
     rfbSetServerPixelFormat(server);
 
-    rfbMarkRectAsModified(server, 0, 0, video.getWidth(), video.getHeight());
+    if (!placeholder.empty())
+    {
+        Placeholder::draw(framebuffer.data(), width, height,
+                          server->serverFormat, placeholder);
+    }
+
+    rfbMarkRectAsModified(server, 0, 0, width, height);
 
     it = rfbGetClientIterator(server);
 
@@ -343,11 +1030,46 @@ void Server::doResize()
             continue;
         }
 
-        // delay video updates to give the client time to resize
-        cd->skipFrame = video.getFrameRate();
+        // Clients told of the new size in-band get frames again once they
+        // ask for one of the new geometry; others get time to resize
+        if (cl->useNewFBSize || cl->useExtDesktopSize)
+        {
+            cd->awaitingResize = true;
+        }
+        else
+        {
+            cd->skipFrame = video.getFrameRate();
+        }
     }
 
     rfbReleaseClientIterator(it);
+
+    {
+        std::lock_guard<std::mutex> guard(resizeLock);
+
+        // Frames are sent again unless another resize was staged meanwhile
+        pendingResize = resizeWidth != width || resizeHeight != height;
+    }
+}
+
+bool Server::resizeInBand()
+{
+    rfbClientIteratorPtr it = rfbGetClientIterator(server);
+    rfbClientPtr cl;
+    bool inBand = true;
+
+    while ((cl = rfbClientIteratorNext(it)))
+    {
+        if (!cl->useNewFBSize && !cl->useExtDesktopSize)
+        {
+            inBand = false;
+            break;
+        }
+    }
+
+    rfbReleaseClientIterator(it);
+
+    return inBand;
 }
 
 } // namespace ikvm
@@ -1,16 +1,31 @@
 #pragma once
 
 #include "ikvm_args.hpp"
+#include "ikvm_client_rate.hpp"
+#include "ikvm_frame_source.hpp"
 #include "ikvm_input.hpp"
-#include "ikvm_video.hpp"
+#include "ikvm_session.hpp"
+#include "ikvm_settings.hpp"
+#include "ikvm_stats.hpp"
+#include "ikvm_token_bucket.hpp"
 
 #include <rfb/rfb.h>
 
+#include <atomic>
 #include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
 namespace ikvm
 {
+
+class DBus;
+class Tls;
+
 /*
  * @class Server
  * @brief Manages the RFB server connection and updates
@@ -31,7 +46,7 @@ class Server
          * @param[in] i - Pointer to Input object
          */
         ClientData(int s, Input* i) :
-            skipFrame(s), input(i), last_crc{-1},
+            id(0), skipFrame(s), awaitingResize(false), input(i), last_crc{-1},
             lastActivityTime(std::chrono::steady_clock::now())
         {
             needUpdate = false;
@@ -42,11 +57,27 @@ class Server
         ClientData(ClientData&&) = default;
         ClientData& operator=(ClientData&&) = default;
 
+        /* @brief Accounts an input event and refreshes the activity time */
+        inline void inputEvent()
+        {
+            lastActivityTime = std::chrono::steady_clock::now();
+            input->countEvent();
+            if (session)
+            {
+                session->inputEvents.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        unsigned int id;
         int skipFrame;
+        bool awaitingResize;
         Input* input;
         bool needUpdate;
         int64_t last_crc;
         std::chrono::steady_clock::time_point lastActivityTime;
+        std::shared_ptr<Session> session;
+        ClientRate rate;
+        TokenBucket bucket;
     };
 
     /*
@@ -54,21 +85,58 @@ class Server
      *
      * @param[in] args - Reference to Args object
      * @param[in] i    - Reference to Input object
-     * @param[in] v    - Reference to Video object
+     * @param[in] v    - Reference to the frame source
      */
-    Server(const Args& args, Input& i, Video& v);
+    Server(const Args& args, Input& i, FrameSource& v);
     ~Server();
-    Server(const Server&) = default;
+    Server(const Server&) = delete;
     Server& operator=(const Server&) = delete;
-    Server(Server&&) = default;
+    Server(Server&&) = delete;
     Server& operator=(Server&&) = delete;
 
-    /* @brief Resizes the RFB framebuffer */
+    /*
+     * @brief Stages a resize of the RFB framebuffer to the geometry of the
+     *        frame source; the server thread swaps the framebuffer at its
+     *        next iteration, and frames are dropped until then
+     */
     void resize();
     /* @brief Executes any pending RFB updates and client input */
     void run();
     /* @brief Sends pending video frame to clients */
     void sendFrame();
+    /*
+     * @brief Shows a message to the clients in place of the video; the
+     *        frame is rendered once and encoded by libvncserver only for
+     *        the clients that haven't received it yet
+     *
+     * @param[in] text - Message to show
+     */
+    void showPlaceholder(const std::string& text);
+    /* @brief Clears the message before video frames are sent again */
+    void hidePlaceholder();
+    /*
+     * @brief Applies changed settings; called between frames while the
+     *        server thread is paused, after the frame source took them
+     *
+     * @param[in] values - New values of the settings
+     */
+    void applySettings(const Settings::Values& values);
+    /*
+     * @brief Counts the restarts and time without signal of the frame
+     *        source; called from the video thread, which updates them
+     */
+    void updateSignalStats();
+
+    /*
+     * @brief Gets whether the last frame handled by sendFrame changed the
+     *        screen; only tracked with an idle frame rate
+     *
+     * @return Boolean indicating if the frame differs from the previous one
+     */
+    inline bool lastFrameChanged() const
+    {
+        return frameChanged;
+    }
 
     /*
      * @brief Indicates whether or not video data is desired
@@ -80,16 +148,77 @@ class Server
         return server->clientHead;
     }
     /*
-     * @brief Get the Video object
+     * @brief Get the frame source
      *
-     * @return Reference to the Video object
+     * @return Reference to the frame source
      */
-    inline const Video& getVideo() const
+    inline const FrameSource& getVideo() const
     {
         return video;
     }
+    /*
+     * @brief Get the frame statistics
+     *
+     * @return Reference to the frame statistics
+     */
+    inline Stats& getStats()
+    {
+        return stats;
+    }
+    /*
+     * @brief Get the D-Bus publisher
+     *
+     * @return Pointer to the D-Bus publisher, null without a system bus
+     */
+    inline DBus* getDBus()
+    {
+        return dbus.get();
+    }
+
+    /*
+     * @brief Calculates the checksum used to detect identical frames
+     *
+     * @param[in] data - Pointer to the frame data
+     * @param[in] size - Size of the frame data
+     *
+     * @return CRC-32 of the frame data after the JFIF header
+     */
+    static int64_t frameCrc(const char* data, size_t size);
+    /*
+     * @brief Sends hextil compressed data to the client
+     *
+     * @param[in] cl - Handle to the client object
+     * @param[in] buf - Pointer to the compressed data
+     * @param[in] compressedLen - Length of the compressed data
+     */
+    static rfbBool rfbSendCompressedDataHextile(rfbClientPtr cl, char* buf,
+                                                size_t compressedLen);
 
   private:
+    /*
+     * @struct Negotiation
+     * @brief Security handshake of a client on hold, running off the
+     *        server thread
+     */
+    struct Negotiation
+    {
+        Negotiation() = default;
+        ~Negotiation() = default;
+        Negotiation(const Negotiation&) = delete;
+        Negotiation& operator=(const Negotiation&) = delete;
+        Negotiation(Negotiation&&) = delete;
+        Negotiation& operator=(Negotiation&&) = delete;
+
+        /* @brief Handle to the client object */
+        rfbClientPtr cl = nullptr;
+        /* @brief Minor RFB protocol version agreed, 0 if refused */
+        int minorVersion = 0;
+        /* @brief Boolean indicating if the handshake is over */
+        std::atomic<bool> done = false;
+        /* @brief Thread running the handshake */
+        std::thread thread;
+    };
+
     /*
      * @brief Handler for a client frame update message
      *
@@ -111,46 +240,190 @@ class Server
      */
     static enum rfbNewClientAction newClient(rfbClientPtr cl);
 
-    /* @brief Performs the resize operation on the framebuffer */
-    void doResize();
+    /*
+     * @brief Handler for a client announcing QEMU extended key event support
+     *        in its encodings; acknowledges it to enable the events
+     *
+     * @param[in] cl       - Handle to the client object
+     * @param[in] data     - Extension data of the client, unused
+     * @param[in] encoding - Pseudo-encoding sent by the client
+     */
+    static rfbBool enableQemuExtendedKeyEvent(rfbClientPtr cl, void** data,
+                                              int encoding);
+    /*
+     * @brief Handler for client messages unknown to libvncserver; reads
+     *        QEMU extended key events and passes them to the Input object
+     *
+     * @param[in] cl   - Handle to the client object
+     * @param[in] data - Extension data of the client, unused
+     * @param[in] msg  - Pointer to the message, only the type has been read
+     *
+     * @return TRUE if the message has been handled
+     */
+    static rfbBool handleQemuMessage(rfbClientPtr cl, void* data,
+                                     const rfbClientToServerMsg* msg);
+    /*
+     * @brief Checks the number of open sessions before a client is given
+     *        one
+     *
+     * @param[in] cl - Handle to the client object
+     *
+     * @return Boolean indicating if the client must be refused
+     */
+    bool sessionsFull(rfbClientPtr cl);
+    /*
+     * @brief Gives a client its session, once through the security
+     *        handshake
+     *
+     * @param[in] cl - Handle to the client object
+     */
+    void openSession(rfbClientPtr cl);
+    /*
+     * @brief Puts a client on hold while its security handshake runs off
+     *        the server thread
+     *
+     * @param[in] cl - Handle to the client object
+     *
+     * @return Action libvncserver takes for the client
+     */
+    enum rfbNewClientAction negotiate(rfbClientPtr cl);
+    /*
+     * @brief Opens the sessions of the clients through the security
+     *        handshake and closes those that were refused
+     */
+    void finishNegotiations();
 
+    /* @brief Swaps the framebuffer for the staged geometry */
+    void doResize();
     /*
-     * @brief Performs the server pixel format setting
+     * @brief Gets whether all clients are told of resizes in-band
      *
-     * @param[in] screen - Handle to the RFB server object
+     * @return Boolean indicating if every client supports the DesktopSize
+     *         or ExtendedDesktopSize pseudo-encoding
      */
-    void rfbSetServerPixelFormat(rfbScreenInfoPtr screen);
+    bool resizeInBand();
+    /*
+     * @brief Makes the oldest viewer the primary session, once the primary
+     *        one is gone
+     *
+     * @param[in] gone - Handle to the client that was primary
+     */
+    void promoteViewer(rfbClientPtr gone);
+    /* @brief Forgets the last frame checksum of every client */
+    void resetFrameCrcs();
+    /* @brief Updates the session accounting read from the client sockets */
+    void updateSessions();
+    /*
+     * @brief Records the time from client input to the first changed frame
+     *        captured after it
+     *
+     * @param[in] now - Time at which the frame is sent
+     */
+    void measureInputLatency(std::chrono::steady_clock::time_point now);
 
     /*
-     * @brief Sends hextil compressed data to the client
+     * @brief Performs the server pixel format setting
      *
-     * @param[in] cl - Handle to the client object
-     * @param[in] buf - Pointer to the compressed data
-     * @param[in] compressedLen - Length of the compressed data
+     * @param[in] screen - Handle to the RFB server object
      */
-    rfbBool rfbSendCompressedDataHextile(rfbClientPtr cl, char* buf,
-                                         size_t compressedLen);
+    void rfbSetServerPixelFormat(rfbScreenInfoPtr screen);
 
-    /* @brief Boolean to indicate if a resize operation is on-going */
-    bool pendingResize;
+    /* @brief Boolean to indicate if a resize is staged for the server */
+    std::atomic<bool> pendingResize;
+    /* @brief Width of the staged framebuffer in pixels */
+    size_t resizeWidth;
+    /* @brief Height of the staged framebuffer in pixels */
+    size_t resizeHeight;
+    /* @brief Mutex of the staged geometry */
+    std::mutex resizeLock;
     /* @brief Number of frames handled since a client connected */
     int frameCounter;
     /* @brief Number of connected clients */
     unsigned int numClients;
+    /* @brief Identifier of the next client to connect */
+    unsigned int nextClientId;
     /* @brief Microseconds to process RFB events every frame */
     long int processTime;
     /* @brief Idle timeout duration in seconds */
     int timeoutSeconds;
+    /* @brief Highest frame rate sent to each client, 0 if not capped */
+    int clientRate;
+    /* @brief Bandwidth of each client in kbit/s, 0 if not limited */
+    int clientBandwidth;
+    /* @brief Highest number of concurrent sessions, 0 if not limited */
+    unsigned int maxSessions;
+    /* @brief Highest frame rate sent to the viewers, 0 if not capped */
+    int viewerRate;
+    /* @brief Ignore the input of the viewers */
+    bool viewOnlyViewers;
+    /* @brief Number of clients seen by the last sendFrame */
+    unsigned int sendClients;
     /* @brief Handle to the RFB server object */
     rfbScreenInfoPtr server;
     /* @brief Reference to the Input object */
     Input& input;
-    /* @brief Reference to the Video object */
-    Video& video;
+    /* @brief Reference to the frame source */
+    FrameSource& video;
     /* @brief Default framebuffer storage */
     std::vector<char> framebuffer;
     /* @brief Identical frames detection */
     bool calcFrameCRC;
+    /* @brief Checksums every new frame to tell whether the screen changed */
+    bool trackChanges;
+    /* @brief Message shown in place of the video, empty if none */
+    std::string placeholder;
+    /* @brief Frame statistics */
+    Stats stats;
+    /* @brief Budget of the bytes sent to all the clients */
+    TokenBucket bandwidth;
+    /* @brief Time taken by the last sendFrame to send to the clients */
+    std::chrono::steady_clock::duration lastSendTime;
+    /* @brief Sequence number of the last frame seen by sendFrame */
+    uint64_t frameSequence;
+    /* @brief Dequeue time of the last frame seen by sendFrame */
+    std::chrono::steady_clock::time_point lastDequeueTime;
+    /* @brief Error frame count of the source last seen by sendFrame */
+    uint64_t lastErrorCount;
+    /* @brief Restart count of the source last seen by updateSignalStats */
+    uint64_t lastRestarts;
+    /* @brief Milliseconds without signal last seen by updateSignalStats */
+    uint64_t lastNoSignalMs;
+    /* @brief Boolean indicating if the last frame differs from the previous */
+    bool frameChanged;
+    /* @brief Checksum of the last frame, when changes are tracked */
+    int64_t lastFrameCrc;
+    /* @brief Input event count last seen by measureInputLatency */
+    uint64_t lastInputEvents;
+    /* @brief Boolean indicating if input awaits a change of the screen */
+    bool inputPending;
+    /* @brief Time of the input awaiting a change of the screen */
+    std::chrono::steady_clock::time_point inputTime;
+    /* @brief Time of the last update of the session accounting */
+    std::chrono::steady_clock::time_point lastSessionUpdate;
+    /* @brief Publisher of the client sessions, null without a system bus */
+    std::unique_ptr<DBus> dbus;
+    /* @brief VeNCrypt with kernel TLS, null if not configured */
+    std::unique_ptr<Tls> tls;
+    /* @brief Security handshakes of the clients on hold */
+    std::list<Negotiation> negotiations;
+    /* @brief Fraction of the shared budget the viewers leave to the primary */
+    static constexpr double viewerReserve = 0.5;
+    /* @brief Minimum time between updates of the session accounting */
+    static constexpr std::chrono::seconds sessionUpdateInterval{1};
+    /* @brief Client message type of QEMU messages */
+    static constexpr uint8_t qemuMessageType = 255;
+    /* @brief QEMU message subtype of extended key events */
+    static constexpr uint8_t qemuExtendedKeyEvent = 0;
+    /* @brief Length of a QEMU extended key event after the message type */
+    static constexpr int qemuExtendedKeyEventLength = 11;
+    /* @brief Pseudo-encoding for QEMU extended key event support */
+    static constexpr int qemuExtendedKeyEventEncoding = -258;
+    /* @brief Zero-terminated pseudo-encodings of the QEMU extension */
+    static int qemuEncodings[];
+    /* @brief libvncserver extension handling QEMU extended key events */
+    static rfbProtocolExtension qemuExtension;
+    /* @brief Highest number of concurrent security handshakes */
+    static constexpr size_t maxNegotiations = 8;
     /* @brief Cursor bitmap width */
     static constexpr int cursorWidth = 20;
     /* @brief Cursor bitmap height */
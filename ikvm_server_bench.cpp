@@ -0,0 +1,138 @@
+#include "ikvm_server.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+namespace ikvm
+{
+
+// Formats of the captured frames, with JPEG frames assumed to compress to
+// about one bit per pixel as typical of a desktop
+enum class Format
+{
+    jpeg,
+    rgb565,
+    rgb24,
+};
+
+static size_t frameSize(const benchmark::State& state)
+{
+    size_t pixels = state.range(0) * state.range(1);
+
+    switch ((Format)state.range(2))
+    {
+        case Format::jpeg:
+            return pixels / 8;
+        case Format::rgb565:
+            return pixels * 2;
+        case Format::rgb24:
+        default:
+            return pixels * 4;
+    }
+}
+
+// Frame of noise, so that no kernel can take a shortcut on the data
+static std::vector<char> makeFrame(size_t size)
+{
+    std::vector<char> frame(size);
+    uint32_t seed = 0x12345678;
+
+    for (char& c : frame)
+    {
+        seed = seed * 1103515245 + 12345;
+        c = (char)(seed >> 16);
+    }
+
+    return frame;
+}
+
+// Resolutions from SVGA to WUXGA in the given formats
+static void frameArgs(benchmark::internal::Benchmark* b,
+                      std::initializer_list<Format> formats)
+{
+    b->ArgNames({"width", "height", "format"});
+    for (auto [width, height] : {std::pair{800, 600}, std::pair{1024, 768},
+                                 std::pair{1280, 1024}, std::pair{1600, 1200},
+                                 std::pair{1920, 1200}})
+    {
+        for (Format format : formats)
+        {
+            b->Args({width, height, (int64_t)format});
+        }
+    }
+}
+
+static void BM_FrameCrc(benchmark::State& state)
+{
+    size_t size = frameSize(state);
+    std::vector<char> frame = makeFrame(size);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(Server::frameCrc(frame.data(), size));
+    }
+
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_FrameCrc)->Apply([](benchmark::internal::Benchmark* b) {
+    frameArgs(b, {Format::jpeg, Format::rgb565, Format::rgb24});
+});
+
+// Copy of uncompressed frames into the framebuffer, as in Server::sendFrame
+static void BM_FramebufferAssign(benchmark::State& state)
+{
+    size_t size = frameSize(state);
+    std::vector<char> frame = makeFrame(size);
+    std::vector<char> framebuffer(size, 0);
+
+    for (auto _ : state)
+    {
+        framebuffer.assign(frame.data(), frame.data() + size);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_FramebufferAssign)->Apply([](benchmark::internal::Benchmark* b) {
+    frameArgs(b, {Format::rgb565, Format::rgb24});
+});
+
+// Chunked copy of hextile data through the client update buffer, written to
+// /dev/null so that the copy rather than the socket is measured
+static void BM_SendCompressedDataHextile(benchmark::State& state)
+{
+    size_t size = frameSize(state);
+    std::vector<char> frame = makeFrame(size);
+    auto screen = std::make_unique<rfbScreenInfo>();
+    auto cl = std::make_unique<rfbClientRec>();
+
+    cl->screen = screen.get();
+    cl->sock = open("/dev/null", O_WRONLY);
+    if (cl->sock < 0)
+    {
+        state.SkipWithError("Failed to open /dev/null");
+        return;
+    }
+
+    for (auto _ : state)
+    {
+        Server::rfbSendCompressedDataHextile(cl.get(), frame.data(), size);
+        rfbSendUpdateBuf(cl.get());
+    }
+
+    close(cl->sock);
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_SendCompressedDataHextile)
+    ->Apply([](benchmark::internal::Benchmark* b) {
+        frameArgs(b, {Format::jpeg, Format::rgb565});
+    });
+
+} // namespace ikvm
+
+BENCHMARK_MAIN();
@@ -0,0 +1,67 @@
+#include "ikvm_session.hpp"
+
+#include <linux/tcp.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+
+namespace ikvm
+{
+
+void Session::updateFromSocket(int fd)
+{
+    tcp_info info{};
+    socklen_t len = sizeof(info);
+
+    // Older kernels fill in less of the structure, leaving the rest zero
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len))
+    {
+        return;
+    }
+
+    bytesSent.store(info.tcpi_bytes_acked, std::memory_order_relaxed);
+    roundTripTime.store(info.tcpi_rtt, std::memory_order_relaxed);
+
+    uint64_t frames = framesSent.load(std::memory_order_relaxed);
+    uint64_t bytes = frameBytes.load(std::memory_order_relaxed);
+
+    // The estimate needs frames sent since the last update
+    if (frames == lastFramesSent)
+    {
+        return;
+    }
+
+    bandwidthFrameRate.store(
+        estimateFrameRate(info.tcpi_delivery_rate,
+                          info.tcpi_delivery_rate_app_limited,
+                          (bytes - lastFrameBytes) / (frames - lastFramesSent),
+                          bandwidthFrameRate.load(std::memory_order_relaxed)),
+        std::memory_order_relaxed);
+    lastFramesSent = frames;
+    lastFrameBytes = bytes;
+}
+
+int Session::estimateFrameRate(uint64_t deliveryRate, bool appLimited,
+                               uint64_t size, int current)
+{
+    uint64_t rate;
+
+    if (!deliveryRate || !size)
+    {
+        return current;
+    }
+
+    if (appLimited)
+    {
+        rate = current ? current + 1 : 0;
+    }
+    else
+    {
+        rate = std::max<uint64_t>(deliveryRate / size, 1);
+    }
+
+    return rate < maxRate ? rate : 0;
+}
+
+} // namespace ikvm
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace ikvm
+{
+
+/*
+ * @class Session
+ * @brief Accounting of an RFB client session; the counters are updated on
+ *        the hot paths with relaxed atomics and read when published
+ */
+class Session
+{
+  public:
+    /* @brief Priority classes of the sessions */
+    enum class Priority
+    {
+        primary,
+        viewer,
+    };
+
+    /*
+     * @brief Constructs Session object
+     *
+     * @param[in] i - Identifier of the client
+     * @param[in] a - Address of the client
+     */
+    Session(unsigned int i, const std::string& a) :
+        id(i), address(a), connectedTime(std::chrono::system_clock::now()),
+        bytesSent(0), framesSent(0), framesSkippedCrc(0),
+        framesSkippedBackpressure(0), framesSkippedRate(0),
+        framesThrottled(0), framesDegraded(0), frameBytes(0),
+        latencySum(0), inputEvents(0), encoding(0), qualityLevel(-1),
+        roundTripTime(0), maxFrameRate(0), bandwidthFrameRate(0),
+        frameRateLimit(0), priority(Priority::primary), lastFramesSent(0),
+        lastFrameBytes(0)
+    {}
+    ~Session() = default;
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+    Session(Session&&) = delete;
+    Session& operator=(Session&&) = delete;
+
+    /*
+     * @brief Counts a frame sent to the client
+     *
+     * @param[in] latency - Time from capture to the frame being sent
+     * @param[in] size    - Size of the frame in bytes
+     */
+    inline void frameSent(std::chrono::steady_clock::duration latency,
+                          size_t size = 0)
+    {
+        framesSent.fetch_add(1, std::memory_order_relaxed);
+        frameBytes.fetch_add(size, std::memory_order_relaxed);
+        latencySum.fetch_add(
+            std::chrono::duration_cast<std::chrono::microseconds>(latency)
+                .count(),
+            std::memory_order_relaxed);
+    }
+
+    /*
+     * @brief Gets the mean time from capture to the frames being sent
+     *
+     * @return Mean latency in milliseconds, 0 if no frame was sent
+     */
+    inline double getAverageLatency() const
+    {
+        uint64_t frames = framesSent.load(std::memory_order_relaxed);
+
+        return frames ? latencySum.load(std::memory_order_relaxed) / 1000.0 /
+                            frames
+                      : 0.0;
+    }
+
+    /*
+     * @brief Reads the bytes acknowledged by the client and the round trip
+     *        time from the TCP connection, and estimates the frame rate its
+     *        bandwidth allows; called from the server thread only
+     *
+     * @param[in] fd - Socket of the client
+     */
+    void updateFromSocket(int fd);
+
+    /*
+     * @brief Estimates the frame rate the bandwidth of a connection allows
+     *
+     * A connection sending all it is given, which is application limited,
+     * only shows that the current rate fits; the estimate then rises by a
+     * frame per second at every call until the connection can't keep up.
+     *
+     * @param[in] deliveryRate - Delivery rate of the connection in bytes per
+     *                           second
+     * @param[in] appLimited   - Whether the delivery rate was limited by the
+     *                           data sent rather than the connection
+     * @param[in] size         - Mean size of the frames lately sent
+     * @param[in] current      - Current estimate, 0 if none
+     *
+     * @return Estimated frame rate, 0 if the connection doesn't limit it
+     */
+    static int estimateFrameRate(uint64_t deliveryRate, bool appLimited,
+                                 uint64_t size, int current);
+
+    /* @brief Identifier of the client */
+    const unsigned int id;
+    /* @brief Address of the client */
+    const std::string address;
+    /* @brief Time at which the client connected */
+    const std::chrono::system_clock::time_point connectedTime;
+    /* @brief Number of bytes acknowledged by the client */
+    std::atomic<uint64_t> bytesSent;
+    /* @brief Number of frames sent to the client */
+    std::atomic<uint64_t> framesSent;
+    /* @brief Number of frames skipped as identical to the previous one */
+    std::atomic<uint64_t> framesSkippedCrc;
+    /* @brief Number of frames skipped as the client hadn't requested one */
+    std::atomic<uint64_t> framesSkippedBackpressure;
+    /* @brief Number of frames skipped to keep to the frame rate cap */
+    std::atomic<uint64_t> framesSkippedRate;
+    /* @brief Number of frames skipped as over the bandwidth budget */
+    std::atomic<uint64_t> framesThrottled;
+    /* @brief Number of frames skipped to spare the primary session */
+    std::atomic<uint64_t> framesDegraded;
+    /* @brief Number of bytes of the frames sent to the client */
+    std::atomic<uint64_t> frameBytes;
+    /* @brief Sum of the capture to send latencies in microseconds */
+    std::atomic<uint64_t> latencySum;
+    /* @brief Number of key, pointer and clipboard events from the client */
+    std::atomic<uint64_t> inputEvents;
+    /* @brief Preferred encoding of the client */
+    std::atomic<int32_t> encoding;
+    /* @brief JPEG quality level requested by the client, -1 if none */
+    std::atomic<int32_t> qualityLevel;
+    /* @brief Smoothed round trip time of the connection in microseconds */
+    std::atomic<uint32_t> roundTripTime;
+    /* @brief Frame rate cap requested over D-Bus, 0 if none */
+    std::atomic<int32_t> maxFrameRate;
+    /* @brief Frame rate cap estimated from the bandwidth, 0 if none */
+    std::atomic<int32_t> bandwidthFrameRate;
+    /* @brief Frame rate cap applied to the client, 0 if none */
+    std::atomic<int32_t> frameRateLimit;
+    /* @brief Priority class of the session */
+    std::atomic<Priority> priority;
+    /* @brief Highest frame rate a cap may have */
+    static constexpr int maxRate = 60;
+
+  private:
+    /* @brief Number of frames sent at the last socket update */
+    uint64_t lastFramesSent;
+    /* @brief Number of frame bytes sent at the last socket update */
+    uint64_t lastFrameBytes;
+};
+
+} // namespace ikvm
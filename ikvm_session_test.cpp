@@ -0,0 +1,90 @@
+#include "ikvm_session.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+namespace ikvm
+{
+
+TEST(SessionTest, AverageLatency)
+{
+    Session session(3, "192.0.2.1");
+
+    EXPECT_EQ(session.id, 3u);
+    EXPECT_EQ(session.address, "192.0.2.1");
+    EXPECT_EQ(session.priority.load(), Session::Priority::primary);
+    EXPECT_DOUBLE_EQ(session.getAverageLatency(), 0.0);
+
+    session.frameSent(std::chrono::milliseconds(10));
+    session.frameSent(std::chrono::microseconds(20500));
+
+    EXPECT_EQ(session.framesSent.load(), 2u);
+    EXPECT_DOUBLE_EQ(session.getAverageLatency(), 15.25);
+}
+
+TEST(SessionTest, EstimateFrameRate)
+{
+    // 1 MB/s of 100 kB frames
+    EXPECT_EQ(Session::estimateFrameRate(1000000, false, 100000, 0), 10);
+    EXPECT_EQ(Session::estimateFrameRate(1000, false, 100000, 0), 1);
+    EXPECT_EQ(Session::estimateFrameRate(10000000, false, 100000, 0), 0);
+
+    // Keeping up with the cap probes for a higher rate, up to no cap
+    EXPECT_EQ(Session::estimateFrameRate(1000000, true, 100000, 10), 11);
+    EXPECT_EQ(Session::estimateFrameRate(1000000, true, 100000, 59), 0);
+    EXPECT_EQ(Session::estimateFrameRate(1000000, true, 100000, 0), 0);
+
+    // Nothing measured, the estimate stays
+    EXPECT_EQ(Session::estimateFrameRate(0, false, 100000, 7), 7);
+    EXPECT_EQ(Session::estimateFrameRate(1000000, false, 0, 7), 7);
+}
+
+TEST(SessionTest, UpdateFromSocket)
+{
+    Session session(0, "127.0.0.1");
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int client = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    socklen_t len = sizeof(addr);
+    char buf[4096] = {};
+
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(bind(listener, (sockaddr*)&addr, sizeof(addr)), 0);
+    ASSERT_EQ(listen(listener, 1), 0);
+    ASSERT_EQ(getsockname(listener, (sockaddr*)&addr, &len), 0);
+    ASSERT_EQ(connect(client, (sockaddr*)&addr, sizeof(addr)), 0);
+
+    int server = accept(listener, nullptr, nullptr);
+
+    ASSERT_GE(server, 0);
+    ASSERT_EQ(write(server, buf, sizeof(buf)), (ssize_t)sizeof(buf));
+    ASSERT_EQ(recv(client, buf, sizeof(buf), MSG_WAITALL),
+              (ssize_t)sizeof(buf));
+
+    // The acknowledgement may lag the data by a round trip
+    for (int i = 0; i < 100 && session.bytesSent.load() < sizeof(buf); ++i)
+    {
+        session.updateFromSocket(server);
+        usleep(1000);
+    }
+
+    EXPECT_EQ(session.bytesSent.load(), sizeof(buf));
+    EXPECT_GT(session.roundTripTime.load(), 0u);
+
+    // Not a TCP socket, the counters are left as they were
+    session.updateFromSocket(-1);
+    EXPECT_EQ(session.bytesSent.load(), sizeof(buf));
+
+    close(server);
+    close(client);
+    close(listener);
+}
+
+} // namespace ikvm
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "ikvm_args.hpp"
+#include "ikvm_frame_source.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <utility>
+
+namespace ikvm
+{
+
+/*
+ * @class Settings
+ * @brief Streaming settings changeable at runtime; changes are requested
+ *        from any thread and taken by the video thread between frames
+ */
+class Settings
+{
+  public:
+    /*
+     * @struct Values
+     * @brief Values of the settings
+     */
+    struct Values
+    {
+        /* @brief Frame rate in frames per second */
+        int frameRate;
+        /* @brief JPEG subsampling, 1:420/0:444 */
+        int subsampling;
+        /* @brief JPEG quality of the video device, -1 to leave it as is */
+        int quality;
+        /* @brief Identical frames detection */
+        bool calcFrameCRC;
+        /* @brief Idle timeout in seconds, -1 if disabled */
+        int timeoutSeconds;
+        /* @brief Bandwidth of all the clients in kbit/s, 0 if not limited */
+        int bandwidth;
+        /* @brief Bandwidth of each client in kbit/s, 0 if not limited */
+        int clientBandwidth;
+    };
+
+    /*
+     * @brief Constructs Settings object
+     *
+     * @param[in] args  - Reference to Args object
+     * @param[in] video - Reference to the frame source, whose values may
+     *                    differ from the requested ones
+     */
+    Settings(const Args& args, const FrameSource& video) :
+        values{video.getFrameRate(), video.getSubsampling(),
+               video.getQuality(), args.getCalcFrameCRC(),
+               args.getTimeoutSeconds(), args.getBandwidth(),
+               args.getClientBandwidth()},
+        qualityRange(video.getQualityRange()), changed(false)
+    {}
+    ~Settings() = default;
+    Settings(const Settings&) = delete;
+    Settings& operator=(const Settings&) = delete;
+    Settings(Settings&&) = delete;
+    Settings& operator=(Settings&&) = delete;
+
+    /*
+     * @brief Gets the current values, including changes not yet taken
+     *
+     * @return Values of the settings
+     */
+    inline Values get()
+    {
+        std::lock_guard<std::mutex> l(lock);
+
+        return values;
+    }
+
+    /*
+     * @brief Reads back the values the frame source settled on, e.g. the
+     *        frame rate of a recording once probed; not a change
+     *
+     * @param[in] video - Reference to the frame source
+     */
+    inline void readBack(const FrameSource& video)
+    {
+        std::lock_guard<std::mutex> l(lock);
+
+        values.frameRate = video.getFrameRate();
+        values.subsampling = video.getSubsampling();
+        values.quality = video.getQuality();
+        qualityRange = video.getQualityRange();
+    }
+
+    /*
+     * @brief Checks a JPEG quality against the range of the frame source
+     *
+     * @param[in] q - Value of the quality, -1 to leave it as is
+     *
+     * @return Boolean indicating if the frame source accepts the quality
+     */
+    inline bool isValidQuality(int q)
+    {
+        std::lock_guard<std::mutex> l(lock);
+
+        return q == -1 || (q >= qualityRange.first && q <= qualityRange.second);
+    }
+
+    /*
+     * @brief Requests new values
+     *
+     * @param[in] v - New values of the settings
+     */
+    inline void set(const Values& v)
+    {
+        std::lock_guard<std::mutex> l(lock);
+
+        values = v;
+        changed.store(true, std::memory_order_release);
+    }
+
+    /*
+     * @brief Takes the values if they changed since last taken; costs an
+     *        atomic load when they haven't
+     *
+     * @param[out] v - Values of the settings, if changed
+     *
+     * @return Boolean indicating whether the values changed
+     */
+    inline bool take(Values& v)
+    {
+        if (!changed.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> l(lock);
+
+        changed.store(false, std::memory_order_relaxed);
+        v = values;
+
+        return true;
+    }
+
+  private:
+    /* @brief Values of the settings */
+    Values values;
+    /* @brief Lowest and highest JPEG quality of the frame source */
+    std::pair<int, int> qualityRange;
+    /* @brief Boolean to indicate the values changed since last taken */
+    std::atomic<bool> changed;
+    /* @brief Mutex protecting the values */
+    std::mutex lock;
+};
+
+} // namespace ikvm
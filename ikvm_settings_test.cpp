@@ -0,0 +1,139 @@
+#include "ikvm_settings.hpp"
+
+#include <getopt.h>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace ikvm
+{
+
+/*
+ * @class TestSource
+ * @brief Frame source without frames, only holding the settings
+ */
+class TestSource : public FrameSource
+{
+  public:
+    TestSource(int fr, int sub) : FrameSource(fr, sub) {}
+
+    void setQualityRange(int min, int max)
+    {
+        qualityMin = min;
+        qualityMax = max;
+    }
+
+    char* getData() override
+    {
+        return nullptr;
+    }
+    void getFrame() override {}
+    void probePixelFormat() override {}
+    bool needsResize() override
+    {
+        return false;
+    }
+    void resize() override {}
+    void start() override {}
+    void stop() override {}
+    size_t getFrameSize() const override
+    {
+        return 0;
+    }
+};
+
+class SettingsTest : public ::testing::Test
+{
+  protected:
+    SettingsTest() :
+        argv{(char*)"obmc-ikvm", (char*)"-c", (char*)"-t", (char*)"60",
+             (char*)"--bandwidth", (char*)"20000"},
+        args(parseArgs(argv)), video(24, 1)
+    {}
+
+    static Args parseArgs(std::vector<char*>& argv)
+    {
+        // Reset getopt state before each test
+        optind = 1;
+
+        return Args(argv.size(), argv.data());
+    }
+
+    std::vector<char*> argv;
+    Args args;
+    TestSource video;
+};
+
+TEST_F(SettingsTest, InitialValues)
+{
+    Settings settings(args, video);
+    Settings::Values values = settings.get();
+
+    EXPECT_EQ(values.frameRate, 24);
+    EXPECT_EQ(values.subsampling, 1);
+    EXPECT_EQ(values.quality, -1);
+    EXPECT_TRUE(values.calcFrameCRC);
+    EXPECT_EQ(values.timeoutSeconds, 60);
+    EXPECT_EQ(values.bandwidth, 20000);
+    EXPECT_EQ(values.clientBandwidth, 0);
+    EXPECT_FALSE(settings.take(values));
+}
+
+TEST_F(SettingsTest, ChangesTakenOnce)
+{
+    Settings settings(args, video);
+    Settings::Values values = settings.get();
+    Settings::Values taken{};
+
+    values.frameRate = 15;
+    values.quality = 4;
+    settings.set(values);
+
+    ASSERT_TRUE(settings.take(taken));
+    EXPECT_EQ(taken.frameRate, 15);
+    EXPECT_EQ(taken.quality, 4);
+    EXPECT_EQ(taken.timeoutSeconds, 60);
+    EXPECT_FALSE(settings.take(taken));
+}
+
+TEST_F(SettingsTest, ReadBackIsNotAChange)
+{
+    Settings settings(args, video);
+    Settings::Values values;
+
+    video.setFrameRate(10);
+    video.setQuality(7);
+    settings.readBack(video);
+
+    EXPECT_FALSE(settings.take(values));
+    EXPECT_EQ(settings.get().frameRate, 10);
+    EXPECT_EQ(settings.get().quality, 7);
+}
+
+TEST_F(SettingsTest, QualityWithinSourceRange)
+{
+    Settings settings(args, video);
+
+    EXPECT_TRUE(settings.isValidQuality(-1));
+    EXPECT_TRUE(settings.isValidQuality(100));
+    EXPECT_FALSE(settings.isValidQuality(101));
+
+    video.setQualityRange(0, 11);
+    settings.readBack(video);
+
+    EXPECT_TRUE(settings.isValidQuality(0));
+    EXPECT_TRUE(settings.isValidQuality(11));
+    EXPECT_FALSE(settings.isValidQuality(12));
+    EXPECT_FALSE(settings.isValidQuality(-2));
+
+    // The source has no quality control
+    video.setQualityRange(0, -1);
+    settings.readBack(video);
+
+    EXPECT_TRUE(settings.isValidQuality(-1));
+    EXPECT_FALSE(settings.isValidQuality(0));
+}
+
+} // namespace ikvm
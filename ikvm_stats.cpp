@@ -0,0 +1,295 @@
+#include "ikvm_stats.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <bit>
+#include <cmath>
+#include <sstream>
+
+#include <phosphor-logging/lg2.hpp>
+
+namespace ikvm
+{
+
+Histogram::Histogram() : count(0), sum(0), max(0)
+{
+    for (auto& c : counts)
+    {
+        c.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::record(uint64_t value)
+{
+    uint64_t m = max.load(std::memory_order_relaxed);
+
+    counts[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+
+    while (value > m &&
+           !max.compare_exchange_weak(m, value, std::memory_order_relaxed))
+    {}
+}
+
+void Histogram::reset()
+{
+    for (auto& c : counts)
+    {
+        c.store(0, std::memory_order_relaxed);
+    }
+
+    count.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::getCount() const
+{
+    return count.load(std::memory_order_relaxed);
+}
+
+double Histogram::getMean() const
+{
+    uint64_t n = getCount();
+
+    return n ? (double)sum.load(std::memory_order_relaxed) / n : 0.0;
+}
+
+uint64_t Histogram::getMax() const
+{
+    return max.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::getPercentile(double fraction) const
+{
+    uint64_t n = getCount();
+    uint64_t seen = 0;
+    uint64_t target;
+
+    if (!n)
+    {
+        return 0;
+    }
+
+    target = std::max<uint64_t>((uint64_t)std::ceil(fraction * n), 1);
+
+    // The buckets may be updated meanwhile, so fall back to the maximum if
+    // they add up to less than the count read above
+    for (size_t i = 0; i < buckets; ++i)
+    {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen >= target)
+        {
+            return std::min(bucketLimit(i), getMax());
+        }
+    }
+
+    return getMax();
+}
+
+size_t Histogram::bucketIndex(uint64_t value)
+{
+    if (value < subBuckets)
+    {
+        return value;
+    }
+
+    int shift = std::bit_width(value) - 1 - subBucketBits;
+
+    return (shift + 1) * subBuckets + ((value >> shift) - subBuckets);
+}
+
+uint64_t Histogram::bucketLimit(size_t index)
+{
+    if (index < subBuckets)
+    {
+        return index;
+    }
+
+    size_t shift = index / subBuckets - 1;
+    uint64_t sub = index % subBuckets + subBuckets;
+
+    // Wraps around to the largest value for the last bucket
+    return ((sub + 1) << shift) - 1;
+}
+
+Stats::Stats() : enabled(false), listenFd(-1), stopFds{-1, -1}
+{
+    for (auto& c : counters)
+    {
+        c.store(0, std::memory_order_relaxed);
+    }
+
+    for (auto& g : gauges)
+    {
+        g.store(0.0, std::memory_order_relaxed);
+    }
+}
+
+Stats::~Stats()
+{
+    if (server.joinable())
+    {
+        char stop = 0;
+
+        if (write(stopFds[1], &stop, sizeof(stop)) < 0)
+        {
+            lg2::error("Failed to stop the stats server: {ERROR}", "ERROR",
+                       strerror(errno));
+        }
+        server.join();
+    }
+
+    for (int fd : {listenFd, stopFds[0], stopFds[1]})
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+    if (!socketPath.empty())
+    {
+        unlink(socketPath.c_str());
+    }
+}
+
+void Stats::serve(const std::string& path)
+{
+    sockaddr_un addr{};
+
+    if (path.size() >= sizeof(addr.sun_path))
+    {
+        lg2::error("Stats socket path {PATH} is too long", "PATH", path);
+        return;
+    }
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0)
+    {
+        lg2::error("Failed to create the stats socket: {ERROR}", "ERROR",
+                   strerror(errno));
+        return;
+    }
+
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    unlink(path.c_str());
+
+    if (bind(listenFd, (sockaddr*)&addr, sizeof(addr)) ||
+        listen(listenFd, 4) || pipe2(stopFds, O_CLOEXEC))
+    {
+        lg2::error("Failed to listen on stats socket {PATH}: {ERROR}", "PATH",
+                   path, "ERROR", strerror(errno));
+        close(listenFd);
+        listenFd = -1;
+        return;
+    }
+
+    socketPath = path;
+    enabled = true;
+    server = std::thread(&Stats::serverThread, this);
+
+    lg2::info("Serving frame statistics on {PATH}", "PATH", path);
+}
+
+std::string Stats::toJson() const
+{
+    static constexpr const char* stageNames[] = {
+        "capture", "crc", "queue", "send", "total", "input", "pacing"};
+    static constexpr const char* counterNames[] = {
+        "frames",      "sent",      "dropped",  "skipped_crc",
+        "errors",      "restarts",  "no_signal_ms",
+        "late_frames", "throttled", "rejected", "degraded"};
+    static constexpr const char* gaugeNames[] = {"fps"};
+    std::ostringstream json;
+
+    json << "{\"counters\":{";
+    for (size_t i = 0; i < counters.size(); ++i)
+    {
+        json << (i ? "," : "") << "\"" << counterNames[i]
+             << "\":" << get((Counter)i);
+    }
+
+    json << "},\"gauges\":{";
+    for (size_t i = 0; i < gauges.size(); ++i)
+    {
+        json << (i ? "," : "") << "\"" << gaugeNames[i]
+             << "\":" << get((Gauge)i);
+    }
+
+    json << "},\"stages_us\":{";
+    for (size_t i = 0; i < stages.size(); ++i)
+    {
+        const Histogram& h = stages[i];
+
+        json << (i ? "," : "") << "\"" << stageNames[i] << "\":{"
+             << "\"count\":" << h.getCount() << ",\"mean\":" << h.getMean()
+             << ",\"p50\":" << h.getPercentile(0.5)
+             << ",\"p90\":" << h.getPercentile(0.9)
+             << ",\"p99\":" << h.getPercentile(0.99)
+             << ",\"max\":" << h.getMax() << "}";
+    }
+    json << "}}\n";
+
+    return json.str();
+}
+
+void Stats::serverThread()
+{
+    pollfd fds[2] = {{listenFd, POLLIN, 0}, {stopFds[0], POLLIN, 0}};
+
+    while (true)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            lg2::error("Failed to poll the stats socket: {ERROR}", "ERROR",
+                       strerror(errno));
+            return;
+        }
+
+        if (fds[1].revents)
+        {
+            return;
+        }
+
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        std::string json = toJson();
+        size_t written = 0;
+
+        while (written < json.size())
+        {
+            ssize_t n = send(fd, json.data() + written, json.size() - written,
+                             MSG_NOSIGNAL);
+
+            if (n <= 0)
+            {
+                break;
+            }
+
+            written += n;
+        }
+
+        close(fd);
+    }
+}
+
+} // namespace ikvm
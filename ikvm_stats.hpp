@@ -0,0 +1,289 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+namespace ikvm
+{
+
+/*
+ * @class Histogram
+ * @brief Lock-free histogram of durations with log-linear buckets, each
+ *        power of two split into 16 buckets so that values are kept within
+ *        6.25% over the whole range
+ */
+class Histogram
+{
+  public:
+    Histogram();
+    ~Histogram() = default;
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+    Histogram(Histogram&&) = delete;
+    Histogram& operator=(Histogram&&) = delete;
+
+    /*
+     * @brief Adds a value; safe to call from any number of threads
+     *
+     * @param[in] value - Value to add
+     */
+    void record(uint64_t value);
+    /* @brief Removes all values */
+    void reset();
+
+    /*
+     * @brief Gets the number of values added
+     *
+     * @return Number of values
+     */
+    uint64_t getCount() const;
+    /*
+     * @brief Gets the mean of the values added
+     *
+     * @return Mean value, 0 if empty
+     */
+    double getMean() const;
+    /*
+     * @brief Gets the largest value added
+     *
+     * @return Maximum value
+     */
+    uint64_t getMax() const;
+    /*
+     * @brief Gets the value below which a fraction of the values fall
+     *
+     * @param[in] fraction - Fraction of the values, between 0 and 1
+     *
+     * @return Upper bound of the bucket holding the percentile, 0 if empty
+     */
+    uint64_t getPercentile(double fraction) const;
+
+    /*
+     * @brief Gets the bucket holding a value
+     *
+     * @param[in] value - Value to look up
+     *
+     * @return Index of the bucket
+     */
+    static size_t bucketIndex(uint64_t value);
+    /*
+     * @brief Gets the largest value held by a bucket
+     *
+     * @param[in] index - Index of the bucket
+     *
+     * @return Upper bound of the bucket
+     */
+    static uint64_t bucketLimit(size_t index);
+
+    /* @brief Number of bits of a value kept below its most significant */
+    static constexpr int subBucketBits = 4;
+    /* @brief Number of buckets per power of two */
+    static constexpr size_t subBuckets = 1 << subBucketBits;
+    /* @brief Number of buckets covering all 64 bit values */
+    static constexpr size_t buckets = (64 - subBucketBits + 1) * subBuckets;
+
+  private:
+    /* @brief Number of values in each bucket */
+    std::array<std::atomic<uint64_t>, buckets> counts;
+    /* @brief Number of values added */
+    std::atomic<uint64_t> count;
+    /* @brief Sum of the values added */
+    std::atomic<uint64_t> sum;
+    /* @brief Largest value added */
+    std::atomic<uint64_t> max;
+};
+
+/*
+ * @class Stats
+ * @brief Per-stage frame latency histograms, frame counters and gauges,
+ *        served as JSON on a Unix socket
+ *
+ * The stages of a frame, each recorded in microseconds, are:
+ *   capture - from the capture timestamp to the frame being dequeued
+ *   crc     - calculating the checksum of identical frames detection
+ *   queue   - from the frame being dequeued to sending it to a client
+ *   send    - sending the frame to a client
+ *   total   - from the capture timestamp to the frame sent to a client
+ *   input   - from a client input event to the next changed frame sent
+ *   pacing  - from a frame deadline to the capture waking up for it
+ */
+class Stats
+{
+  public:
+    /* @brief Stages of a frame from capture to client */
+    enum class Stage
+    {
+        capture,
+        crc,
+        queue,
+        send,
+        total,
+        input,
+        pacing,
+        count,
+    };
+
+    /* @brief Frame counters */
+    enum class Counter
+    {
+        frames,
+        sent,
+        dropped,
+        skippedCrc,
+        errors,
+        restarts,
+        noSignalMs,
+        lateFrames,
+        throttled,
+        rejected,
+        degraded,
+        count,
+    };
+
+    /* @brief Values sampled as they change */
+    enum class Gauge
+    {
+        fps,
+        count,
+    };
+
+    Stats();
+    ~Stats();
+    Stats(const Stats&) = delete;
+    Stats& operator=(const Stats&) = delete;
+    Stats(Stats&&) = delete;
+    Stats& operator=(Stats&&) = delete;
+
+    /*
+     * @brief Starts recording and serving the statistics on a Unix socket;
+     *        every connection receives the current statistics and is closed
+     *
+     * @param[in] path - Path of the socket
+     */
+    void serve(const std::string& path);
+
+    /*
+     * @brief Records the duration of a stage if enabled
+     *
+     * @param[in] stage    - Stage of the frame
+     * @param[in] duration - Time taken by the stage
+     */
+    inline void record(Stage stage,
+                       std::chrono::steady_clock::duration duration)
+    {
+        if (enabled)
+        {
+            stages[(size_t)stage].record(
+                std::chrono::duration_cast<std::chrono::microseconds>(duration)
+                    .count());
+        }
+    }
+
+    /*
+     * @brief Increments a counter if enabled
+     *
+     * @param[in] counter - Counter to increment
+     * @param[in] n       - Value to add
+     */
+    inline void increment(Counter counter, uint64_t n = 1)
+    {
+        if (enabled)
+        {
+            counters[(size_t)counter].fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+
+    /*
+     * @brief Sets a gauge if enabled
+     *
+     * @param[in] gauge - Gauge to set
+     * @param[in] value - Current value
+     */
+    inline void set(Gauge gauge, double value)
+    {
+        if (enabled)
+        {
+            gauges[(size_t)gauge].store(value, std::memory_order_relaxed);
+        }
+    }
+
+    /*
+     * @brief Gets whether or not statistics are recorded
+     *
+     * @return Boolean indicating if statistics are enabled
+     */
+    inline bool isEnabled() const
+    {
+        return enabled;
+    }
+
+    /*
+     * @brief Gets a counter
+     *
+     * @param[in] counter - Counter to get
+     *
+     * @return Value of the counter
+     */
+    inline uint64_t get(Counter counter) const
+    {
+        return counters[(size_t)counter].load(std::memory_order_relaxed);
+    }
+
+    /*
+     * @brief Gets a gauge
+     *
+     * @param[in] gauge - Gauge to get
+     *
+     * @return Last value of the gauge
+     */
+    inline double get(Gauge gauge) const
+    {
+        return gauges[(size_t)gauge].load(std::memory_order_relaxed);
+    }
+
+    /*
+     * @brief Gets the histogram of a stage
+     *
+     * @param[in] stage - Stage of the frame
+     *
+     * @return Reference to the histogram
+     */
+    inline const Histogram& get(Stage stage) const
+    {
+        return stages[(size_t)stage];
+    }
+
+    /*
+     * @brief Formats the statistics
+     *
+     * @return JSON object of the counters, gauges and stage percentiles
+     */
+    std::string toJson() const;
+
+  private:
+    /* @brief Accepts connections and writes the statistics to them */
+    void serverThread();
+
+    /* @brief Boolean to indicate whether statistics are recorded */
+    bool enabled;
+    /* @brief File descriptor of the listening socket */
+    int listenFd;
+    /* @brief Pipe to stop the server thread */
+    int stopFds[2];
+    /* @brief Path of the listening socket */
+    std::string socketPath;
+    /* @brief Thread serving the statistics */
+    std::thread server;
+    /* @brief Histograms of the frame stages */
+    std::array<Histogram, (size_t)Stage::count> stages;
+    /* @brief Frame counters */
+    std::array<std::atomic<uint64_t>, (size_t)Counter::count> counters;
+    /* @brief Gauges */
+    std::array<std::atomic<double>, (size_t)Gauge::count> gauges;
+};
+
+} // namespace ikvm
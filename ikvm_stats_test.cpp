@@ -0,0 +1,146 @@
+#include "ikvm_stats.hpp"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace ikvm
+{
+
+TEST(HistogramTest, BucketsCoverValues)
+{
+    // Small values have a bucket each
+    for (uint64_t v = 0; v < Histogram::subBuckets; ++v)
+    {
+        EXPECT_EQ(Histogram::bucketIndex(v), v);
+        EXPECT_EQ(Histogram::bucketLimit(v), v);
+    }
+
+    // Larger values are within a sixteenth of their bucket limit
+    for (uint64_t v : {16ull, 17ull, 31ull, 32ull, 33ull, 1000ull, 33333ull,
+                       1ull << 40, ~0ull})
+    {
+        size_t i = Histogram::bucketIndex(v);
+        uint64_t limit = Histogram::bucketLimit(i);
+
+        ASSERT_LT(i, Histogram::buckets);
+        EXPECT_GE(limit, v);
+        EXPECT_LE(limit - v, v / 16);
+        EXPECT_LT(Histogram::bucketLimit(i - 1), v);
+    }
+
+    EXPECT_EQ(Histogram::bucketIndex(~0ull), Histogram::buckets - 1);
+}
+
+TEST(HistogramTest, Percentiles)
+{
+    Histogram h;
+
+    EXPECT_EQ(h.getPercentile(0.5), 0u);
+
+    for (uint64_t v = 1; v <= 1000; ++v)
+    {
+        h.record(v);
+    }
+
+    EXPECT_EQ(h.getCount(), 1000u);
+    EXPECT_DOUBLE_EQ(h.getMean(), 500.5);
+    EXPECT_EQ(h.getMax(), 1000u);
+    EXPECT_NEAR(h.getPercentile(0.5), 500, 500 / 16);
+    EXPECT_NEAR(h.getPercentile(0.99), 990, 990 / 16);
+    EXPECT_EQ(h.getPercentile(1.0), 1000u);
+
+    h.reset();
+    EXPECT_EQ(h.getCount(), 0u);
+    EXPECT_EQ(h.getMax(), 0u);
+}
+
+TEST(HistogramTest, ConcurrentRecording)
+{
+    Histogram h;
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&h, t]() {
+            for (uint64_t v = 0; v < 100000; ++v)
+            {
+                h.record(v % 100 + t);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_EQ(h.getCount(), 400000u);
+    EXPECT_EQ(h.getMax(), 102u);
+}
+
+TEST(StatsTest, DisabledUntilServed)
+{
+    Stats stats;
+
+    stats.increment(Stats::Counter::frames);
+    stats.record(Stats::Stage::total, std::chrono::milliseconds(5));
+
+    EXPECT_FALSE(stats.isEnabled());
+    EXPECT_EQ(stats.get(Stats::Counter::frames), 0u);
+    EXPECT_EQ(stats.get(Stats::Stage::total).getCount(), 0u);
+}
+
+TEST(StatsTest, ServesJson)
+{
+    std::string path = (std::filesystem::temp_directory_path() /
+                        ("ikvm_stats_test." + std::to_string(getpid())))
+                           .string();
+
+    {
+        Stats stats;
+
+        stats.serve(path);
+        ASSERT_TRUE(stats.isEnabled());
+
+        stats.increment(Stats::Counter::frames, 3);
+        stats.increment(Stats::Counter::skippedCrc);
+        stats.record(Stats::Stage::send, std::chrono::microseconds(250));
+        stats.set(Stats::Gauge::fps, 29.5);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr{};
+        std::string json;
+        char buf[256];
+        ssize_t n;
+
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path.c_str());
+        ASSERT_EQ(connect(fd, (sockaddr*)&addr, sizeof(addr)), 0);
+        while ((n = read(fd, buf, sizeof(buf))) > 0)
+        {
+            json.append(buf, n);
+        }
+        close(fd);
+
+        EXPECT_EQ(json, stats.toJson());
+        EXPECT_NE(json.find("\"frames\":3"), std::string::npos);
+        EXPECT_NE(json.find("\"skipped_crc\":1"), std::string::npos);
+        EXPECT_NE(json.find("\"gauges\":{\"fps\":29.5}"), std::string::npos);
+        EXPECT_NE(json.find("\"send\":{\"count\":1,\"mean\":250"),
+                  std::string::npos);
+    }
+
+    // The socket is removed when stopped
+    EXPECT_FALSE(std::filesystem::exists(path));
+}
+
+} // namespace ikvm
@@ -0,0 +1,340 @@
+#include "ikvm_tls.hpp"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <rfb/rfbproto.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <memory>
+
+#include <openssl/err.h>
+#include <phosphor-logging/elog-errors.hpp>
+#include <phosphor-logging/elog.hpp>
+#include <phosphor-logging/lg2.hpp>
+#include <xyz/openbmc_project/Common/File/error.hpp>
+
+namespace ikvm
+{
+
+using namespace phosphor::logging;
+using namespace sdbusplus::xyz::openbmc_project::Common::File::Error;
+
+// Gets the description of the last OpenSSL error and clears the queue
+static std::string sslError()
+{
+    char buf[256] = "";
+    unsigned long err = ERR_get_error();
+
+    if (err)
+    {
+        ERR_error_string_n(err, buf, sizeof(buf));
+    }
+    ERR_clear_error();
+
+    return buf;
+}
+
+// Waits for a non-blocking socket to be ready until the deadline
+static bool waitFor(int fd, short events,
+                    std::chrono::steady_clock::time_point deadline)
+{
+    struct pollfd pfd = {fd, events, 0};
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+
+    return left.count() > 0 && poll(&pfd, 1, left.count()) > 0;
+}
+
+static bool readExact(int fd, void* buf, size_t len,
+                      std::chrono::steady_clock::time_point deadline)
+{
+    char* data = (char*)buf;
+
+    while (len)
+    {
+        ssize_t n = read(fd, data, len);
+
+        if (n > 0)
+        {
+            data += n;
+            len -= n;
+        }
+        else if (!n || (errno != EAGAIN && errno != EINTR) ||
+                 !waitFor(fd, POLLIN, deadline))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool writeExact(int fd, const void* buf, size_t len,
+                       std::chrono::steady_clock::time_point deadline)
+{
+    const char* data = (const char*)buf;
+
+    while (len)
+    {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+
+        if (n > 0)
+        {
+            data += n;
+            len -= n;
+        }
+        else if (n < 0 && (errno == EAGAIN || errno == EINTR) &&
+                 waitFor(fd, POLLOUT, deadline))
+        {
+            continue;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Sends a status of the security handshake, then the reason of a failure
+static bool writeResult(int fd, uint32_t status, const std::string& reason,
+                        std::chrono::steady_clock::time_point deadline)
+{
+    uint32_t msg[2] = {htonl(status), htonl(reason.size())};
+
+    if (reason.empty())
+    {
+        return writeExact(fd, msg, sizeof(msg[0]), deadline);
+    }
+
+    return writeExact(fd, msg, sizeof(msg), deadline) &&
+           writeExact(fd, reason.data(), reason.size(), deadline);
+}
+
+Tls::Tls(const std::string& certPath, const std::string& keyPath) :
+    ctx(SSL_CTX_new(TLS_server_method()))
+{
+    if (!ctx ||
+        SSL_CTX_use_certificate_chain_file(ctx, certPath.c_str()) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ctx, keyPath.c_str(), SSL_FILETYPE_PEM) !=
+            1 ||
+        SSL_CTX_check_private_key(ctx) != 1)
+    {
+        lg2::error("Failed to load the TLS certificate {PATH}: {ERROR}",
+                   "PATH", certPath, "ERROR", sslError());
+        SSL_CTX_free(ctx);
+        elog<Open>(
+            xyz::openbmc_project::Common::File::Open::ERRNO(EINVAL),
+            xyz::openbmc_project::Common::File::Open::PATH(certPath.c_str()));
+    }
+
+    // Only TLS 1.2 is offered, limited to the ciphers the kernel implements.
+    // Once the kernel has the keys, nothing handles the control records
+    // that TLS 1.3 sends within a session, like key updates, which would
+    // fail the reads. Renegotiation and session tickets, which the kernel
+    // can't handle either, are disabled. The only control records left are
+    // alerts, which end the session anyway
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+    SSL_CTX_set_cipher_list(ctx, kernelCiphers);
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS | SSL_OP_NO_RENEGOTIATION |
+                                 SSL_OP_NO_TICKET);
+    SSL_CTX_set_num_tickets(ctx, 0);
+}
+
+Tls::~Tls()
+{
+    SSL_CTX_free(ctx);
+}
+
+int Tls::negotiate(int fd, bool allowNone)
+{
+    auto deadline = std::chrono::steady_clock::now() + negotiationTimeout;
+    char version[sz_rfbProtocolVersionMsg + 1] = "";
+    uint8_t types[3] = {1, securityType};
+    uint8_t type;
+    int major;
+    int minor;
+
+    if (!readExact(fd, version, sz_rfbProtocolVersionMsg, deadline))
+    {
+        return 0;
+    }
+
+    if (sscanf(version, rfbProtocolVersionFormat, &major, &minor) != 2 ||
+        major != rfbProtocolMajorVersion)
+    {
+        lg2::info("Unsupported RFB protocol version {VERSION}", "VERSION",
+                  std::string(version, strcspn(version, "\n")));
+        return 0;
+    }
+
+    // As libvncserver does, later versions are spoken as 3.8, and versions
+    // before 3.7 as 3.3, where the server chooses the security type
+    minor = minor >= 8 ? 8 : minor == 7 ? 7 : 3;
+    if (minor == 3)
+    {
+        if (!allowNone)
+        {
+            writeResult(fd, rfbSecTypeInvalid, "VeNCrypt is required",
+                        deadline);
+            return 0;
+        }
+
+        return writeResult(fd, rfbSecTypeNone, "", deadline) ? minor : 0;
+    }
+
+    if (allowNone)
+    {
+        types[0] = 2;
+        types[1] = rfbSecTypeNone;
+        types[2] = securityType;
+    }
+
+    if (!writeExact(fd, types, types[0] + 1, deadline) ||
+        !readExact(fd, &type, sizeof(type), deadline))
+    {
+        return 0;
+    }
+
+    if (type == rfbSecTypeNone && allowNone)
+    {
+        // RFB 3.7 clients aren't sent a result for the None security type,
+        // unlike for any other
+        return (minor < 8 || writeResult(fd, rfbVncAuthOK, "", deadline))
+                   ? minor
+                   : 0;
+    }
+
+    if (type != securityType)
+    {
+        lg2::info("Refusing security type {TYPE} without VeNCrypt", "TYPE",
+                  type);
+        // The reason of a failure was added in RFB 3.8
+        writeResult(fd, rfbVncAuthFailed,
+                    minor >= 8 ? "VeNCrypt is required" : "", deadline);
+        return 0;
+    }
+
+    // From here on the kernel encrypts what is written. There is no
+    // authentication inside the tunnel
+    if (!vencrypt(fd, deadline) ||
+        !writeResult(fd, rfbVncAuthOK, "", deadline))
+    {
+        return 0;
+    }
+
+    return minor;
+}
+
+bool Tls::vencrypt(int fd, std::chrono::steady_clock::time_point deadline)
+{
+    uint8_t version[2] = {0, 2};
+    uint8_t clientVersion[2];
+    uint8_t subtypes[6] = {0, 1};
+    uint32_t subtype = htonl(x509None);
+    uint8_t accepted = 1;
+
+    memcpy(&subtypes[2], &subtype, sizeof(subtype));
+
+    if (!writeExact(fd, version, sizeof(version), deadline) ||
+        !readExact(fd, clientVersion, sizeof(clientVersion), deadline))
+    {
+        return false;
+    }
+
+    if (clientVersion[0] != version[0] || clientVersion[1] != version[1])
+    {
+        uint8_t unsupported = 0xff;
+
+        lg2::info("Unsupported VeNCrypt version {MAJOR}.{MINOR}", "MAJOR",
+                  clientVersion[0], "MINOR", clientVersion[1]);
+        writeExact(fd, &unsupported, sizeof(unsupported), deadline);
+        return false;
+    }
+
+    if (!writeExact(fd, subtypes, sizeof(subtypes), deadline) ||
+        !readExact(fd, &subtype, sizeof(subtype), deadline))
+    {
+        return false;
+    }
+
+    if (ntohl(subtype) != x509None)
+    {
+        lg2::info("Unsupported VeNCrypt subtype {SUBTYPE}", "SUBTYPE",
+                  ntohl(subtype));
+        return false;
+    }
+
+    if (!writeExact(fd, &accepted, sizeof(accepted), deadline))
+    {
+        return false;
+    }
+
+    return handshake(fd, deadline);
+}
+
+bool Tls::handshake(int fd, std::chrono::steady_clock::time_point deadline)
+{
+    std::unique_ptr<SSL, decltype(&SSL_free)> ssl(SSL_new(ctx), SSL_free);
+    int rc;
+
+    if (!ssl || SSL_set_fd(ssl.get(), fd) != 1)
+    {
+        lg2::error("Failed to start the TLS handshake: {ERROR}", "ERROR",
+                   sslError());
+        return false;
+    }
+
+    // libvncserver's sockets are non-blocking
+    while ((rc = SSL_accept(ssl.get())) != 1)
+    {
+        int err = SSL_get_error(ssl.get(), rc);
+
+        if (err != SSL_ERROR_WANT_READ && err != SSL_ERROR_WANT_WRITE)
+        {
+            lg2::info("TLS handshake failed: {ERROR}", "ERROR", sslError());
+            return false;
+        }
+
+        if (!waitFor(fd, err == SSL_ERROR_WANT_READ ? POLLIN : POLLOUT,
+                     deadline))
+        {
+            lg2::info("TLS handshake timed out");
+            return false;
+        }
+    }
+
+    // OpenSSL attaches the socket to the tls upper layer protocol and gives
+    // it the keys once they are known; libvncserver can't go through
+    // OpenSSL, so both directions must have been taken by the kernel
+    if (!BIO_get_ktls_send(SSL_get_wbio(ssl.get())) ||
+        !BIO_get_ktls_recv(SSL_get_rbio(ssl.get())))
+    {
+        lg2::error("Kernel TLS isn't available for {VERSION} {CIPHER}",
+                   "VERSION", SSL_get_version(ssl.get()), "CIPHER",
+                   SSL_get_cipher_name(ssl.get()));
+        return false;
+    }
+
+    if (SSL_has_pending(ssl.get()))
+    {
+        lg2::error("Client sent data during the TLS handshake");
+        return false;
+    }
+
+    lg2::info("TLS session established with {VERSION} {CIPHER}", "VERSION",
+              SSL_get_version(ssl.get()), "CIPHER",
+              SSL_get_cipher_name(ssl.get()));
+
+    // Freed without a shutdown, the socket isn't closed and keeps the
+    // kernel's session
+    return true;
+}
+
+} // namespace ikvm
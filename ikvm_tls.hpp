@@ -0,0 +1,92 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include <openssl/ssl.h>
+
+namespace ikvm
+{
+
+/*
+ * @class Tls
+ * @brief Negotiates VeNCrypt with the clients and hands the TLS sessions to
+ *        kernel TLS
+ *
+ * The protocol version and security handshakes run on behalf of
+ * libvncserver, off the server thread. The TLS handshake runs in userspace,
+ * then the session keys are given to the socket, so that libvncserver keeps
+ * reading and writing it as before and the kernel encrypts the frames in
+ * place rather than in another copy.
+ */
+class Tls
+{
+  public:
+    /*
+     * @brief Constructs Tls object
+     *
+     * @param[in] certPath - Path to the PEM certificate chain of the server
+     * @param[in] keyPath  - Path to the PEM private key of the server
+     */
+    Tls(const std::string& certPath, const std::string& keyPath);
+    ~Tls();
+    Tls(const Tls&) = delete;
+    Tls& operator=(const Tls&) = delete;
+    Tls(Tls&&) = delete;
+    Tls& operator=(Tls&&) = delete;
+
+    /*
+     * @brief Reads the protocol version of a client that was sent the
+     *        server's, then offers it VeNCrypt and runs the handshakes of
+     *        the subtype it chooses; blocks until the client is through or
+     *        the negotiation times out
+     *
+     * @param[in] fd        - Socket of the client
+     * @param[in] allowNone - Also offer the None security type
+     *
+     * @return Minor RFB protocol version agreed with the client, 0 if it
+     *         was refused
+     */
+    int negotiate(int fd, bool allowNone);
+    /*
+     * @brief Runs the TLS handshake on a socket and gives the session keys
+     *        of both directions to the kernel
+     *
+     * @param[in] fd       - Connected TCP socket, blocking or not
+     * @param[in] deadline - Time by which the handshake must be complete
+     *
+     * @return Boolean indicating if the kernel now encrypts the connection
+     */
+    bool handshake(int fd, std::chrono::steady_clock::time_point deadline);
+
+    /* @brief RFB security type of VeNCrypt */
+    static constexpr uint8_t securityType = 19;
+    /* @brief Longest time given to a client for the negotiation */
+    static constexpr std::chrono::seconds negotiationTimeout{5};
+
+  private:
+    /*
+     * @brief Negotiates the VeNCrypt X509None subtype with a client that
+     *        chose VeNCrypt, then runs the TLS handshake
+     *
+     * @param[in] fd       - Socket of the client
+     * @param[in] deadline - Time by which the negotiation must be complete
+     *
+     * @return Boolean indicating if the kernel now encrypts the connection
+     */
+    bool vencrypt(int fd, std::chrono::steady_clock::time_point deadline);
+
+    /* @brief VeNCrypt subtype of TLS with a certificate and no password */
+    static constexpr uint32_t x509None = 260;
+    /* @brief TLS 1.2 cipher suites with kernel TLS support */
+    static constexpr char kernelCiphers[] =
+        "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:"
+        "ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384:"
+        "ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305";
+
+    /* @brief OpenSSL context holding the certificate and key */
+    SSL_CTX* ctx;
+};
+
+} // namespace ikvm
@@ -0,0 +1,347 @@
+#include "ikvm_tls.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+namespace fs = std::filesystem;
+
+namespace ikvm
+{
+
+class TlsTest : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        dir = fs::temp_directory_path() /
+              ("ikvm_tls_test." + std::to_string(getpid()));
+        fs::create_directories(dir);
+        certPath = (dir / "cert.pem").string();
+        keyPath = (dir / "key.pem").string();
+        writeCertificate();
+
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_GE(listener, 0);
+
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ASSERT_EQ(bind(listener, (sockaddr*)&addr, sizeof(addr)), 0);
+        ASSERT_EQ(listen(listener, 1), 0);
+        ASSERT_EQ(getsockname(listener, (sockaddr*)&addr, &len), 0);
+        port = ntohs(addr.sin_port);
+    }
+
+    void TearDown() override
+    {
+        close(listener);
+        fs::remove_all(dir);
+    }
+
+    // Writes a self-signed P-256 certificate and its key
+    void writeCertificate()
+    {
+        EVP_PKEY* key = EVP_EC_gen("P-256");
+        X509* cert = X509_new();
+        X509_NAME* name = X509_get_subject_name(cert);
+
+        ASSERT_NE(key, nullptr);
+        X509_set_version(cert, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+        X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+        X509_set_pubkey(cert, key);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                                   (const unsigned char*)"localhost", -1, -1,
+                                   0);
+        X509_set_issuer_name(cert, name);
+        X509_sign(cert, key, EVP_sha256());
+
+        FILE* file = fopen(certPath.c_str(), "w");
+
+        PEM_write_X509(file, cert);
+        fclose(file);
+        file = fopen(keyPath.c_str(), "w");
+        PEM_write_PrivateKey(file, key, nullptr, nullptr, 0, nullptr,
+                             nullptr);
+        fclose(file);
+
+        X509_free(cert);
+        EVP_PKEY_free(key);
+    }
+
+    int dial()
+    {
+        sockaddr_in addr{};
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (connect(fd, (sockaddr*)&addr, sizeof(addr)))
+        {
+            close(fd);
+            return -1;
+        }
+
+        return fd;
+    }
+
+    // Gets the deadline of a handshake starting now
+    static std::chrono::steady_clock::time_point deadline()
+    {
+        return std::chrono::steady_clock::now() + Tls::negotiationTimeout;
+    }
+
+    // Gets whether the kernel has the tls upper layer protocol
+    bool kernelTls()
+    {
+        int client = dial();
+        int server = accept(listener, nullptr, nullptr);
+        bool available = !setsockopt(server, IPPROTO_TCP, TCP_ULP, "tls",
+                                     sizeof("tls"));
+
+        close(server);
+        close(client);
+
+        return available;
+    }
+
+    fs::path dir;
+    std::string certPath;
+    std::string keyPath;
+    int listener;
+    uint16_t port;
+};
+
+TEST_F(TlsTest, InvalidCertificate)
+{
+    EXPECT_ANY_THROW(Tls(certPath + ".missing", keyPath));
+    EXPECT_ANY_THROW(Tls(keyPath, keyPath));
+}
+
+TEST_F(TlsTest, NotTls)
+{
+    Tls tls(certPath, keyPath);
+    int client = dial();
+    int server = accept(listener, nullptr, nullptr);
+
+    ASSERT_EQ(write(client, "RFB 003.008\n", 12), 12);
+    EXPECT_FALSE(tls.handshake(server, deadline()));
+
+    close(server);
+    close(client);
+}
+
+TEST_F(TlsTest, RefusesNone)
+{
+    Tls tls(certPath, keyPath);
+    int client = dial();
+    int server = accept(listener, nullptr, nullptr);
+    uint8_t types[2] = {};
+    uint32_t result[2] = {};
+
+    // The choice is sent ahead of the offer, as a client could
+    ASSERT_EQ(write(client, "RFB 003.008\n\1", 13), 13);
+    EXPECT_EQ(tls.negotiate(server, false), 0);
+
+    ASSERT_EQ(read(client, types, sizeof(types)), 2);
+    EXPECT_EQ(types[0], 1);
+    EXPECT_EQ(types[1], Tls::securityType);
+    ASSERT_EQ(read(client, result, sizeof(result)), 8);
+    EXPECT_EQ(ntohl(result[0]), 1u);
+    EXPECT_GT(ntohl(result[1]), 0u);
+
+    close(server);
+    close(client);
+}
+
+TEST_F(TlsTest, RefusesNoneVersion37)
+{
+    Tls tls(certPath, keyPath);
+    int client = dial();
+    int server = accept(listener, nullptr, nullptr);
+    uint8_t types[2] = {};
+    uint32_t result[2] = {};
+
+    // RFB 3.7 clients are sent the failure without a reason
+    ASSERT_EQ(write(client, "RFB 003.007\n\1", 13), 13);
+    EXPECT_EQ(tls.negotiate(server, false), 0);
+    close(server);
+
+    ASSERT_EQ(read(client, types, sizeof(types)), 2);
+    EXPECT_EQ(types[1], Tls::securityType);
+    ASSERT_EQ(read(client, result, sizeof(result)), 4);
+    EXPECT_EQ(ntohl(result[0]), 1u);
+
+    close(client);
+}
+
+TEST_F(TlsTest, AllowsNone)
+{
+    Tls tls(certPath, keyPath);
+    int client = dial();
+    int server = accept(listener, nullptr, nullptr);
+    uint8_t types[3] = {};
+    uint32_t result = 1;
+
+    ASSERT_EQ(write(client, "RFB 003.008\n\1", 13), 13);
+    EXPECT_EQ(tls.negotiate(server, true), 8);
+
+    ASSERT_EQ(read(client, types, sizeof(types)), 3);
+    EXPECT_EQ(types[0], 2);
+    EXPECT_EQ(types[1], 1);
+    EXPECT_EQ(types[2], Tls::securityType);
+    ASSERT_EQ(read(client, &result, sizeof(result)), 4);
+    EXPECT_EQ(result, 0u);
+
+    close(server);
+    close(client);
+}
+
+TEST_F(TlsTest, Version33)
+{
+    Tls tls(certPath, keyPath);
+    int client = dial();
+    int server = accept(listener, nullptr, nullptr);
+    uint32_t type = 1;
+
+    // RFB 3.3 clients are told the security type, which can't be VeNCrypt
+    ASSERT_EQ(write(client, "RFB 003.003\n", 12), 12);
+    EXPECT_EQ(tls.negotiate(server, false), 0);
+    ASSERT_EQ(read(client, &type, sizeof(type)), 4);
+    EXPECT_EQ(type, 0u);
+
+    close(server);
+    close(client);
+}
+
+TEST_F(TlsTest, VeNCryptVersion37)
+{
+    bool available = kernelTls();
+    Tls tls(certPath, keyPath);
+    int client = dial();
+    int server = accept(listener, nullptr, nullptr);
+    SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+    SSL* ssl = SSL_new(ctx);
+    uint32_t result = 1;
+    bool connected = false;
+    std::thread peer([&]() {
+        uint8_t types[2];
+        uint8_t version[2];
+        uint8_t subtypes[6];
+        uint32_t subtype = htonl(260); // X509None
+        uint8_t accepted;
+
+        if (write(client, "RFB 003.007\n", 12) != 12 ||
+            read(client, types, sizeof(types)) != 2 ||
+            write(client, &types[1], 1) != 1 ||
+            read(client, version, sizeof(version)) != 2 ||
+            write(client, version, sizeof(version)) != 2 ||
+            read(client, subtypes, sizeof(subtypes)) != 6 ||
+            write(client, &subtype, sizeof(subtype)) != 4 ||
+            read(client, &accepted, sizeof(accepted)) != 1)
+        {
+            return;
+        }
+
+        SSL_set_fd(ssl, client);
+        connected = SSL_connect(ssl) == 1;
+    });
+
+    // The client waits for the result of VeNCrypt, even in RFB 3.7
+    EXPECT_EQ(tls.negotiate(server, false), available ? 7 : 0);
+    peer.join();
+    EXPECT_TRUE(connected);
+
+    if (available)
+    {
+        EXPECT_EQ(SSL_read(ssl, &result, sizeof(result)), 4);
+        EXPECT_EQ(result, 0u);
+    }
+
+    SSL_free(ssl);
+    SSL_CTX_free(ctx);
+    close(server);
+    close(client);
+
+    if (!available)
+    {
+        GTEST_SKIP() << "kernel TLS isn't available";
+    }
+}
+
+TEST_F(TlsTest, TimesOut)
+{
+    Tls tls(certPath, keyPath);
+    int client = dial();
+    int server = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK);
+
+    // libvncserver's sockets are non-blocking
+    EXPECT_FALSE(tls.handshake(server, std::chrono::steady_clock::now() +
+                                           std::chrono::milliseconds(50)));
+
+    close(server);
+    close(client);
+}
+
+TEST_F(TlsTest, KernelEncrypts)
+{
+    bool available = kernelTls();
+    Tls tls(certPath, keyPath);
+    int client = dial();
+    int server = accept(listener, nullptr, nullptr);
+    SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+    SSL* ssl = SSL_new(ctx);
+    bool connected = false;
+    std::thread peer([&]() {
+        SSL_set_fd(ssl, client);
+        connected = SSL_connect(ssl) == 1;
+    });
+
+    // Sessions the kernel can't take are refused
+    EXPECT_EQ(tls.handshake(server, deadline()), available);
+    peer.join();
+    EXPECT_TRUE(connected);
+
+    if (available)
+    {
+        // The server side reads and writes the socket in the clear
+        char buf[16] = {};
+
+        ASSERT_EQ(write(server, "frame", 5), 5);
+        EXPECT_EQ(SSL_read(ssl, buf, sizeof(buf)), 5);
+        EXPECT_STREQ(buf, "frame");
+
+        ASSERT_EQ(SSL_write(ssl, "input", 5), 5);
+        EXPECT_EQ(read(server, buf, sizeof(buf)), 5);
+        EXPECT_EQ(std::string(buf, 5), "input");
+    }
+
+    SSL_free(ssl);
+    SSL_CTX_free(ctx);
+    close(server);
+    close(client);
+
+    if (!available)
+    {
+        GTEST_SKIP() << "kernel TLS isn't available";
+    }
+}
+
+} // namespace ikvm
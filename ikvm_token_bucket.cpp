@@ -0,0 +1,54 @@
+#include "ikvm_token_bucket.hpp"
+
+#include <algorithm>
+
+namespace ikvm
+{
+
+void TokenBucket::setRate(uint64_t bytesPerSecond)
+{
+    if (bytesPerSecond == rate)
+    {
+        return;
+    }
+
+    // An unlimited bucket starts a limit full
+    bool wasLimited = rate;
+
+    rate = bytesPerSecond;
+    tokens = wasLimited ? std::min(tokens, getDepth()) : getDepth();
+}
+
+bool TokenBucket::conforms(Clock::time_point now, double reserve)
+{
+    if (!rate)
+    {
+        return true;
+    }
+
+    if (lastRefill != Clock::time_point())
+    {
+        tokens = std::min(
+            tokens + std::chrono::duration<double>(now - lastRefill).count() *
+                         rate,
+            getDepth());
+    }
+    lastRefill = now;
+
+    return tokens >= reserve * getDepth();
+}
+
+void TokenBucket::consume(uint64_t bytes)
+{
+    if (rate)
+    {
+        tokens -= bytes;
+    }
+}
+
+double TokenBucket::getDepth() const
+{
+    return std::chrono::duration<double>(depth).count() * rate;
+}
+
+} // namespace ikvm
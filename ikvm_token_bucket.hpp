@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace ikvm
+{
+
+/*
+ * @class TokenBucket
+ * @brief Limits the bytes sent to a rate, allowing bursts of a quarter of a
+ *        second's worth
+ *
+ * A frame may be sent while the bucket isn't in debt, and its size is then
+ * taken from the bucket, which may go into debt for a frame larger than the
+ * bucket holds. Frames are skipped until the debt is paid back at the rate,
+ * so nothing is queued while over budget.
+ */
+class TokenBucket
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    TokenBucket() : rate(0), tokens(0.0) {}
+    ~TokenBucket() = default;
+    TokenBucket(const TokenBucket&) = default;
+    TokenBucket& operator=(const TokenBucket&) = default;
+    TokenBucket(TokenBucket&&) = default;
+    TokenBucket& operator=(TokenBucket&&) = default;
+
+    /*
+     * @brief Sets the rate; the bucket keeps its tokens up to the new depth
+     *
+     * @param[in] bytesPerSecond - Value of the rate, 0 for no limit
+     */
+    void setRate(uint64_t bytesPerSecond);
+    /*
+     * @brief Refills the bucket and gets whether a frame may be sent
+     *
+     * @param[in] now     - Current time
+     * @param[in] reserve - Fraction of a full bucket that must be left,
+     *                      kept for senders of higher priority
+     *
+     * @return Boolean indicating if the rate isn't limited or the bucket
+     *         holds the reserve, without debt
+     */
+    bool conforms(Clock::time_point now, double reserve = 0.0);
+    /*
+     * @brief Takes the bytes of a frame sent from the bucket
+     *
+     * @param[in] bytes - Number of bytes sent
+     */
+    void consume(uint64_t bytes);
+
+    /*
+     * @brief Gets the rate
+     *
+     * @return Value of the rate in bytes per second, 0 if not limited
+     */
+    inline uint64_t getRate() const
+    {
+        return rate;
+    }
+
+    /* @brief Time of sending at the rate the bucket holds when full */
+    static constexpr std::chrono::milliseconds depth{250};
+
+  private:
+    /*
+     * @brief Gets the tokens of a full bucket
+     *
+     * @return Number of bytes the bucket holds
+     */
+    double getDepth() const;
+
+    /* @brief Rate in bytes per second, 0 if not limited */
+    uint64_t rate;
+    /* @brief Bytes that may be sent, negative when in debt */
+    double tokens;
+    /* @brief Time of the last refill */
+    Clock::time_point lastRefill;
+};
+
+} // namespace ikvm
@@ -0,0 +1,91 @@
+#include "ikvm_token_bucket.hpp"
+
+#include <gtest/gtest.h>
+
+namespace ikvm
+{
+
+using namespace std::chrono_literals;
+
+TEST(TokenBucketTest, Unlimited)
+{
+    TokenBucket bucket;
+    TokenBucket::Clock::time_point now = TokenBucket::Clock::time_point() + 1s;
+
+    for (int i = 0; i < 10; ++i)
+    {
+        EXPECT_TRUE(bucket.conforms(now));
+        bucket.consume(1000000);
+    }
+}
+
+TEST(TokenBucketTest, SkipsUntilDebtIsPaid)
+{
+    TokenBucket bucket;
+    TokenBucket::Clock::time_point now = TokenBucket::Clock::time_point() + 1s;
+
+    // 100 kB/s holds 25 kB, a 50 kB frame puts it 25 kB in debt
+    bucket.setRate(100000);
+    EXPECT_TRUE(bucket.conforms(now));
+    bucket.consume(50000);
+    EXPECT_FALSE(bucket.conforms(now + 100ms));
+    EXPECT_FALSE(bucket.conforms(now + 240ms));
+    EXPECT_TRUE(bucket.conforms(now + 250ms));
+}
+
+TEST(TokenBucketTest, KeepsToRate)
+{
+    TokenBucket bucket;
+    TokenBucket::Clock::time_point now = TokenBucket::Clock::time_point() + 1s;
+    uint64_t sent = 0;
+
+    // 30 fps of 20 kB frames through 200 kB/s
+    bucket.setRate(200000);
+    for (int i = 0; i < 300; ++i)
+    {
+        if (bucket.conforms(now + i * 1000000us / 30))
+        {
+            bucket.consume(20000);
+            sent += 20000;
+        }
+    }
+
+    EXPECT_GE(sent, 2000000u);
+    EXPECT_LE(sent, 2000000u + 50000u + 20000u);
+}
+
+TEST(TokenBucketTest, Reserve)
+{
+    TokenBucket bucket;
+    TokenBucket::Clock::time_point now = TokenBucket::Clock::time_point() + 1s;
+
+    // Half of the 25 kB is kept once 15 kB are taken
+    bucket.setRate(100000);
+    EXPECT_TRUE(bucket.conforms(now, 0.5));
+    bucket.consume(15000);
+    EXPECT_FALSE(bucket.conforms(now, 0.5));
+    EXPECT_TRUE(bucket.conforms(now));
+    EXPECT_TRUE(bucket.conforms(now + 25ms, 0.5));
+}
+
+TEST(TokenBucketTest, RateChangeKeepsDebt)
+{
+    TokenBucket bucket;
+    TokenBucket::Clock::time_point now = TokenBucket::Clock::time_point() + 1s;
+
+    bucket.setRate(100000);
+    bucket.conforms(now);
+    bucket.consume(50000);
+    bucket.setRate(1000000);
+    EXPECT_FALSE(bucket.conforms(now));
+    EXPECT_TRUE(bucket.conforms(now + 25ms));
+
+    // Lifting the limit and setting it again starts full
+    bucket.consume(1000000);
+    bucket.setRate(0);
+    EXPECT_TRUE(bucket.conforms(now + 25ms));
+    bucket.setRate(100000);
+    EXPECT_TRUE(bucket.conforms(now + 25ms));
+}
+
+} // namespace ikvm
@@ -0,0 +1,17 @@
+#pragma once
+
+/*
+ * USDT probes of the obmc_ikvm provider for perf and bpftrace, listed with
+ * "bpftrace -l 'usdt:/usr/bin/obmc-ikvm:*'". Without sys/sdt.h the probes
+ * compile to nothing and their arguments aren't evaluated.
+ */
+#ifdef IKVM_USDT
+#include <sys/sdt.h>
+
+#define IKVM_PROBE(...) STAP_PROBEV(obmc_ikvm, __VA_ARGS__)
+#else
+#define IKVM_PROBE(...)                                                        \
+    do                                                                         \
+    {                                                                          \
+    } while (0)
+#endif
@@ -1,5 +1,8 @@
 #include "ikvm_video.hpp"
 
+#include "ikvm_flight_recorder.hpp"
+#include "ikvm_trace.hpp"
+
 #include <err.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -22,18 +25,13 @@
 namespace ikvm
 {
 
-int Video::bitsPerSample(8);
-int Video::bytesPerPixel(4);
-int Video::samplesPerPixel(3);
-
 using namespace phosphor::logging;
 using namespace sdbusplus::xyz::openbmc_project::Common::File::Error;
 using namespace sdbusplus::xyz::openbmc_project::Common::Device::Error;
 
 Video::Video(const std::string& p, Input& input, int fr, int sub) :
-    resizeAfterOpen(false), timingsError(false), fd(-1), frameRate(fr),
-    lastFrameIndex(-1), height(600), width(800), subSampling(sub), input(input),
-    path(p)
+    FrameSource(fr, sub), resizeAfterOpen(false), fd(-1),
+    lastFrameIndex(-1), input(input), path(p)
 {}
 
 Video::~Video()
@@ -45,6 +43,7 @@ void Video::probePixelFormat()
 {
     int rc;
     v4l2_format fmt;
+    v4l2_queryctrl qctrl;
 
     memset(&fmt, 0, sizeof(v4l2_format));
     fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -87,6 +86,21 @@ void Video::probePixelFormat()
         samplesPerPixel = 1;
     }
 
+    // The range depends on the driver, e.g. 0 to 11 for aspeed-video
+    memset(&qctrl, 0, sizeof(v4l2_queryctrl));
+    qctrl.id = V4L2_CID_JPEG_COMPRESSION_QUALITY;
+    if (ioctl(fd, VIDIOC_QUERYCTRL, &qctrl) == 0 &&
+        !(qctrl.flags & V4L2_CTRL_FLAG_DISABLED))
+    {
+        qualityMin = qctrl.minimum;
+        qualityMax = qctrl.maximum;
+    }
+    else
+    {
+        qualityMin = 0;
+        qualityMax = -1;
+    }
+
     close(fd);
     fd = -1;
 }
@@ -138,17 +152,38 @@ void Video::getFrame()
             rc = ioctl(fd, VIDIOC_DQBUF, &buf);
             if (rc >= 0)
             {
+                IKVM_PROBE(frame_dequeue, buf.index, buf.bytesused,
+                           buf.flags & V4L2_BUF_FLAG_ERROR);
+                FlightRecorder::record(
+                    FlightRecorder::Event::frameDequeue, buf.index,
+                    buf.bytesused, !!(buf.flags & V4L2_BUF_FLAG_ERROR));
                 buffers[buf.index].queued = false;
 
                 if (!(buf.flags & V4L2_BUF_FLAG_ERROR))
                 {
                     lastFrameIndex = buf.index;
                     buffers[lastFrameIndex].payload = buf.bytesused;
+                    dequeueTime = std::chrono::steady_clock::now();
+
+                    // The steady clock is the monotonic clock the driver
+                    // timestamps buffers with
+                    if ((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) ==
+                        V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+                    {
+                        captureTime = std::chrono::steady_clock::time_point(
+                            std::chrono::seconds(buf.timestamp.tv_sec) +
+                            std::chrono::microseconds(buf.timestamp.tv_usec));
+                    }
+                    else
+                    {
+                        captureTime = dequeueTime;
+                    }
                     break;
                 }
                 else
                 {
                     buffers[buf.index].payload = 0;
+                    errorCount++;
                 }
             }
         } while (rc >= 0);
@@ -178,6 +213,7 @@ void Video::getFrame()
             }
             else
             {
+                IKVM_PROBE(frame_requeue, i);
                 buffers[i].queued = true;
             }
         }
@@ -188,6 +224,8 @@ bool Video::needsResize()
 {
     int rc;
     v4l2_dv_timings timings;
+    std::chrono::steady_clock::time_point now;
+    std::chrono::steady_clock::duration outage;
 
     if (fd < 0)
     {
@@ -201,21 +239,35 @@ bool Video::needsResize()
 
     memset(&timings, 0, sizeof(v4l2_dv_timings));
     rc = ioctl(fd, VIDIOC_QUERY_DV_TIMINGS, &timings);
+    now = std::chrono::steady_clock::now();
     if (rc < 0)
     {
-        if (!timingsError)
+        FlightRecorder::record(FlightRecorder::Event::timingsError, errno);
+
+        if (signal.lost(now))
         {
-            lg2::error("Failed to query timings {ERROR}", "ERROR",
-                       strerror(errno));
-            timingsError = true;
+            lg2::error("Video signal lost {ERROR}", "ERROR", strerror(errno));
         }
 
-        restart();
+        // The streaming buffers are kept until the restarts are due, the
+        // driver may detect the signal again on its own
+        if (signal.retryDue(now))
+        {
+            retry(now);
+        }
         return false;
     }
-    else
+
+    outage = signal.getOutage(now);
+    if (signal.found(now))
     {
-        timingsError = false;
+        auto ms =
+            std::chrono::duration_cast<std::chrono::milliseconds>(outage)
+                .count();
+
+        FlightRecorder::record(FlightRecorder::Event::signalFound, ms,
+                               signal.getRestarts());
+        lg2::info("Video signal found after {DURATION} ms", "DURATION", ms);
     }
 
     if (timings.bt.width != width || timings.bt.height != height)
@@ -252,6 +304,9 @@ void Video::resize()
         return;
     }
 
+    IKVM_PROBE(video_resize, width, height);
+    FlightRecorder::record(FlightRecorder::Event::videoResize, width, height);
+
     if (resizeAfterOpen)
     {
         resizeAfterOpen = false;
@@ -316,9 +371,16 @@ void Video::resize()
         rc = ioctl(fd, VIDIOC_QUERY_DV_TIMINGS, &timings);
         if (rc < 0)
         {
+            auto now = std::chrono::steady_clock::now();
+
+            FlightRecorder::record(FlightRecorder::Event::timingsError, errno);
             lg2::error("Failed to query timings, restart {ERROR}", "ERROR",
                        strerror(errno));
-            restart();
+
+            // The buffers are already released, restart now but count it
+            // towards the backoff
+            signal.lost(now);
+            retry(now);
             return;
         }
 
@@ -427,8 +489,6 @@ void Video::start()
     size_t oldWidth = width;
     v4l2_capability cap;
     v4l2_format fmt;
-    v4l2_streamparm sparm;
-    v4l2_control ctrl;
 
     if (fd >= 0)
     {
@@ -483,25 +543,14 @@ void Video::start()
                 CALLOUT_DEVICE_PATH(path.c_str()));
     }
 
-    memset(&sparm, 0, sizeof(v4l2_streamparm));
-    sparm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    sparm.parm.capture.timeperframe.numerator = 1;
-    sparm.parm.capture.timeperframe.denominator = frameRate;
-    rc = ioctl(fd, VIDIOC_S_PARM, &sparm);
-    if (rc < 0)
+    setTimePerFrame();
+    setControl(V4L2_CID_JPEG_CHROMA_SUBSAMPLING,
+               subSampling ? V4L2_JPEG_CHROMA_SUBSAMPLING_420
+                           : V4L2_JPEG_CHROMA_SUBSAMPLING_444,
+               "subsampling");
+    if (quality >= 0)
     {
-        lg2::warning("Failed to set video device frame rate {ERROR}", "ERROR",
-                     strerror(errno));
-    }
-
-    ctrl.id = V4L2_CID_JPEG_CHROMA_SUBSAMPLING;
-    ctrl.value = subSampling ? V4L2_JPEG_CHROMA_SUBSAMPLING_420
-                             : V4L2_JPEG_CHROMA_SUBSAMPLING_444;
-    rc = ioctl(fd, VIDIOC_S_CTRL, &ctrl);
-    if (rc < 0)
-    {
-        lg2::warning("Failed to set video jpeg subsampling {ERROR}", "ERROR",
-                     strerror(errno));
+        setControl(V4L2_CID_JPEG_COMPRESSION_QUALITY, quality, "quality");
     }
 
     height = fmt.fmt.pix.height;
@@ -515,6 +564,101 @@ void Video::start()
     }
 }
 
+void Video::setSubsampling(int _sub)
+{
+    subSampling = _sub;
+
+    if (fd >= 0 && setControl(V4L2_CID_JPEG_CHROMA_SUBSAMPLING,
+                              subSampling ? V4L2_JPEG_CHROMA_SUBSAMPLING_420
+                                          : V4L2_JPEG_CHROMA_SUBSAMPLING_444,
+                              "subsampling") == EBUSY)
+    {
+        restart();
+    }
+}
+
+void Video::setFrameRate(int fr)
+{
+    frameRate = fr;
+
+    if (fd >= 0 && setTimePerFrame() == EBUSY)
+    {
+        restart();
+    }
+}
+
+void Video::setQuality(int q)
+{
+    // Applied when the device is started
+    if (fd < 0 || q < 0)
+    {
+        quality = q;
+        return;
+    }
+
+    // Keep the quality the driver has if it rejects the new one
+    int err = setControl(V4L2_CID_JPEG_COMPRESSION_QUALITY, q, "quality");
+
+    if (!err || err == EBUSY)
+    {
+        quality = q;
+    }
+
+    if (err == EBUSY)
+    {
+        restart();
+    }
+}
+
+int Video::setTimePerFrame()
+{
+    v4l2_streamparm sparm;
+
+    memset(&sparm, 0, sizeof(v4l2_streamparm));
+    sparm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    sparm.parm.capture.timeperframe.numerator = 1;
+    sparm.parm.capture.timeperframe.denominator = frameRate;
+    if (ioctl(fd, VIDIOC_S_PARM, &sparm) < 0)
+    {
+        int err = errno;
+
+        lg2::warning("Failed to set video device frame rate {ERROR}", "ERROR",
+                     strerror(err));
+        return err;
+    }
+
+    return 0;
+}
+
+int Video::setControl(uint32_t id, int value, const char* name)
+{
+    v4l2_control ctrl;
+
+    ctrl.id = id;
+    ctrl.value = value;
+    if (ioctl(fd, VIDIOC_S_CTRL, &ctrl) < 0)
+    {
+        int err = errno;
+
+        lg2::warning("Failed to set video jpeg {CONTROL} {ERROR}", "CONTROL",
+                     name, "ERROR", strerror(err));
+        return err;
+    }
+
+    return 0;
+}
+
+void Video::retry(std::chrono::steady_clock::time_point now)
+{
+    signal.retried(now);
+    FlightRecorder::record(
+        FlightRecorder::Event::videoRestart, signal.getRestarts(),
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            signal.getDelay())
+            .count());
+    restart();
+}
+
 void Video::stop()
 {
     int rc;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "ikvm_frame_source.hpp"
 #include "ikvm_input.hpp"
 
 #include <mutex>
@@ -11,9 +12,10 @@ namespace ikvm
 
 /*
  * @class Video
- * @brief Sets up the V4L2 video device and performs read operations
+ * @brief Frame source that sets up the V4L2 video device and performs read
+ *        operations
  */
-class Video
+class Video : public FrameSource
 {
   public:
     /*
@@ -24,7 +26,7 @@ class Video
      * @param[in] fr    - desired frame rate of the video
      */
     Video(const std::string& p, Input& input, int fr = 30, int sub = 0);
-    ~Video();
+    ~Video() override;
     Video(const Video&) = default;
     Video& operator=(const Video&) = delete;
     Video(Video&&) = default;
@@ -35,104 +37,84 @@ class Video
      *
      * @return Pointer to the video frame data
      */
-    char* getData();
+    char* getData() override;
     /* @brief Performs read to grab latest video frame */
-    void getFrame();
+    void getFrame() override;
     /*
      * @brief Probes the video device for the pixel format and sets the
      *        corresponding Video class variables
      */
-    void probePixelFormat();
+    void probePixelFormat() override;
     /*
      * @brief Gets whether or not the video frame needs to be resized
      *
      * @return Boolean indicating if the frame needs to be resized
      */
-    bool needsResize();
+    bool needsResize() override;
     /* @brief Performs the resize and re-allocates framebuffer */
-    void resize();
+    void resize() override;
     /* @brief Starts streaming from the video device */
-    void start();
+    void start() override;
     /* @brief Stops streaming from the video device */
-    void stop();
-    /* @brief Restarts streaming from the video device */
-    void restart()
-    {
-        stop();
-        start();
-    }
-
+    void stop() override;
     /*
-     * @brief Gets the desired video frame rate in frames per second
+     * @brief Sets the subsampling, restarting streaming only if the driver
+     *        refuses the change while streaming
      *
-     * @return Value of the desired frame rate
+     * @param[in] _sub - Value of the subsampling of video frame, 1:420/0:444
      */
-    inline int getFrameRate() const
-    {
-        return frameRate;
-    }
+    void setSubsampling(int _sub) override;
     /*
-     * @brief Gets the size of the video frame data
+     * @brief Sets the frame rate, restarting streaming only if the driver
+     *        refuses the change while streaming
      *
-     * @return Value of the size of the video frame data in bytes
+     * @param[in] fr - Value of the frame rate in frames per second
      */
-    inline size_t getFrameSize() const
-    {
-        return buffers[lastFrameIndex].payload;
-    }
+    void setFrameRate(int fr) override;
     /*
-     * @brief Gets the height of the video frame
+     * @brief Sets the JPEG quality, restarting streaming only if the driver
+     *        refuses the change while streaming; a quality the driver
+     *        rejects is not kept
      *
-     * @return Value of the height of video frame in pixels
+     * @param[in] q - Value of the quality, -1 to leave the driver's
      */
-    inline size_t getHeight() const
-    {
-        return height;
-    }
+    void setQuality(int q) override;
+
     /*
-     * @brief Gets the pixel format  of the video frame
+     * @brief Gets the size of the video frame data
      *
-     * @return Value of the pixel format of video frame */
-    inline uint32_t getPixelformat() const
+     * @return Value of the size of the video frame data in bytes
+     */
+    inline size_t getFrameSize() const override
     {
-        return pixelformat;
+        return buffers[lastFrameIndex].payload;
     }
+
+  private:
     /*
-     * @brief Gets the width of the video frame
+     * @brief Sets the frame interval of the video device
      *
-     * @return Value of the width of video frame in pixels
+     * @return 0 on success, else the error number
      */
-    inline size_t getWidth() const
-    {
-        return width;
-    }
+    int setTimePerFrame();
     /*
-     * @brief Gets the subsampling of the video frame
+     * @brief Sets a control of the video device
+     *
+     * @param[in] id    - Identifier of the control
+     * @param[in] value - Value of the control
+     * @param[in] name  - Name of the control for logging
      *
-     * @return Value of the subsampling of video frame, 1:420/0:444
+     * @return 0 on success, else the error number
      */
-    inline int getSubsampling() const
-    {
-        return subSampling;
-    }
+    int setControl(uint32_t id, int value, const char* name);
     /*
-     * @brief Sets the subsampling of the video frame
+     * @brief Restarts the video device while the signal is lost, backing
+     *        off the next restart
      *
-     * @return Value of the subsampling of video frame, 1:420/0:444
+     * @param[in] now - Current time
      */
-    inline void setSubsampling(int _sub)
-    {
-        subSampling = _sub;
-    }
+    void retry(std::chrono::steady_clock::time_point now);
 
-    /* @brief Number of bits per component of a pixel */
-    static int bitsPerSample;
-    /* @brief Number of bytes of storage for a pixel */
-    static int bytesPerPixel;
-    /* @brief Number of components in a pixel (i.e. 3 for RGB pixel) */
-    static int samplesPerPixel;
-
-  private:
     /*
      * @struct Buffer
      * @brief Store the address and size of frame data from streaming
@@ -158,29 +140,16 @@ class Video
      *        the open operation
      */
     bool resizeAfterOpen;
-    /* @brief Indicates whether or not timings query was last successful */
-    bool timingsError;
     /* @brief File descriptor for the V4L2 video device */
     int fd;
-    /* @brief Desired frame rate of video stream in frames per second */
-    int frameRate;
     /* @brief Buffer index for the last video frame */
     int lastFrameIndex;
-    /* @brief Height in pixels of the video frame */
-    size_t height;
-    /* @brief Width in pixels of the video frame */
-    size_t width;
-    /* @brief jpeg's subsampling, 1:420/0:444 */
-    int subSampling;
     /* @brief Reference to the Input object */
     Input& input;
     /* @brief Path to the V4L2 video device */
     const std::string path;
     /* @brief Streaming buffer storage */
     std::vector<Buffer> buffers;
-
-    /* @brief Pixel Format  */
-    uint32_t pixelformat;
 };
 
 } // namespace ikvm
@@ -0,0 +1,61 @@
+#include "ikvm_video_signal.hpp"
+
+#include <algorithm>
+
+namespace ikvm
+{
+
+bool VideoSignal::found(Clock::time_point now)
+{
+    if (isPresent)
+    {
+        return false;
+    }
+
+    lostTime += now - lostSince;
+    delay = minDelay;
+    isPresent = true;
+
+    return true;
+}
+
+bool VideoSignal::lost(Clock::time_point now)
+{
+    if (!isPresent)
+    {
+        return false;
+    }
+
+    // Short glitches may recover without reopening the device
+    lostSince = now;
+    nextRetry = now + delay;
+    isPresent = false;
+
+    return true;
+}
+
+bool VideoSignal::retryDue(Clock::time_point now) const
+{
+    return !isPresent && now >= nextRetry;
+}
+
+void VideoSignal::retried(Clock::time_point now)
+{
+    restarts++;
+    delay = std::min(delay * 2, maxDelay);
+    nextRetry = now + delay;
+}
+
+VideoSignal::Clock::duration
+    VideoSignal::getLostTime(Clock::time_point now) const
+{
+    return lostTime + getOutage(now);
+}
+
+VideoSignal::Clock::duration
+    VideoSignal::getOutage(Clock::time_point now) const
+{
+    return isPresent ? Clock::duration(0) : now - lostSince;
+}
+
+} // namespace ikvm
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace ikvm
+{
+
+/*
+ * @class VideoSignal
+ * @brief State of the video input signal, pacing the restarts of the video
+ *        device while the signal is lost
+ *
+ * The signal is lost when the timings can't be queried. The first restart
+ * is attempted after the minimum delay, and the delay doubles with every
+ * restart that doesn't bring the signal back, up to the maximum delay.
+ */
+class VideoSignal
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /*
+     * @brief Constructs VideoSignal object
+     *
+     * @param[in] minDelay - Delay before the first restart
+     * @param[in] maxDelay - Longest delay between two restarts
+     */
+    VideoSignal(Clock::duration minDelay = std::chrono::milliseconds(250),
+                Clock::duration maxDelay = std::chrono::seconds(8)) :
+        minDelay(minDelay), maxDelay(maxDelay), delay(minDelay),
+        isPresent(true), restarts(0), lostTime(0)
+    {}
+    ~VideoSignal() = default;
+    VideoSignal(const VideoSignal&) = default;
+    VideoSignal& operator=(const VideoSignal&) = default;
+    VideoSignal(VideoSignal&&) = default;
+    VideoSignal& operator=(VideoSignal&&) = default;
+
+    /*
+     * @brief Records a successful timings query
+     *
+     * @param[in] now - Time of the query
+     *
+     * @return Boolean indicating if the signal was lost until now
+     */
+    bool found(Clock::time_point now);
+    /*
+     * @brief Records a failed timings query
+     *
+     * @param[in] now - Time of the query
+     *
+     * @return Boolean indicating if the signal was present until now
+     */
+    bool lost(Clock::time_point now);
+    /*
+     * @brief Gets whether the video device should be restarted
+     *
+     * @param[in] now - Current time
+     *
+     * @return Boolean indicating if the signal is lost and the delay since
+     *         the last restart has passed
+     */
+    bool retryDue(Clock::time_point now) const;
+    /*
+     * @brief Records a restart of the video device and doubles the delay
+     *        before the next one
+     *
+     * @param[in] now - Time of the restart
+     */
+    void retried(Clock::time_point now);
+
+    /*
+     * @brief Gets the time spent without signal, including the current loss
+     *
+     * @param[in] now - Current time
+     *
+     * @return Total duration without signal
+     */
+    Clock::duration getLostTime(Clock::time_point now) const;
+    /*
+     * @brief Gets the duration of the current loss of signal
+     *
+     * @param[in] now - Current time
+     *
+     * @return Time since the signal was lost, 0 if it is present
+     */
+    Clock::duration getOutage(Clock::time_point now) const;
+
+    /*
+     * @brief Gets whether the signal is present
+     *
+     * @return Boolean indicating if the last timings query succeeded
+     */
+    inline bool present() const
+    {
+        return isPresent;
+    }
+    /*
+     * @brief Gets the delay before the next restart
+     *
+     * @return Current delay
+     */
+    inline Clock::duration getDelay() const
+    {
+        return delay;
+    }
+    /*
+     * @brief Gets the number of restarts while the signal was lost
+     *
+     * @return Number of restarts
+     */
+    inline uint64_t getRestarts() const
+    {
+        return restarts;
+    }
+
+  private:
+    /* @brief Delay before the first restart */
+    Clock::duration minDelay;
+    /* @brief Longest delay between two restarts */
+    Clock::duration maxDelay;
+    /* @brief Delay before the next restart */
+    Clock::duration delay;
+    /* @brief Boolean indicating if the signal is present */
+    bool isPresent;
+    /* @brief Number of restarts while the signal was lost */
+    uint64_t restarts;
+    /* @brief Time spent without signal, excluding the current loss */
+    Clock::duration lostTime;
+    /* @brief Time at which the signal was lost */
+    Clock::time_point lostSince;
+    /* @brief Time of the next restart */
+    Clock::time_point nextRetry;
+};
+
+} // namespace ikvm
@@ -0,0 +1,72 @@
+#include "ikvm_video_signal.hpp"
+
+#include <gtest/gtest.h>
+
+namespace ikvm
+{
+
+using namespace std::chrono_literals;
+
+TEST(VideoSignalTest, GlitchWithoutRestart)
+{
+    VideoSignal signal(250ms, 8s);
+    VideoSignal::Clock::time_point now;
+
+    EXPECT_TRUE(signal.present());
+    EXPECT_TRUE(signal.lost(now));
+    EXPECT_FALSE(signal.lost(now + 10ms));
+    EXPECT_FALSE(signal.retryDue(now + 100ms));
+    EXPECT_EQ(signal.getOutage(now + 100ms), 100ms);
+
+    EXPECT_TRUE(signal.found(now + 100ms));
+    EXPECT_FALSE(signal.found(now + 200ms));
+    EXPECT_TRUE(signal.present());
+    EXPECT_EQ(signal.getRestarts(), 0u);
+    EXPECT_EQ(signal.getOutage(now + 200ms), 0ms);
+    EXPECT_EQ(signal.getLostTime(now + 200ms), 100ms);
+}
+
+TEST(VideoSignalTest, BackoffDoublesUpToMax)
+{
+    VideoSignal signal(250ms, 1s);
+    VideoSignal::Clock::time_point now;
+
+    signal.lost(now);
+    EXPECT_TRUE(signal.retryDue(now + 250ms));
+
+    now += 250ms;
+    signal.retried(now);
+    EXPECT_EQ(signal.getDelay(), 500ms);
+    EXPECT_FALSE(signal.retryDue(now + 499ms));
+    EXPECT_TRUE(signal.retryDue(now + 500ms));
+
+    now += 500ms;
+    signal.retried(now);
+    EXPECT_EQ(signal.getDelay(), 1s);
+
+    now += 1s;
+    signal.retried(now);
+    EXPECT_EQ(signal.getDelay(), 1s);
+    EXPECT_EQ(signal.getRestarts(), 3u);
+}
+
+TEST(VideoSignalTest, FoundResetsBackoff)
+{
+    VideoSignal signal(250ms, 8s);
+    VideoSignal::Clock::time_point now;
+
+    signal.lost(now);
+    signal.retried(now + 250ms);
+    signal.retried(now + 750ms);
+    signal.found(now + 2s);
+    EXPECT_EQ(signal.getDelay(), 250ms);
+    EXPECT_FALSE(signal.retryDue(now + 10s));
+
+    // Time without signal adds up over losses
+    signal.lost(now + 3s);
+    EXPECT_TRUE(signal.retryDue(now + 3s + 250ms));
+    EXPECT_EQ(signal.getLostTime(now + 4s), 3s);
+    EXPECT_EQ(signal.getRestarts(), 2u);
+}
+
+} // namespace ikvm
@@ -96,5 +96,21 @@
 #define USBHID_KEY_KP_9 0x61
 #define USBHID_KEY_KP_0 0x62
 #define USBHID_KEY_KP_DECIMAL 0x63
+#define USBHID_KEY_102ND 0x64
 #define USBHID_MENU 0x65
+#define USBHID_KEY_POWER 0x66
 #define USBHID_KEY_KP_EQUAL 0x67
+#define USBHID_KEY_KP_COMMA 0x85
+#define USBHID_KEY_RO 0x87
+#define USBHID_KEY_KATAKANAHIRAGANA 0x88
+#define USBHID_KEY_YEN 0x89
+#define USBHID_KEY_HENKAN 0x8a
+#define USBHID_KEY_MUHENKAN 0x8b
+#define USBHID_KEY_LEFTCTRL 0xe0
+#define USBHID_KEY_LEFTSHIFT 0xe1
+#define USBHID_KEY_LEFTALT 0xe2
+#define USBHID_KEY_LEFTMETA 0xe3
+#define USBHID_KEY_RIGHTCTRL 0xe4
+#define USBHID_KEY_RIGHTSHIFT 0xe5
+#define USBHID_KEY_RIGHTALT 0xe6
+#define USBHID_KEY_RIGHTMETA 0xe7